@@ -28,8 +28,10 @@
 #include "strvec.h"
 #include "commit.h"
 #include "commit-graph.h"
+#include "grep-index.h"
 #include "packfile.h"
 #include "object-file.h"
+#include "object-name.h"
 #include "pack.h"
 #include "pack-objects.h"
 #include "path.h"
@@ -263,6 +265,8 @@ enum maintenance_task_label {
 	TASK_REFLOG_EXPIRE,
 	TASK_WORKTREE_PRUNE,
 	TASK_RERERE_GC,
+	TASK_GREP_INDEX,
+	TASK_LAST_MODIFIED_INDEX,
 
 	/* Leave as final value */
 	TASK__COUNT
@@ -1213,6 +1217,40 @@ static int maintenance_task_commit_graph(struct maintenance_run_opts *opts,
 	return 0;
 }
 
+static int maintenance_task_grep_index(struct maintenance_run_opts *opts,
+				       struct gc_config *cfg UNUSED)
+{
+	if (write_grep_index(the_repository,
+			     opts->quiet ? 0 : GREP_INDEX_WRITE_PROGRESS)) {
+		error(_("failed to write grep index"));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int maintenance_task_last_modified_index(struct maintenance_run_opts *opts UNUSED,
+						struct gc_config *cfg UNUSED)
+{
+	struct child_process child = CHILD_PROCESS_INIT;
+	struct object_id oid;
+
+	/* Nothing to index on an unborn branch. */
+	if (repo_get_oid(the_repository, "HEAD", &oid))
+		return 0;
+
+	child.git_cmd = 1;
+	child.odb_to_close = the_repository->objects;
+	strvec_pushl(&child.args, "last-modified", "--write-index", NULL);
+
+	if (run_command(&child)) {
+		error(_("failed to write last-modified index"));
+		return 1;
+	}
+
+	return 0;
+}
+
 static int fetch_remote(struct remote *remote, void *cbdata)
 {
 	struct maintenance_run_opts *opts = cbdata;
@@ -1748,6 +1786,14 @@ static const struct maintenance_task tasks[] = {
 		.background = maintenance_task_rerere_gc,
 		.auto_condition = rerere_gc_condition,
 	},
+	[TASK_GREP_INDEX] = {
+		.name = "grep-index",
+		.background = maintenance_task_grep_index,
+	},
+	[TASK_LAST_MODIFIED_INDEX] = {
+		.name = "last-modified-index",
+		.background = maintenance_task_last_modified_index,
+	},
 };
 
 enum task_phase {
@@ -19,12 +19,14 @@
 #include "string-list.h"
 #include "run-command.h"
 #include "grep.h"
+#include "grep-index.h"
 #include "quote.h"
 #include "dir.h"
 #include "pathspec.h"
 #include "setup.h"
 #include "submodule.h"
 #include "submodule-config.h"
+#include "trace2.h"
 #include "object-file.h"
 #include "object-name.h"
 #include "odb.h"
@@ -46,6 +48,9 @@ static char const * const grep_usage[] = {
 
 static int recurse_submodules;
 
+static int use_grep_index = 1;
+static struct grep_index *grep_index;
+
 static int num_threads;
 
 static pthread_t *threads;
@@ -81,6 +86,16 @@ static int all_work_added;
 static struct repository **repos_to_free;
 static size_t repos_to_free_nr, repos_to_free_alloc;
 
+/*
+ * Blobs of the_repository that are known to produce no output. When
+ * searching many trees, e.g. "git grep <pattern> $(git rev-list --all)",
+ * most blobs are shared between them, and we only need to scan each
+ * of them once to know that.
+ */
+static int skip_unmatched_blobs;
+static struct oidset unmatched_blobs = OIDSET_INIT;
+static intmax_t unmatched_blobs_skipped;
+
 /* This lock protects all the variables above. */
 static pthread_mutex_t grep_mutex;
 
@@ -197,6 +212,55 @@ static void free_repos(void)
 	repos_to_free_alloc = 0;
 }
 
+static int blob_known_unmatched(const struct object_id *oid,
+				struct repository *repo)
+{
+	int ret;
+
+	if (!skip_unmatched_blobs || repo != the_repository)
+		return 0;
+
+	if (num_threads > 1)
+		grep_lock();
+	ret = oidset_contains(&unmatched_blobs, oid);
+	if (ret)
+		unmatched_blobs_skipped++;
+	if (num_threads > 1)
+		grep_unlock();
+	return ret;
+}
+
+static void remember_unmatched_blob(const struct grep_source *gs)
+{
+	if (!skip_unmatched_blobs || gs->type != GREP_SOURCE_OID ||
+	    gs->repo != the_repository)
+		return;
+
+	if (num_threads > 1)
+		grep_lock();
+	oidset_insert(&unmatched_blobs, gs->identifier);
+	if (num_threads > 1)
+		grep_unlock();
+}
+
+static int grep_source_once(struct grep_opt *opt, struct grep_source *gs)
+{
+	int hit;
+
+	/*
+	 * The same blob may have been queued again before its first
+	 * scan finished.
+	 */
+	if (gs->type == GREP_SOURCE_OID &&
+	    blob_known_unmatched(gs->identifier, gs->repo))
+		return 0;
+
+	hit = grep_source(opt, gs);
+	if (!hit)
+		remember_unmatched_blob(gs);
+	return hit;
+}
+
 static void *run(void *arg)
 {
 	int hit = 0;
@@ -208,7 +272,7 @@ static void *run(void *arg)
 			break;
 
 		opt->output_priv = w;
-		hit |= grep_source(opt, &w->source);
+		hit |= grep_source_once(opt, &w->source);
 		grep_source_clear_data(&w->source);
 		work_done(w);
 	}
@@ -323,6 +387,9 @@ static int grep_cmd_config(const char *var, const char *value,
 	if (!strcmp(var, "submodule.recurse"))
 		recurse_submodules = git_config_bool(var, value);
 
+	if (!strcmp(var, "grep.useindex"))
+		use_grep_index = git_config_bool(var, value);
+
 	return st;
 }
 
@@ -365,6 +432,9 @@ static int grep_oid(struct grep_opt *opt, const struct object_id *oid,
 	struct strbuf pathbuf = STRBUF_INIT;
 	struct grep_source gs;
 
+	if (blob_known_unmatched(oid, opt->repo))
+		return 0;
+
 	grep_source_name(opt, filename, tree_name_len, &pathbuf);
 	grep_source_init_oid(&gs, pathbuf.buf, path, oid, opt->repo);
 	strbuf_release(&pathbuf);
@@ -379,7 +449,7 @@ static int grep_oid(struct grep_opt *opt, const struct object_id *oid,
 	} else {
 		int hit;
 
-		hit = grep_source(opt, &gs);
+		hit = grep_source_once(opt, &gs);
 
 		grep_source_clear(&gs);
 		return hit;
@@ -660,8 +730,10 @@ static int grep_tree(struct grep_opt *opt, const struct pathspec *pathspec,
 		strbuf_add(base, entry.path, te_len);
 
 		if (S_ISREG(entry.mode)) {
-			hit |= grep_oid(opt, &entry.oid, base->buf, tn_len,
-					 check_attr ? base->buf + tn_len : NULL);
+			if (!grep_index ||
+			    grep_index_may_match(grep_index, opt, &entry.oid))
+				hit |= grep_oid(opt, &entry.oid, base->buf, tn_len,
+						check_attr ? base->buf + tn_len : NULL);
 		} else if (S_ISDIR(entry.mode)) {
 			enum object_type type;
 			struct tree_desc sub;
@@ -836,8 +908,11 @@ static void prefetch_grep_blobs(struct grep_opt *opt,
 static int grep_object(struct grep_opt *opt, const struct pathspec *pathspec,
 		       struct object *obj, const char *name, const char *path)
 {
-	if (obj->type == OBJ_BLOB)
+	if (obj->type == OBJ_BLOB) {
+		if (grep_index && !grep_index_may_match(grep_index, opt, &obj->oid))
+			return 0;
 		return grep_oid(opt, &obj->oid, name, 0, path);
+	}
 	if (obj->type == OBJ_COMMIT || obj->type == OBJ_TREE) {
 		struct tree_desc tree;
 		void *data;
@@ -875,6 +950,23 @@ static int grep_objects(struct grep_opt *opt, const struct pathspec *pathspec,
 
 	prefetch_grep_blobs(opt, pathspec, list);
 
+	/*
+	 * Whether a blob produces any output only depends on its contents,
+	 * unless we are asked to list files without a match, or the
+	 * attributes of its path may turn it into something else.
+	 */
+	skip_unmatched_blobs = !opt->unmatch_name_only &&
+			       !opt->allow_textconv &&
+			       opt->binary != GREP_BINARY_NOMATCH;
+
+	if (use_grep_index) {
+		grep_index = grep_index_load(opt->repo);
+		if (grep_index && !grep_index_prepare(grep_index, opt)) {
+			grep_index_free(grep_index);
+			grep_index = NULL;
+		}
+	}
+
 	for (i = 0; i < nr; i++) {
 		struct object *real_obj;
 
@@ -908,6 +1000,9 @@ static int grep_objects(struct grep_opt *opt, const struct pathspec *pathspec,
 				break;
 		}
 	}
+
+	grep_index_free(grep_index);
+	grep_index = NULL;
 	return hit;
 }
 
@@ -1427,6 +1522,10 @@ int cmd_grep(int argc,
 
 	if (num_threads > 1)
 		hit |= wait_all();
+	if (skip_unmatched_blobs)
+		trace2_data_intmax("grep", the_repository,
+				   "unmatched-blobs/skipped",
+				   unmatched_blobs_skipped);
 	if (hit && show_in_pager)
 		run_pager(&opt, prefix);
 
@@ -1436,6 +1535,7 @@ int cmd_grep(int argc,
 	clear_pathspec(&pathspec);
 	string_list_clear(&path_list, 0);
 	free_grep_patterns(&opt);
+	oidset_clear(&unmatched_blobs);
 	object_array_clear(&list);
 	free_repos();
 	return ret;
@@ -11,6 +11,7 @@
 #include "ewah/ewok.h"
 #include "hashmap.h"
 #include "hex.h"
+#include "last-modified-index.h"
 #include "object-name.h"
 #include "object.h"
 #include "parse-options.h"
@@ -18,6 +19,7 @@
 #include "quote.h"
 #include "repository.h"
 #include "revision.h"
+#include "string-list.h"
 
 /* Remember to update object flag allocation in object.h */
 #define PARENT1 (1u<<16) /* used instead of SEEN */
@@ -56,6 +58,19 @@ struct last_modified {
 	bool show_trees;
 	bool nul_termination;
 	int max_depth;
+	bool write_index;
+	struct object_id tip;
+
+	/*
+	 * The last-modified index, if there is one and the query can use it,
+	 * and the commit it was computed for. Paths still active when the walk
+	 * reaches that commit are looked up in the index.
+	 */
+	struct last_modified_index *index;
+	struct commit *index_tip;
+
+	/* With 'write_index', the result is collected here instead. */
+	struct string_list result;
 
 	const char **all_paths;
 	size_t all_paths_nr;
@@ -93,6 +108,8 @@ static void last_modified_release(struct last_modified *lm)
 
 	hashmap_clear_and_free(&lm->paths, struct last_modified_entry, hashent);
 	release_revisions(&lm->rev);
+	last_modified_index_free(lm->index);
+	string_list_clear(&lm->result, 1);
 
 	free(lm->all_paths);
 }
@@ -142,6 +159,7 @@ static int populate_paths_from_revs(struct last_modified *lm)
 
 	for (size_t i = 0; i < lm->rev.pending.nr; i++) {
 		struct object_array_entry *obj = lm->rev.pending.objects + i;
+		struct object *commit;
 
 		if (obj->item->flags & UNINTERESTING)
 			continue;
@@ -151,10 +169,12 @@ static int populate_paths_from_revs(struct last_modified *lm)
 			goto out;
 		}
 
-		if (!repo_peel_to_type(lm->rev.repo, obj->path, 0, obj->item, OBJ_COMMIT)) {
+		commit = repo_peel_to_type(lm->rev.repo, obj->path, 0, obj->item, OBJ_COMMIT);
+		if (!commit) {
 			ret = error(_("revision argument '%s' is a %s, not a commit-ish"), obj->name, type_name(obj->item->type));
 			goto out;
 		}
+		oidcpy(&lm->tip, &commit->oid);
 
 		diff_tree_oid(lm->rev.repo->hash_algo->empty_tree,
 			      &obj->item->oid, "", &diffopt);
@@ -171,6 +191,12 @@ static void last_modified_emit(struct last_modified *lm,
 			       const char *path, const struct commit *commit)
 
 {
+	if (lm->write_index) {
+		string_list_append(&lm->result, path)->util =
+			oiddup(&commit->object.oid);
+		return;
+	}
+
 	if (commit->object.flags & BOUNDARY)
 		putchar('^');
 	printf("%s\t", oid_to_hex(&commit->object.oid));
@@ -246,6 +272,26 @@ static void last_modified_diff(struct diff_queue_struct *q,
 	}
 }
 
+static void resolve_from_index(struct last_modified *lm,
+			       struct bitmap *active,
+			       struct last_modified_callback_data *data)
+{
+	for (size_t i = 0; i < lm->all_paths_nr; i++) {
+		struct object_id oid;
+
+		if (!bitmap_get(active, i) ||
+		    !last_modified_index_lookup(lm->index, lm->all_paths[i], &oid))
+			continue;
+
+		bitmap_unset(active, i);
+		data->commit = lookup_commit(lm->rev.repo, &oid);
+		if (!data->commit)
+			die(_("last-modified index names non-commit %s"),
+			    oid_to_hex(&oid));
+		mark_path(lm->all_paths[i], NULL, data);
+	}
+}
+
 static void pass_to_parent(struct bitmap *c,
 			   struct bitmap *p,
 			   size_t pos)
@@ -410,6 +456,16 @@ static int last_modified_run(struct last_modified *lm)
 			goto cleanup;
 		}
 
+		/*
+		 * The index knows where the walk would end for the paths
+		 * that are still active at its tip.
+		 */
+		if (c == lm->index_tip) {
+			resolve_from_index(lm, active_c, &data);
+			if (bitmap_is_empty(active_c))
+				goto cleanup;
+		}
+
 		/*
 		 * Otherwise, make sure that 'c' isn't reachable from anything
 		 * in the '--not' queue.
@@ -478,6 +534,10 @@ static int last_modified_init(struct last_modified *lm, struct repository *r,
 {
 	struct hashmap_iter iter;
 	struct last_modified_entry *ent;
+	bool has_negative = false;
+	int use_index = 1;
+
+	repo_config_get_bool(r, "lastmodified.useindex", &use_index);
 
 	hashmap_init(&lm->paths, last_modified_entry_hashcmp, NULL, 0);
 
@@ -502,6 +562,26 @@ static int last_modified_init(struct last_modified *lm, struct repository *r,
 
 	lm->rev.bloom_filter_settings = get_bloom_filter_settings(lm->rev.repo);
 
+	for (size_t i = 0; i < lm->rev.pending.nr; i++)
+		if (lm->rev.pending.objects[i].item->flags & UNINTERESTING)
+			has_negative = true;
+
+	if (lm->write_index &&
+	    (has_negative || lm->rev.max_count >= 0 ||
+	     lm->rev.prune_data.nr))
+		return error(_("--write-index cannot be used with a revision "
+			       "range or pathspec"));
+
+	/*
+	 * Paths resolved from the index may have been last modified beyond
+	 * a boundary of the walk, so only use it when there is none.
+	 */
+	if (use_index && !has_negative && lm->rev.max_count < 0) {
+		lm->index = last_modified_index_load(r);
+		if (lm->index)
+			lm->index_tip = lookup_commit(r, last_modified_index_tip(lm->index));
+	}
+
 	if (populate_paths_from_revs(lm) < 0)
 		return -1;
 
@@ -519,11 +599,12 @@ int cmd_last_modified(int argc, const char **argv, const char *prefix,
 		      struct repository *repo)
 {
 	int ret;
-	struct last_modified lm = { 0 };
+	struct last_modified lm = { .result = STRING_LIST_INIT_DUP };
 
 	const char * const last_modified_usage[] = {
 		N_("git last-modified [--recursive] [--show-trees] [--max-depth=<depth>] [-z]\n"
 		   "                  [<revision-range>] [[--] <pathspec>...]"),
+		N_("git last-modified --write-index [<commit>]"),
 		NULL
 	};
 
@@ -536,6 +617,8 @@ int cmd_last_modified(int argc, const char **argv, const char *prefix,
 			      N_("maximum tree depth to recurse"), PARSE_OPT_NONEG),
 		OPT_BOOL('z', NULL, &lm.nul_termination,
 			 N_("lines are separated with NUL character")),
+		OPT_BOOL(0, "write-index", &lm.write_index,
+			 N_("write the last-modified index instead of showing paths")),
 		OPT_END()
 	};
 
@@ -546,6 +629,12 @@ int cmd_last_modified(int argc, const char **argv, const char *prefix,
 
 	repo_config(repo, git_default_config, NULL);
 
+	/* The index covers every path, trees included. */
+	if (lm.write_index) {
+		lm.max_depth = -1;
+		lm.show_trees = true;
+	}
+
 	ret = last_modified_init(&lm, repo, prefix, argc, argv);
 	if (ret > 0)
 		usage_with_options(last_modified_usage,
@@ -557,6 +646,15 @@ int cmd_last_modified(int argc, const char **argv, const char *prefix,
 	if (ret)
 		goto out;
 
+	if (lm.write_index) {
+		/* Unmap the old index before it is replaced. */
+		last_modified_index_free(lm.index);
+		lm.index = NULL;
+
+		string_list_sort(&lm.result);
+		ret = write_last_modified_index(repo, &lm.tip, &lm.result);
+	}
+
 out:
 	last_modified_release(&lm);
 
@@ -41,6 +41,7 @@
 #include "shallow.h"
 #include "promisor-remote.h"
 #include "pack-mtimes.h"
+#include "pack-delta-hints.h"
 #include "parse-options.h"
 #include "pkt-line.h"
 #include "blob.h"
@@ -232,6 +233,8 @@ static int pack_to_stdout;
 static int sparse;
 static int thin;
 static int path_walk = -1;
+static int delta_hints;
+static int searched_deltas;
 static int num_preferred_base;
 static struct progress *progress_state;
 
@@ -494,6 +497,40 @@ static void copy_pack_data(struct hashfile *f,
 	}
 }
 
+/*
+ * Like copy_pack_data(), but have the kernel copy the bytes from the
+ * packfile to the output where it can. They are still read through the
+ * pack window, to compute the checksum of the pack we write.
+ */
+static void copy_pack_data_from_fd(struct hashfile *f,
+				   struct packed_git *p,
+				   struct pack_window **w_curs,
+				   off_t offset,
+				   off_t len)
+{
+	int fd = git_open(p->pack_name);
+
+	if (fd < 0) {
+		copy_pack_data(f, p, w_curs, offset, len);
+		return;
+	}
+
+	while (len) {
+		unsigned char *in;
+		unsigned long avail;
+
+		in = use_pack(p, w_curs, offset, &avail);
+		if (avail > len)
+			avail = (unsigned long)len;
+		if (avail > maximum_unsigned_value_of_type(uint32_t))
+			avail = maximum_unsigned_value_of_type(uint32_t);
+		hashwrite_from_fd(f, in, avail, fd, offset);
+		offset += avail;
+		len -= avail;
+	}
+	close(fd);
+}
+
 static inline int oe_size_greater_than(struct packing_data *pack,
 				       const struct object_entry *lhs,
 				       unsigned long rhs)
@@ -1223,8 +1260,8 @@ static size_t write_reused_pack_verbatim(struct bitmapped_pack *reuse_packfile,
 		/* We're recording one chunk, not one object. */
 		record_reused_object(sizeof(struct pack_header), 0);
 		hashflush(out);
-		copy_pack_data(out, reuse_packfile->p, w_curs,
-			sizeof(struct pack_header), to_write);
+		copy_pack_data_from_fd(out, reuse_packfile->p, w_curs,
+				       sizeof(struct pack_header), to_write);
 
 		display_progress(progress_state, written);
 	}
@@ -1452,6 +1489,8 @@ static void write_pack_file(void)
 
 			if (cruft)
 				pack_idx_opts.flags |= WRITE_MTIMES;
+			if (to_pack.delta_hint)
+				pack_idx_opts.flags |= WRITE_DELTA_HINTS;
 
 			stage_tmp_packfiles(the_repository, &tmpname,
 					    pack_tmp_name, written_list,
@@ -2253,6 +2292,7 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 		enum object_type type;
 		size_t in_pack_size;
 
+		obj_read_lock();
 		buf = use_pack(p, &w_curs, entry->in_pack_offset, &avail);
 
 		/*
@@ -2277,12 +2317,13 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 		switch (entry->in_pack_type) {
 		default:
 			/* Not a delta hence we've already got all we need. */
+			unuse_pack(&w_curs);
+			obj_read_unlock();
 			oe_set_type(entry, entry->in_pack_type);
 			SET_SIZE(entry, cast_size_t_to_ulong(in_pack_size));
 			entry->in_pack_header_size = used;
 			if (oe_type(entry) < OBJ_COMMIT || oe_type(entry) > OBJ_BLOB)
-				goto give_up;
-			unuse_pack(&w_curs);
+				goto read_object_info;
 			return;
 		case OBJ_REF_DELTA:
 			if (reuse_delta && !entry->preferred_base) {
@@ -2329,21 +2370,32 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 			break;
 		}
 
+		/*
+		 * We are done with the pack for now. Deciding whether to
+		 * reuse the delta only looks at the packing list and the
+		 * bitmap, which are not modified while we run.
+		 */
+		unuse_pack(&w_curs);
+		obj_read_unlock();
+
 		if (have_base &&
 		    can_reuse_delta(&base_ref, entry, &base_entry)) {
 			oe_set_type(entry, entry->in_pack_type);
 			SET_SIZE(entry, cast_size_t_to_ulong(in_pack_size)); /* delta size */
 			SET_DELTA_SIZE(entry, cast_size_t_to_ulong(in_pack_size));
 
+			/*
+			 * The entry is added to the children of its base
+			 * by get_object_details(), as other threads may be
+			 * looking at other children of the same base.
+			 */
 			if (base_entry) {
 				SET_DELTA(entry, base_entry);
-				entry->delta_sibling_idx = base_entry->delta_child_idx;
-				SET_DELTA_CHILD(base_entry, entry);
 			} else {
+				packing_data_lock(&to_pack);
 				SET_DELTA_EXT(entry, &base_ref);
+				packing_data_unlock(&to_pack);
 			}
-
-			unuse_pack(&w_curs);
 			return;
 		}
 
@@ -2356,11 +2408,13 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 			 * object size from the delta header.
 			 */
 			delta_pos = entry->in_pack_offset + entry->in_pack_header_size;
+			obj_read_lock();
 			canonical_size = get_size_from_delta(p, &w_curs, delta_pos);
+			unuse_pack(&w_curs);
+			obj_read_unlock();
 			if (canonical_size == 0)
-				goto give_up;
+				goto read_object_info;
 			SET_SIZE(entry, canonical_size);
-			unuse_pack(&w_curs);
 			return;
 		}
 
@@ -2369,10 +2423,14 @@ static void check_object(struct object_entry *entry, uint32_t object_index)
 		 * with odb_read_object_info() to find about the object type
 		 * at this point...
 		 */
+		goto read_object_info;
+
 		give_up:
 		unuse_pack(&w_curs);
+		obj_read_unlock();
 	}
 
+read_object_info:
 	if (odb_read_object_info_extended(the_repository->objects, &entry->idx.oid, &oi,
 					  OBJECT_INFO_SKIP_FETCH_OBJECT | OBJECT_INFO_LOOKUP_REPLACE) < 0) {
 		if (repo_has_promisor_remote(the_repository)) {
@@ -2589,10 +2647,80 @@ static void break_delta_chains(struct object_entry *entry)
 	}
 }
 
+#define CHECK_OBJECT_PER_THREAD 4096
+
+/*
+ * Each thread looks at a contiguous part of the list of objects sorted
+ * by pack offset, so that it does not jump around in the packs.
+ */
+struct check_object_params {
+	pthread_t thread;
+	struct object_entry **list;
+	uint32_t list_size;
+	uint32_t *processed;
+	pthread_mutex_t *mutex;
+};
+
+static void *threaded_check_object(void *arg)
+{
+	struct check_object_params *me = arg;
+	uint32_t i;
+
+	for (i = 0; i < me->list_size; i++) {
+		check_object(me->list[i], 0);
+		if ((i & 1023) == 1023 || i + 1 == me->list_size) {
+			pthread_mutex_lock(me->mutex);
+			*me->processed += (i & 1023) + 1;
+			display_progress(progress_state, *me->processed);
+			pthread_mutex_unlock(me->mutex);
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Run check_object() in parallel. Accesses to the packs are serialized
+ * by the object read lock, which is dropped while inflating, e.g. to
+ * find the size of a delta whose base we do not reuse.
+ */
+static void ll_check_objects(struct object_entry **list, uint32_t list_size,
+			     int nr_threads)
+{
+	struct check_object_params *p;
+	pthread_mutex_t mutex;
+	uint32_t processed = 0;
+	int i;
+
+	pthread_mutex_init(&mutex, NULL);
+	enable_obj_read_lock();
+
+	CALLOC_ARRAY(p, nr_threads);
+	for (i = 0; i < nr_threads; i++) {
+		uint32_t sub_size = list_size / (nr_threads - i);
+
+		p[i].list = list;
+		p[i].list_size = sub_size;
+		p[i].processed = &processed;
+		p[i].mutex = &mutex;
+		if (pthread_create(&p[i].thread, NULL, threaded_check_object,
+				   &p[i]))
+			die(_("unable to create thread"));
+		list += sub_size;
+		list_size -= sub_size;
+	}
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(p[i].thread, NULL);
+
+	disable_obj_read_lock();
+	pthread_mutex_destroy(&mutex);
+	free(p);
+}
+
 static void get_object_details(void)
 {
 	uint32_t i;
 	struct object_entry **sorted_by_offset;
+	int nr_threads = 1;
 
 	if (progress)
 		progress_state = start_progress(the_repository,
@@ -2604,16 +2732,47 @@ static void get_object_details(void)
 		sorted_by_offset[i] = to_pack.objects + i;
 	QSORT(sorted_by_offset, to_pack.nr_objects, pack_offset_sort);
 
+	/*
+	 * Objects we fail to find may have to be fetched from a promisor
+	 * remote, which we can only do from a single thread.
+	 */
+	if (!repo_has_promisor_remote(the_repository)) {
+		nr_threads = delta_search_threads;
+		if (nr_threads > to_pack.nr_objects / CHECK_OBJECT_PER_THREAD)
+			nr_threads = to_pack.nr_objects / CHECK_OBJECT_PER_THREAD;
+	}
+
+	if (nr_threads > 1) {
+		trace2_data_intmax("pack-objects", the_repository,
+				   "check-object/threads", nr_threads);
+		ll_check_objects(sorted_by_offset, to_pack.nr_objects,
+				 nr_threads);
+	} else {
+		for (i = 0; i < to_pack.nr_objects; i++) {
+			check_object(sorted_by_offset[i], i);
+			display_progress(progress_state, i + 1);
+		}
+	}
+	stop_progress(&progress_state);
+
+	/*
+	 * Link the deltas we reuse to their bases in the same order as
+	 * they were looked at, so that the result does not depend on the
+	 * number of threads.
+	 */
 	for (i = 0; i < to_pack.nr_objects; i++) {
 		struct object_entry *entry = sorted_by_offset[i];
-		check_object(entry, i);
+		struct object_entry *base = DELTA(entry);
+
+		if (base && !entry->ext_base) {
+			entry->delta_sibling_idx = base->delta_child_idx;
+			SET_DELTA_CHILD(base, entry);
+		}
 		if (entry->type_valid &&
 		    oe_size_greater_than(&to_pack, entry,
 					 repo_settings_get_big_file_threshold(the_repository)))
 			entry->no_try_delta = 1;
-		display_progress(progress_state, i + 1);
 	}
-	stop_progress(&progress_state);
 
 	/*
 	 * This must happen in a second pass, since we rely on the delta
@@ -2760,7 +2919,12 @@ unsigned long oe_get_size_slow(struct packing_data *pack,
 	if (!p)
 		BUG("when e->type is a delta, it must belong to a pack");
 
+	/*
+	 * The pack windows are shared with the threads of
+	 * get_object_details(), which only hold the object read lock.
+	 */
 	packing_data_lock(&to_pack);
+	obj_read_lock();
 	w_curs = NULL;
 	buf = use_pack(p, &w_curs, e->in_pack_offset, &avail);
 	used = unpack_object_header_buffer(buf, avail, &type, &size);
@@ -2769,6 +2933,7 @@ unsigned long oe_get_size_slow(struct packing_data *pack,
 		    oid_to_hex(&e->idx.oid));
 
 	unuse_pack(&w_curs);
+	obj_read_unlock();
 	packing_data_unlock(&to_pack);
 	return cast_size_t_to_ulong(size);
 }
@@ -2952,6 +3117,23 @@ static unsigned long free_unpacked(struct unpacked *n)
 	return freed_mem;
 }
 
+static void compress_cached_delta(struct object_entry *entry)
+{
+	unsigned long size;
+
+	size = do_compress(&entry->delta_data, DELTA_SIZE(entry));
+	if (size < (1U << OE_Z_DELTA_BITS)) {
+		entry->z_delta_size = size;
+		cache_lock();
+		delta_cache_size -= DELTA_SIZE(entry);
+		delta_cache_size += entry->z_delta_size;
+		cache_unlock();
+	} else {
+		FREE_AND_NULL(entry->delta_data);
+		entry->z_delta_size = 0;
+	}
+}
+
 static void find_deltas(struct object_entry **list, unsigned *list_size,
 			int window, int depth, unsigned *processed)
 {
@@ -3018,6 +3200,12 @@ static void find_deltas(struct object_entry **list, unsigned *list_size,
 			m = array + other_idx;
 			if (!m->entry)
 				break;
+			/*
+			 * An earlier search found no base for this object
+			 * among the others it saw; only try new ones.
+			 */
+			if (entry->delta_hint_whole && m->entry->delta_hint_whole)
+				continue;
 			ret = try_delta(n, m, max_depth, &mem_usage);
 			if (ret < 0)
 				break;
@@ -3039,21 +3227,8 @@ static void find_deltas(struct object_entry **list, unsigned *list_size,
 		 * instead, as we can afford spending more time compressing
 		 * between writes at that moment.
 		 */
-		if (entry->delta_data && !pack_to_stdout) {
-			unsigned long size;
-
-			size = do_compress(&entry->delta_data, DELTA_SIZE(entry));
-			if (size < (1U << OE_Z_DELTA_BITS)) {
-				entry->z_delta_size = size;
-				cache_lock();
-				delta_cache_size -= DELTA_SIZE(entry);
-				delta_cache_size += entry->z_delta_size;
-				cache_unlock();
-			} else {
-				FREE_AND_NULL(entry->delta_data);
-				entry->z_delta_size = 0;
-			}
-		}
+		if (entry->delta_data && !pack_to_stdout)
+			compress_cached_delta(entry);
 
 		/* if we made n a delta, and if n is already at max
 		 * depth, leaving it in the window is pointless.  we
@@ -3480,6 +3655,7 @@ static void ll_find_deltas_by_region(struct object_entry *list,
 	int i, ret, active_threads = 0;
 	unsigned int processed = 0;
 	uint32_t progress_nr;
+	size_t objects_nr = 0;
 	init_threaded_search();
 
 	if (!nr)
@@ -3504,9 +3680,25 @@ static void ll_find_deltas_by_region(struct object_entry *list,
 		progress_state = start_progress(the_repository,
 						_("Compressing objects by path"),
 						progress_nr);
-	/* Partition the work amongst work threads. */
+	for (i = 0; i < nr; i++)
+		objects_nr += regions[i].nr;
+
+	/*
+	 * Partition the work amongst work threads. The sizes of regions
+	 * vary a lot, so give each thread about the same number of
+	 * objects rather than of regions.
+	 */
 	for (i = 0; i < delta_search_threads; i++) {
-		unsigned sub_size = nr / (delta_search_threads - i);
+		size_t share = objects_nr / (delta_search_threads - i);
+		size_t sub_objects = 0;
+		unsigned sub_size = 0;
+
+		while (sub_size < nr &&
+		       (sub_objects < share || i + 1 == delta_search_threads)) {
+			sub_objects += regions[sub_size].nr;
+			sub_size++;
+		}
+		objects_nr -= sub_objects;
 
 		p[i].window = window;
 		p[i].depth = depth;
@@ -3558,8 +3750,9 @@ static void ll_find_deltas_by_region(struct object_entry *list,
 			pthread_cond_wait(&progress_cond, &progress_mutex);
 		}
 
+		/* Each region is searched on its own, so any can be stolen. */
 		for (i = 0; i < delta_search_threads; i++)
-			if (p[i].remaining > 2*window &&
+			if (p[i].remaining > 1 &&
 			    (!victim || victim->remaining < p[i].remaining))
 				victim = &p[i];
 		if (victim) {
@@ -3592,6 +3785,316 @@ static void ll_find_deltas_by_region(struct object_entry *list,
 	stop_progress(&progress_state);
 }
 
+static int delta_hint_base_cmp(const void *va, const void *vb, void *data)
+{
+	const uint32_t *hint_base = data;
+	uint32_t a = *(const uint32_t *)va, b = *(const uint32_t *)vb;
+
+	if (hint_base[a] != hint_base[b])
+		return hint_base[a] < hint_base[b] ? -1 : 1;
+	return a < b ? -1 : (a > b);
+}
+
+/*
+ * Look up the delta hint of "entry" in the .hints file of the pack it
+ * comes from. Returns 1 + the position in to_pack of its hinted base, or
+ * 0 if there is none.
+ */
+static uint32_t find_delta_hint(struct object_entry *entry)
+{
+	struct packed_git *p = IN_PACK(entry);
+	struct object_entry *base;
+	struct object_id base_oid;
+	uint32_t pos, hint;
+
+	if (!p || load_pack_delta_hints(p) < 0 ||
+	    !bsearch_pack(&entry->idx.oid, p, &pos))
+		return 0;
+
+	hint = nth_packed_delta_hint(p, pos);
+	if (hint == DELTA_HINT_WHOLE) {
+		entry->delta_hint_whole = 1;
+		return 0;
+	}
+	if (hint >= p->num_objects ||
+	    nth_packed_object_id(&base_oid, p, hint) < 0)
+		return 0;
+
+	base = packlist_find(&to_pack, &base_oid);
+	if (!base || base == entry || base->preferred_base ||
+	    !base->type_valid || oe_type(base) != oe_type(entry))
+		return 0;
+	if (use_delta_islands &&
+	    !in_same_island(&entry->idx.oid, &base->idx.oid))
+		return 0;
+	return base - to_pack.objects + 1;
+}
+
+/*
+ * Drop the hints that would make delta chains longer than "max_depth",
+ * or that form cycles, which can happen when the hints come from
+ * several packs.
+ */
+static void limit_delta_hint_depth(uint32_t *hint_base, int max_depth)
+{
+	/* 0 while unknown, UINT32_MAX while being computed, else 1 + depth */
+	uint32_t *hint_depth;
+	uint32_t *stack;
+	uint32_t i;
+
+	CALLOC_ARRAY(hint_depth, to_pack.nr_objects);
+	ALLOC_ARRAY(stack, to_pack.nr_objects);
+
+	for (i = 0; i < to_pack.nr_objects; i++) {
+		uint32_t nr = 0, cur = i, d;
+
+		while (hint_base[cur] && !hint_depth[cur]) {
+			hint_depth[cur] = UINT32_MAX;
+			stack[nr++] = cur;
+			cur = hint_base[cur] - 1;
+		}
+
+		if (hint_depth[cur] == UINT32_MAX) {
+			/* cut the cycle */
+			hint_base[stack[nr - 1]] = 0;
+			d = 0;
+		} else if (hint_depth[cur]) {
+			d = hint_depth[cur] - 1;
+		} else {
+			d = to_pack.objects[cur].depth;
+		}
+
+		while (nr--) {
+			cur = stack[nr];
+			if (!hint_base[cur] || d + 1 > max_depth) {
+				hint_base[cur] = 0;
+				d = 0;
+			} else {
+				d++;
+			}
+			hint_depth[cur] = d + 1;
+		}
+	}
+
+	free(stack);
+	free(hint_depth);
+}
+
+/*
+ * Deltify the hinted objects in "hinted", which is sorted by hinted base,
+ * against their bases. Returns the number of deltas found.
+ *
+ * All objects hinted to the same base are handled by the same call, so
+ * with threads, each object entry is only written to by one thread.
+ */
+static uint32_t find_hinted_deltas(const uint32_t *hinted, uint32_t nr,
+				   const uint32_t *hint_base)
+{
+	uint32_t i, j, used = 0;
+
+	for (i = 0; i < nr; i = j) {
+		struct object_entry *base = to_pack.objects + hint_base[hinted[i]] - 1;
+		struct delta_index *index = NULL;
+		enum object_type type;
+		unsigned long base_size, mem_usage = 0;
+		void *base_data;
+
+		packing_data_lock(&to_pack);
+		base_data = odb_read_object(the_repository->objects,
+					    &base->idx.oid, &type, &base_size);
+		packing_data_unlock(&to_pack);
+		if (base_data)
+			index = create_delta_index(base_data, base_size);
+		if (index)
+			mem_usage = base_size + sizeof_delta_index(index);
+
+		for (j = i; j < nr && hint_base[hinted[j]] == hint_base[hinted[i]]; j++) {
+			struct object_entry *entry = to_pack.objects + hinted[j];
+			unsigned long size, delta_size, max_size;
+			void *data, *delta_data;
+
+			if (!index)
+				continue;
+			/*
+			 * Like find_deltas(), do not hold more than the
+			 * window memory limit for the base and its target.
+			 */
+			if (window_memory_limit &&
+			    mem_usage + SIZE(entry) > window_memory_limit)
+				continue;
+			packing_data_lock(&to_pack);
+			data = odb_read_object(the_repository->objects,
+					       &entry->idx.oid, &type, &size);
+			packing_data_unlock(&to_pack);
+			if (!data)
+				continue;
+
+			max_size = size / 2;
+			if (max_size > the_hash_algo->rawsz)
+				max_size -= the_hash_algo->rawsz;
+			delta_data = create_delta(index, data, size,
+						  &delta_size, max_size);
+			free(data);
+			if (!delta_data)
+				continue;
+
+			SET_DELTA(entry, base);
+			SET_DELTA_SIZE(entry, delta_size);
+			entry->delta_sibling_idx = base->delta_child_idx;
+			SET_DELTA_CHILD(base, entry);
+			cache_lock();
+			if (delta_cacheable(base_size, size, delta_size)) {
+				delta_cache_size += delta_size;
+				cache_unlock();
+				entry->delta_data = delta_data;
+				if (!pack_to_stdout)
+					compress_cached_delta(entry);
+			} else {
+				cache_unlock();
+				free(delta_data);
+			}
+			used++;
+		}
+
+		free_delta_index(index);
+		free(base_data);
+	}
+
+	return used;
+}
+
+struct hinted_delta_params {
+	pthread_t thread;
+	const uint32_t *hinted;
+	const uint32_t *hint_base;
+	uint32_t nr;
+	uint32_t used;
+};
+
+static void *threaded_find_hinted_deltas(void *arg)
+{
+	struct hinted_delta_params *me = arg;
+	me->used = find_hinted_deltas(me->hinted, me->nr, me->hint_base);
+	return NULL;
+}
+
+/*
+ * Split the hinted objects among the delta search threads, without
+ * splitting the objects hinted to the same base. Unlike the window
+ * search, every object costs about the same here, so there is no need
+ * to rebalance the work while the threads run.
+ */
+static uint32_t ll_find_hinted_deltas(const uint32_t *hinted, uint32_t nr,
+				      const uint32_t *hint_base)
+{
+	struct hinted_delta_params *p;
+	uint32_t used = 0;
+	int i, ret;
+
+	if (delta_search_threads <= 1 || nr < 2)
+		return find_hinted_deltas(hinted, nr, hint_base);
+
+	init_threaded_search();
+	CALLOC_ARRAY(p, delta_search_threads);
+	for (i = 0; i < delta_search_threads; i++) {
+		uint32_t sub_size = nr / (delta_search_threads - i);
+
+		while (sub_size && sub_size < nr &&
+		       hint_base[hinted[sub_size]] == hint_base[hinted[sub_size - 1]])
+			sub_size++;
+
+		p[i].hinted = hinted;
+		p[i].hint_base = hint_base;
+		p[i].nr = sub_size;
+		hinted += sub_size;
+		nr -= sub_size;
+
+		if (!p[i].nr)
+			continue;
+		ret = pthread_create(&p[i].thread, NULL,
+				     threaded_find_hinted_deltas, &p[i]);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+	for (i = 0; i < delta_search_threads; i++) {
+		if (!p[i].nr)
+			continue;
+		pthread_join(p[i].thread, NULL);
+		used += p[i].used;
+	}
+	cleanup_threaded_search();
+	free(p);
+
+	return used;
+}
+
+/*
+ * Use the delta hints of the packs we read objects from. An object whose
+ * earlier delta base is still around is deltified against it right away,
+ * and does not take part in the window search. An object for which an
+ * earlier search found no base is only tried against objects without
+ * such a hint in the window search.
+ */
+static void apply_delta_hints(int max_depth)
+{
+	uint32_t *hint_base, *hinted;
+	uint32_t i, hinted_nr = 0, used, whole = 0;
+
+	CALLOC_ARRAY(hint_base, to_pack.nr_objects);
+	for (i = 0; i < to_pack.nr_objects; i++) {
+		struct object_entry *entry = to_pack.objects + i;
+
+		if (entry->preferred_base || DELTA(entry) ||
+		    !entry->type_valid || entry->no_try_delta)
+			continue;
+		hint_base[i] = find_delta_hint(entry);
+		if (entry->delta_hint_whole)
+			whole++;
+	}
+
+	limit_delta_hint_depth(hint_base, max_depth);
+
+	ALLOC_ARRAY(hinted, to_pack.nr_objects);
+	for (i = 0; i < to_pack.nr_objects; i++)
+		if (hint_base[i])
+			hinted[hinted_nr++] = i;
+	QSORT_S(hinted, hinted_nr, delta_hint_base_cmp, hint_base);
+
+	used = ll_find_hinted_deltas(hinted, hinted_nr, hint_base);
+
+	trace2_data_intmax("pack-objects", the_repository,
+			   "delta-hints/used", used);
+	trace2_data_intmax("pack-objects", the_repository,
+			   "delta-hints/whole", whole);
+
+	free(hinted);
+	free(hint_base);
+}
+
+/*
+ * Record what we know about the delta base of each object, for
+ * write_pack_file() to write into a .hints file.
+ */
+static void record_delta_hints(void)
+{
+	uint32_t i;
+
+	ALLOC_ARRAY(to_pack.delta_hint, to_pack.nr_objects);
+	for (i = 0; i < to_pack.nr_objects; i++) {
+		struct object_entry *entry = to_pack.objects + i;
+		struct object_entry *base = DELTA(entry);
+
+		if (base && !entry->ext_base)
+			to_pack.delta_hint[i] = base - to_pack.objects + 1;
+		else if (!base && searched_deltas &&
+			 (entry->delta_hint_whole ||
+			  should_attempt_deltas(entry)))
+			to_pack.delta_hint[i] = DELTA_HINT_WHOLE;
+		else
+			to_pack.delta_hint[i] = DELTA_HINT_NONE;
+	}
+}
+
 static void prepare_pack(int window, int depth)
 {
 	struct object_entry **delta_list;
@@ -3616,6 +4119,10 @@ static void prepare_pack(int window, int depth)
 	if (!to_pack.nr_objects || !window || !depth)
 		return;
 
+	if (delta_hints)
+		apply_delta_hints(depth);
+	searched_deltas = 1;
+
 	if (path_walk)
 		ll_find_deltas_by_region(to_pack.objects, to_pack.regions,
 					 0, to_pack.nr_regions);
@@ -3654,6 +4161,10 @@ static void prepare_pack(int window, int depth)
 static int git_pack_config(const char *k, const char *v,
 			   const struct config_context *ctx, void *cb)
 {
+	if (!strcmp(k, "pack.deltahints")) {
+		delta_hints = git_config_bool(k, v);
+		return 0;
+	}
 	if (!strcmp(k, "pack.window")) {
 		window = git_config_int(k, v, ctx->kvi);
 		return 0;
@@ -4782,6 +5293,7 @@ static int get_object_list_path_walk(struct rev_info *revs)
 	 */
 	info.prune_all_uninteresting = sparse;
 	info.edge_aggressive = shallow;
+	info.threads = delta_search_threads;
 
 	trace2_region_enter("pack-objects", "path-walk", revs->repo);
 	result = walk_objects_by_path(&info);
@@ -5401,6 +5913,8 @@ int cmd_pack_objects(int argc,
 
 	trace2_region_enter("pack-objects", "write-pack-file", the_repository);
 	write_excluded_by_configs();
+	if (delta_hints && !pack_to_stdout)
+		record_delta_hints();
 	write_pack_file();
 	trace2_region_leave("pack-objects", "write-pack-file", the_repository);
 
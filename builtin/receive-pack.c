@@ -81,6 +81,7 @@ static int auto_update_server_info;
 static int auto_gc = 1;
 static int reject_thin;
 static int skip_connectivity_check;
+static int use_bitmap_index;
 static int stateless_rpc;
 static const char *service_dir;
 static const char *head_name;
@@ -234,6 +235,11 @@ static int receive_pack_config(const char *var, const char *value,
 		return 0;
 	}
 
+	if (strcmp(var, "receive.usebitmaps") == 0) {
+		use_bitmap_index = git_config_bool(var, value);
+		return 0;
+	}
+
 	if (strcmp(var, "receive.certnonceseed") == 0)
 		return git_config_string(&cert_nonce_seed, var, value);
 
@@ -1494,7 +1500,8 @@ static const char *update_worktree(unsigned char *sha1, const struct worktree *w
 	return retval;
 }
 
-static const char *update(struct command *cmd, struct shallow_info *si)
+static const char *update(struct command *cmd, struct shallow_info *si,
+			  struct worktree **worktrees)
 {
 	const char *name = cmd->ref_name;
 	struct strbuf namespaced_name_buf = STRBUF_INIT;
@@ -1503,7 +1510,6 @@ static const char *update(struct command *cmd, struct shallow_info *si)
 	struct object_id *old_oid = &cmd->old_oid;
 	struct object_id *new_oid = &cmd->new_oid;
 	int do_update_worktree = 0;
-	struct worktree **worktrees = get_worktrees();
 	const struct worktree *worktree =
 		find_shared_symref(worktrees, "HEAD", name);
 
@@ -1670,7 +1676,6 @@ static const char *update(struct command *cmd, struct shallow_info *si)
 	}
 
 out:
-	free_worktrees(worktrees);
 	return ret;
 }
 
@@ -1789,26 +1794,74 @@ static const struct object_id *command_singleton_iterator(void *cb_data)
 	return &cmd->new_oid;
 }
 
+struct command_range {
+	struct command **cmds;
+	size_t nr;
+};
+
+static const struct object_id *command_range_iterator(void *cb_data)
+{
+	struct command_range *range = cb_data;
+
+	while (range->nr) {
+		struct command *cmd = *range->cmds;
+
+		range->cmds++;
+		range->nr--;
+		if (!is_null_oid(&cmd->new_oid))
+			return &cmd->new_oid;
+	}
+	return NULL;
+}
+
+/*
+ * Find the commands whose new values are not connected, given that
+ * the check failed for all of them together, by checking halves of
+ * the range instead of each command on its own: a push of thousands
+ * of refs with a single bad one then spawns a few dozen rev-list
+ * processes, not thousands.
+ */
+static void find_connectivity_errors(struct command **cmds, size_t nr)
+{
+	if (nr == 1) {
+		cmds[0]->error_string = "missing necessary objects";
+		return;
+	}
+
+	for (int half = 0; half < 2; half++) {
+		struct check_connected_options opt = CHECK_CONNECTED_INIT;
+		struct command **sub = half ? cmds + nr / 2 : cmds;
+		size_t sub_nr = half ? nr - nr / 2 : nr / 2;
+		struct command_range range = { sub, sub_nr };
+
+		opt.env = tmp_objdir_env(tmp_objdir);
+		opt.use_bitmap_index = use_bitmap_index;
+		/* only complain about the commands that are to blame */
+		opt.quiet = sub_nr > 1;
+		if (check_connected(command_range_iterator, &range, &opt))
+			find_connectivity_errors(sub, sub_nr);
+	}
+}
+
 static void set_connectivity_errors(struct command *commands,
 				    struct shallow_info *si)
 {
 	struct command *cmd;
+	struct command **cmds = NULL;
+	size_t nr = 0, alloc = 0;
 
 	for (cmd = commands; cmd; cmd = cmd->next) {
-		struct command *singleton = cmd;
-		struct check_connected_options opt = CHECK_CONNECTED_INIT;
-
 		if (shallow_update && si->shallow_ref[cmd->index])
 			/* to be checked in update_shallow_ref() */
 			continue;
 
-		opt.env = tmp_objdir_env(tmp_objdir);
-		if (!check_connected(command_singleton_iterator, &singleton,
-				     &opt))
-			continue;
-
-		cmd->error_string = "missing necessary objects";
+		ALLOC_GROW(cmds, nr + 1, alloc);
+		cmds[nr++] = cmd;
 	}
+
+	if (nr)
+		find_connectivity_errors(cmds, nr);
+	free(cmds);
 }
 
 struct iterate_data {
@@ -1903,6 +1956,7 @@ static void execute_commands_non_atomic(struct command *commands,
 	struct strbuf err = STRBUF_INIT;
 	const char *reported_error = NULL;
 	struct strmap failed_refs = STRMAP_INIT;
+	struct worktree **worktrees = get_worktrees();
 
 	/*
 	 * Reference updates, where D/F conflicts shouldn't arise due to
@@ -1945,7 +1999,7 @@ static void execute_commands_non_atomic(struct command *commands,
 				}
 			}
 
-			cmd->error_string = update(cmd, si);
+			cmd->error_string = update(cmd, si, worktrees);
 		}
 
 		/* No transaction, so nothing to commit */
@@ -1980,6 +2034,8 @@ static void execute_commands_non_atomic(struct command *commands,
 		strmap_clear(&failed_refs, 0);
 		strbuf_release(&err);
 	}
+
+	free_worktrees(worktrees);
 }
 
 static void execute_commands_atomic(struct command *commands,
@@ -1988,6 +2044,7 @@ static void execute_commands_atomic(struct command *commands,
 	struct command *cmd;
 	struct strbuf err = STRBUF_INIT;
 	const char *reported_error = "atomic push failure";
+	struct worktree **worktrees = get_worktrees();
 
 	transaction = ref_store_transaction_begin(get_main_ref_store(the_repository),
 						  0, &err);
@@ -2002,7 +2059,7 @@ static void execute_commands_atomic(struct command *commands,
 		if (!should_process_cmd(cmd) || cmd->run_proc_receive)
 			continue;
 
-		cmd->error_string = update(cmd, si);
+		cmd->error_string = update(cmd, si, worktrees);
 
 		if (cmd->error_string)
 			goto failure;
@@ -2023,6 +2080,7 @@ static void execute_commands_atomic(struct command *commands,
 cleanup:
 	ref_transaction_free(transaction);
 	strbuf_release(&err);
+	free_worktrees(worktrees);
 }
 
 static void execute_commands(struct command *commands,
@@ -2044,6 +2102,8 @@ static void execute_commands(struct command *commands,
 	}
 
 	if (!skip_connectivity_check) {
+		trace2_region_enter("receive-pack", "check_connected",
+				    the_repository);
 		if (use_sideband) {
 			memset(&muxer, 0, sizeof(muxer));
 			muxer.proc = copy_to_sideband;
@@ -2059,12 +2119,15 @@ static void execute_commands(struct command *commands,
 		opt.progress = err_fd && !quiet;
 		opt.env = tmp_objdir_env(tmp_objdir);
 		opt.exclude_hidden_refs_section = "receive";
+		opt.use_bitmap_index = use_bitmap_index;
 
 		if (check_connected(iterate_receive_command_list, &data, &opt))
 			set_connectivity_errors(commands, si);
 
 		if (use_sideband)
 			finish_async(&muxer);
+		trace2_region_leave("receive-pack", "check_connected",
+				    the_repository);
 	}
 
 	reject_updates_to_hidden(commands);
@@ -2106,14 +2169,18 @@ static void execute_commands(struct command *commands,
 	 * Now we'll start writing out refs, which means the objects need
 	 * to be in their final positions so that other processes can see them.
 	 */
+	trace2_region_enter("receive-pack", "migrate_objects", the_repository);
 	if (tmp_objdir_migrate(tmp_objdir) < 0) {
 		for (cmd = commands; cmd; cmd = cmd->next) {
 			if (!cmd->error_string)
 				cmd->error_string = "unable to migrate objects to permanent storage";
 		}
+		trace2_region_leave("receive-pack", "migrate_objects",
+				    the_repository);
 		return;
 	}
 	tmp_objdir = NULL;
+	trace2_region_leave("receive-pack", "migrate_objects", the_repository);
 
 	check_aliased_updates(commands);
 
@@ -2130,10 +2197,12 @@ static void execute_commands(struct command *commands,
 			    (cmd->run_proc_receive || use_atomic))
 				cmd->error_string = "fail to run proc-receive hook";
 
+	trace2_region_enter("receive-pack", "update_refs", the_repository);
 	if (use_atomic)
 		execute_commands_atomic(commands, si);
 	else
 		execute_commands_non_atomic(commands, si);
+	trace2_region_leave("receive-pack", "update_refs", the_repository);
 
 	if (shallow_update)
 		BUG_if_skipped_connectivity_check(commands, si);
@@ -2707,7 +2776,11 @@ int cmd_receive_pack(int argc,
 		if (!si.nr_ours && !si.nr_theirs)
 			shallow_update = 0;
 		if (!delete_only(commands)) {
+			trace2_region_enter("receive-pack", "unpack",
+					    the_repository);
 			unpack_status = unpack_with_sideband(&si);
+			trace2_region_leave("receive-pack", "unpack",
+					    the_repository);
 			update_shallow_info(commands, &si, &ref);
 		}
 		use_keepalive = KEEPALIVE_ALWAYS;
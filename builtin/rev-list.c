@@ -478,13 +478,22 @@ static int show_bisect_vars(struct rev_list_info *info, int reaches, int all)
 
 static int show_object_fast(
 	const struct object_id *oid,
-	enum object_type type UNUSED,
+	enum object_type type,
 	int exclude UNUSED,
 	uint32_t name_hash UNUSED,
-	struct packed_git *found_pack UNUSED,
+	struct packed_git *found_pack,
 	off_t found_offset UNUSED,
 	void *payload UNUSED)
 {
+	/*
+	 * Objects outside of the bitmapped pack were found by walking
+	 * the history the bitmaps do not cover, which does not look at
+	 * blobs. Make sure they exist, like a walk without bitmaps does.
+	 */
+	if (!found_pack && arg_missing_action == MA_ERROR &&
+	    !odb_has_object(the_repository->objects, oid, 0))
+		die("missing %s object '%s'", type_name(type), oid_to_hex(oid));
+
 	fprintf(stdout, "%s\n", oid_to_hex(oid));
 	return 1;
 }
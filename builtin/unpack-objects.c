@@ -20,7 +20,9 @@
 #include "progress.h"
 #include "decorate.h"
 #include "fsck.h"
+#include "oidmap.h"
 #include "packfile.h"
+#include "repo-settings.h"
 
 static int dry_run, quiet, recover, has_errors, strict;
 static const char unpack_usage[] = "git unpack-objects [-n] [-q] [-r] [--strict]";
@@ -158,35 +160,24 @@ static void *get_data(unsigned long size)
 }
 
 struct delta_info {
-	struct object_id base_oid;
 	unsigned nr;
-	off_t base_offset;
 	unsigned long size;
 	void *delta;
 	struct delta_info *next;
 };
 
-static struct delta_info *delta_list;
-
-static void add_delta_to_list(unsigned nr, const struct object_id *base_oid,
-			      off_t base_offset,
-			      void *delta, unsigned long size)
-{
-	struct delta_info *info = xmalloc(sizeof(*info));
-
-	oidcpy(&info->base_oid, base_oid);
-	info->base_offset = base_offset;
-	info->size = size;
-	info->delta = delta;
-	info->nr = nr;
-	info->next = delta_list;
-	delta_list = info;
-}
-
 struct obj_info {
 	off_t offset;
 	struct object_id oid;
 	struct object *obj;
+
+	/* deltas in this pack waiting for this object as their base */
+	struct delta_info *deltas;
+
+	/* contents kept around in case a later delta is based on it */
+	void *data;
+	unsigned long size;
+	enum object_type type;
 };
 
 /* Remember to update object flag allocation in object.h */
@@ -196,6 +187,92 @@ struct obj_info {
 static struct obj_info *obj_list;
 static unsigned nr_objects;
 
+/*
+ * Deltas that cannot be resolved yet, because their base has not been
+ * seen. Those against a base by name are kept in a map from the name
+ * of the base to a "struct ref_delta_base"; those against an earlier
+ * object in the pack are queued on that object's obj_info.
+ */
+struct ref_delta_base {
+	struct oidmap_entry entry;
+	struct delta_info *deltas;
+};
+
+static struct oidmap ref_deltas = OIDMAP_INIT;
+static unsigned nr_pending_deltas;
+
+static void add_delta_to_list(struct delta_info **list, unsigned nr,
+			      void *delta, unsigned long size)
+{
+	struct delta_info *info = xmalloc(sizeof(*info));
+
+	info->size = size;
+	info->delta = delta;
+	info->nr = nr;
+	info->next = *list;
+	*list = info;
+	nr_pending_deltas++;
+}
+
+static void add_ref_delta(unsigned nr, const struct object_id *base_oid,
+			  void *delta, unsigned long size)
+{
+	struct ref_delta_base *base = oidmap_get(&ref_deltas, base_oid);
+
+	if (!base) {
+		CALLOC_ARRAY(base, 1);
+		oidcpy(&base->entry.oid, base_oid);
+		oidmap_put(&ref_deltas, base);
+	}
+	add_delta_to_list(&base->deltas, nr, delta, size);
+}
+
+/*
+ * Objects written out are kept in core for a while, so that deltas
+ * against them later in the pack do not have to read them back from
+ * the object store. The oldest ones are dropped first once their total
+ * size exceeds core.deltaBaseCacheLimit.
+ */
+static unsigned *cached_bases;
+static size_t cached_bases_nr, cached_bases_alloc, cached_bases_first;
+static size_t cached_bytes;
+
+static void cache_base(unsigned nr, enum object_type type,
+		       void *data, unsigned long size)
+{
+	struct obj_info *info = &obj_list[nr];
+	size_t limit = the_repository->settings.delta_base_cache_limit;
+
+	if (size > limit) {
+		free(data);
+		return;
+	}
+
+	info->data = data;
+	info->size = size;
+	info->type = type;
+	ALLOC_GROW(cached_bases, cached_bases_nr + 1, cached_bases_alloc);
+	cached_bases[cached_bases_nr++] = nr;
+	cached_bytes += size;
+
+	while (cached_bytes > limit) {
+		struct obj_info *old = &obj_list[cached_bases[cached_bases_first++]];
+		cached_bytes -= old->size;
+		FREE_AND_NULL(old->data);
+	}
+}
+
+static void free_cached_bases(void)
+{
+	size_t i;
+
+	for (i = cached_bases_first; i < cached_bases_nr; i++)
+		FREE_AND_NULL(obj_list[cached_bases[i]].data);
+	FREE_AND_NULL(cached_bases);
+	cached_bases_nr = cached_bases_alloc = cached_bases_first = 0;
+	cached_bytes = 0;
+}
+
 /*
  * Called only from check_object() after it verified this object
  * is Ok.
@@ -276,7 +353,7 @@ static void write_object(unsigned nr, enum object_type type,
 				     &obj_list[nr].oid) < 0)
 			die("failed to write object");
 		added_object(nr, type, buf, size);
-		free(buf);
+		cache_base(nr, type, buf, size);
 		obj_list[nr].obj = NULL;
 	} else if (type == OBJ_BLOB) {
 		struct blob *blob;
@@ -284,7 +361,7 @@ static void write_object(unsigned nr, enum object_type type,
 				     &obj_list[nr].oid) < 0)
 			die("failed to write object");
 		added_object(nr, type, buf, size);
-		free(buf);
+		cache_base(nr, type, buf, size);
 
 		blob = lookup_blob(the_repository, &obj_list[nr].oid);
 		if (blob)
@@ -325,6 +402,20 @@ static void resolve_delta(unsigned nr, enum object_type type,
 	write_object(nr, type, result, result_size);
 }
 
+static void resolve_delta_list(struct delta_info *list, enum object_type type,
+			       void *data, unsigned long size)
+{
+	while (list) {
+		struct delta_info *info = list;
+
+		list = info->next;
+		nr_pending_deltas--;
+		resolve_delta(info->nr, type, data, size,
+			      info->delta, info->size);
+		free(info);
+	}
+}
+
 /*
  * We now know the contents of an object (which is nr-th in the pack);
  * resolve all the deltified objects that are based on it.
@@ -332,20 +423,18 @@ static void resolve_delta(unsigned nr, enum object_type type,
 static void added_object(unsigned nr, enum object_type type,
 			 void *data, unsigned long size)
 {
-	struct delta_info **p = &delta_list;
-	struct delta_info *info;
-
-	while ((info = *p) != NULL) {
-		if (oideq(&info->base_oid, &obj_list[nr].oid) ||
-		    info->base_offset == obj_list[nr].offset) {
-			*p = info->next;
-			p = &delta_list;
-			resolve_delta(info->nr, type, data, size,
-				      info->delta, info->size);
-			free(info);
-			continue;
-		}
-		p = &info->next;
+	struct delta_info *list = obj_list[nr].deltas;
+	struct ref_delta_base *base;
+
+	obj_list[nr].deltas = NULL;
+	resolve_delta_list(list, type, data, size);
+
+	if (!oidmap_get_size(&ref_deltas))
+		return;
+	base = oidmap_remove(&ref_deltas, &obj_list[nr].oid);
+	if (base) {
+		resolve_delta_list(base->deltas, type, data, size);
+		free(base);
 	}
 }
 
@@ -453,11 +542,11 @@ static void unpack_delta_entry(enum object_type type, unsigned long delta_size,
 		else {
 			/* cannot resolve yet --- queue it */
 			oidclr(&obj_list[nr].oid, the_repository->hash_algo);
-			add_delta_to_list(nr, &base_oid, 0, delta_data, delta_size);
+			add_ref_delta(nr, &base_oid, delta_data, delta_size);
 			return;
 		}
 	} else {
-		unsigned base_found = 0;
+		struct obj_info *base_info = NULL;
 		unsigned char *pack, c;
 		off_t base_offset;
 		unsigned lo, mid, hi;
@@ -491,21 +580,35 @@ static void unpack_delta_entry(enum object_type type, unsigned long delta_size,
 			} else if (base_offset > obj_list[mid].offset) {
 				lo = mid + 1;
 			} else {
-				oidcpy(&base_oid, &obj_list[mid].oid);
-				base_found = !is_null_oid(&base_oid);
+				base_info = &obj_list[mid];
 				break;
 			}
 		}
-		if (!base_found) {
+		if (!base_info) {
+			error("no object at delta base offset %"PRIuMAX,
+			      (uintmax_t)base_offset);
+			if (!recover)
+				exit(1);
+			has_errors = 1;
+			free(delta_data);
+			return;
+		}
+		if (is_null_oid(&base_info->oid)) {
 			/*
 			 * The delta base object is itself a delta that
 			 * has not been resolved yet.
 			 */
 			oidclr(&obj_list[nr].oid, the_repository->hash_algo);
-			add_delta_to_list(nr, null_oid(the_hash_algo), base_offset,
+			add_delta_to_list(&base_info->deltas, nr,
 					  delta_data, delta_size);
 			return;
 		}
+		if (base_info->data) {
+			resolve_delta(nr, base_info->type, base_info->data,
+				      base_info->size, delta_data, delta_size);
+			return;
+		}
+		oidcpy(&base_oid, &base_info->oid);
 	}
 
 	if (resolve_against_held(nr, &base_oid, delta_data, delta_size))
@@ -595,6 +698,8 @@ static void unpack_all(void)
 	if (!quiet)
 		progress = start_progress(the_repository,
 					  _("Unpacking objects"), nr_objects);
+	prepare_repo_settings(the_repository);
+	oidmap_init(&ref_deltas, 0);
 	CALLOC_ARRAY(obj_list, nr_objects);
 	transaction = odb_transaction_begin(the_repository->objects);
 	for (i = 0; i < nr_objects; i++) {
@@ -603,9 +708,11 @@ static void unpack_all(void)
 	}
 	odb_transaction_commit(transaction);
 	stop_progress(&progress);
+	free_cached_bases();
 
-	if (delta_list)
+	if (nr_pending_deltas)
 		die("unresolved deltas left after unpacking");
+	oidmap_clear(&ref_deltas, 1);
 }
 
 int cmd_unpack_objects(int argc,
@@ -4,12 +4,17 @@
 #include "commit.h"
 #include "commit-graph.h"
 #include "decorate.h"
+#include "gettext.h"
 #include "hex.h"
+#include "pack-bitmap.h"
+#include "parse.h"
 #include "prio-queue.h"
 #include "ref-filter.h"
 #include "revision.h"
 #include "tag.h"
 #include "commit-reach.h"
+#include "thread-utils.h"
+#include "trace2.h"
 #include "ewah/ewok.h"
 
 /* Remember to update object flag allocation in object.h */
@@ -759,7 +764,8 @@ static int in_commit_list(const struct commit_list *want, struct commit *c)
  * Test whether the candidate is contained in the list.
  * Do not recurse to find out, though, but return -1 if inconclusive.
  */
-static enum contains_result contains_test(struct commit *candidate,
+static enum contains_result contains_test(struct ref_filter *filter,
+					  struct commit *candidate,
 					  const struct commit_list *want,
 					  struct contains_cache *cache,
 					  timestamp_t cutoff)
@@ -776,6 +782,17 @@ static enum contains_result contains_test(struct commit *candidate,
 		return CONTAINS_YES;
 	}
 
+	/* or does our reachability bitmap tell? */
+	if (filter->internal.bitmap_git) {
+		int ret = bitmap_commit_contains(filter->internal.bitmap_git,
+						 candidate, want);
+		if (ret >= 0) {
+			filter->internal.bitmap_contains_nr++;
+			*cached = ret ? CONTAINS_YES : CONTAINS_NO;
+			return *cached;
+		}
+	}
+
 	/* Otherwise, we don't know; prepare to recurse */
 	parse_commit_or_die(candidate);
 
@@ -792,7 +809,8 @@ static void push_to_contains_stack(struct commit *candidate, struct contains_sta
 	contains_stack->contains_stack[contains_stack->nr++].parents = candidate->parents;
 }
 
-static enum contains_result contains_tag_algo(struct commit *candidate,
+static enum contains_result contains_tag_algo(struct ref_filter *filter,
+					      struct commit *candidate,
 					      const struct commit_list *want,
 					      struct contains_cache *cache)
 {
@@ -810,7 +828,7 @@ static enum contains_result contains_tag_algo(struct commit *candidate,
 			cutoff = generation;
 	}
 
-	result = contains_test(candidate, want, cache, cutoff);
+	result = contains_test(filter, candidate, want, cache, cutoff);
 	if (result != CONTAINS_UNKNOWN)
 		return result;
 
@@ -828,7 +846,7 @@ static enum contains_result contains_tag_algo(struct commit *candidate,
 		 * If we just popped the stack, parents->item has been marked,
 		 * therefore contains_test will return a meaningful yes/no.
 		 */
-		else switch (contains_test(parents->item, want, cache, cutoff)) {
+		else switch (contains_test(filter, parents->item, want, cache, cutoff)) {
 		case CONTAINS_YES:
 			*contains_cache_at(cache, commit) = CONTAINS_YES;
 			contains_stack.nr--;
@@ -842,14 +860,20 @@ static enum contains_result contains_tag_algo(struct commit *candidate,
 		}
 	}
 	free(contains_stack.contains_stack);
-	return contains_test(candidate, want, cache, cutoff);
+	return contains_test(filter, candidate, want, cache, cutoff);
 }
 
 int commit_contains(struct ref_filter *filter, struct commit *commit,
 		    struct commit_list *list, struct contains_cache *cache)
 {
-	if (filter->with_commit_tag_algo)
-		return contains_tag_algo(commit, list, cache) == CONTAINS_YES;
+	/*
+	 * With reachability bitmaps, the depth-first walk stops at the
+	 * first commits that have a bitmap, and remembers the answers for
+	 * the commits it has seen. This beats a merge-base style walk for
+	 * every ref.
+	 */
+	if (filter->with_commit_tag_algo || filter->internal.bitmap_git)
+		return contains_tag_algo(filter, commit, list, cache) == CONTAINS_YES;
 	return repo_is_descendant_of(the_repository, commit, list);
 }
 
@@ -1114,6 +1138,120 @@ static void free_bit_array(struct commit *c)
 	*bitmap = NULL;
 }
 
+/*
+ * With many pairs, ahead_behind() spends most of its time checking the
+ * bit array of every walked commit against every pair. The walk itself
+ * has to stay on one thread, but once a commit leaves the queue its bit
+ * array is final, so the counting is done in batches of walked commits,
+ * with each thread owning a disjoint range of the pairs. The counts are
+ * thus the same as those of a single thread.
+ *
+ * Mostly randomly chosen: cap the parallelism at 16 threads, and only
+ * start a thread for at least 1024 pairs.
+ */
+#define AHEAD_BEHIND_BATCH (256)
+#define AHEAD_BEHIND_MAX_THREADS (16)
+#define AHEAD_BEHIND_THREAD_COST (1024)
+
+struct ahead_behind_batch {
+	struct bitmap *bitmaps[AHEAD_BEHIND_BATCH];
+	size_t nr;
+};
+
+struct ahead_behind_thread_data {
+	pthread_t pthread;
+	const struct ahead_behind_batch *batch;
+	struct ahead_behind_count *counts;
+	size_t counts_nr;
+};
+
+static void count_ahead_behind(const struct ahead_behind_batch *batch,
+			       struct ahead_behind_count *counts,
+			       size_t counts_nr)
+{
+	for (size_t i = 0; i < counts_nr; i++) {
+		for (size_t j = 0; j < batch->nr; j++) {
+			struct bitmap *bitmap_c = batch->bitmaps[j];
+			int reach_from_tip = !!bitmap_get(bitmap_c, counts[i].tip_index);
+			int reach_from_base = !!bitmap_get(bitmap_c, counts[i].base_index);
+
+			if (reach_from_tip ^ reach_from_base) {
+				if (reach_from_base)
+					counts[i].behind++;
+				else
+					counts[i].ahead++;
+			}
+		}
+	}
+}
+
+static void *ahead_behind_thread(void *_data)
+{
+	struct ahead_behind_thread_data *data = _data;
+	count_ahead_behind(data->batch, data->counts, data->counts_nr);
+	return NULL;
+}
+
+static int ahead_behind_threads(size_t counts_nr)
+{
+	int threads;
+
+	if (!HAVE_THREADS)
+		return 1;
+
+	threads = git_env_ulong("GIT_TEST_AHEAD_BEHIND_THREADS", 0);
+	if (threads)
+		return threads;
+
+	threads = online_cpus();
+	if (threads > AHEAD_BEHIND_MAX_THREADS)
+		threads = AHEAD_BEHIND_MAX_THREADS;
+	if (counts_nr / AHEAD_BEHIND_THREAD_COST < (size_t)threads)
+		threads = counts_nr / AHEAD_BEHIND_THREAD_COST;
+	return threads ? threads : 1;
+}
+
+static void flush_ahead_behind_batch(struct ahead_behind_batch *batch,
+				     struct ahead_behind_count *counts,
+				     size_t counts_nr,
+				     struct ahead_behind_thread_data *data,
+				     int threads)
+{
+	if (!batch->nr)
+		return;
+
+	if (threads < 2) {
+		count_ahead_behind(batch, counts, counts_nr);
+	} else {
+		size_t nr_each = DIV_ROUND_UP(counts_nr, threads);
+		size_t offset = 0;
+
+		for (int t = 0; t < threads; t++) {
+			struct ahead_behind_thread_data *d = &data[t];
+			int err;
+
+			d->batch = batch;
+			d->counts = counts + offset;
+			d->counts_nr = offset + nr_each < counts_nr ?
+				       nr_each : counts_nr - offset;
+			offset += d->counts_nr;
+
+			err = pthread_create(&d->pthread, NULL,
+					     ahead_behind_thread, d);
+			if (err)
+				die(_("unable to create ahead-behind thread: %s"),
+				    strerror(err));
+		}
+		for (int t = 0; t < threads; t++)
+			if (pthread_join(data[t].pthread, NULL))
+				die("unable to join ahead-behind thread");
+	}
+
+	for (size_t j = 0; j < batch->nr; j++)
+		bitmap_free(batch->bitmaps[j]);
+	batch->nr = 0;
+}
+
 void ahead_behind(struct repository *r,
 		  struct commit **commits, size_t commits_nr,
 		  struct ahead_behind_count *counts, size_t counts_nr)
@@ -1122,6 +1260,9 @@ void ahead_behind(struct repository *r,
 		{ .compare = compare_commits_by_gen_then_commit_date }
 	};
 	size_t width = DIV_ROUND_UP(commits_nr, BITS_IN_EWORD);
+	struct ahead_behind_batch *batch;
+	struct ahead_behind_thread_data *data = NULL;
+	int threads;
 
 	if (!commits_nr || !counts_nr)
 		return;
@@ -1135,6 +1276,12 @@ void ahead_behind(struct repository *r,
 
 	init_bit_arrays(&bit_arrays);
 
+	CALLOC_ARRAY(batch, 1);
+	threads = ahead_behind_threads(counts_nr);
+	if (threads > 1)
+		CALLOC_ARRAY(data, threads);
+	trace2_data_intmax("ahead-behind", r, "threads", threads);
+
 	for (size_t i = 0; i < commits_nr; i++) {
 		struct commit *c = commits[i];
 		struct bitmap *bitmap = get_bit_array(c, width);
@@ -1148,17 +1295,13 @@ void ahead_behind(struct repository *r,
 		struct commit_list *p;
 		struct bitmap *bitmap_c = get_bit_array(c, width);
 
-		for (size_t i = 0; i < counts_nr; i++) {
-			int reach_from_tip = !!bitmap_get(bitmap_c, counts[i].tip_index);
-			int reach_from_base = !!bitmap_get(bitmap_c, counts[i].base_index);
-
-			if (reach_from_tip ^ reach_from_base) {
-				if (reach_from_base)
-					counts[i].behind++;
-				else
-					counts[i].ahead++;
-			}
-		}
+		/*
+		 * The batch takes ownership of the bit array. If 'c' is
+		 * reached again later on, which can happen with skewed
+		 * commit dates and no generation numbers, it gets a fresh
+		 * one and the counted bits stay untouched.
+		 */
+		*bit_arrays_at(&bit_arrays, c) = NULL;
 
 		for (p = c->parents; p; p = p->next) {
 			struct bitmap *bitmap_p;
@@ -1181,8 +1324,16 @@ void ahead_behind(struct repository *r,
 			insert_no_dup(&queue, p->item);
 		}
 
-		free_bit_array(c);
+		/*
+		 * All children of 'c' have been walked already, so its
+		 * bit array can be counted later on.
+		 */
+		batch->bitmaps[batch->nr] = bitmap_c;
+		if (++batch->nr == AHEAD_BEHIND_BATCH)
+			flush_ahead_behind_batch(batch, counts, counts_nr,
+						 data, threads);
 	}
+	flush_ahead_behind_batch(batch, counts, counts_nr, data, threads);
 
 	/* STALE is used here, PARENT2 is used by insert_no_dup(). */
 	repo_clear_commit_marks(r, PARENT2 | STALE);
@@ -1190,6 +1341,8 @@ void ahead_behind(struct repository *r,
 		free_bit_array(queue.pq.array[i].data);
 	clear_bit_arrays(&bit_arrays);
 	clear_nonstale_queue(&queue);
+	free(batch);
+	free(data);
 }
 
 struct commit_and_index {
@@ -100,6 +100,8 @@ int check_connected(oid_iterate_fn fn, void *cb_data,
 	}
 	strvec_push(&rev_list.args, "--quiet");
 	strvec_push(&rev_list.args, "--alternate-refs");
+	if (opt->use_bitmap_index && !repo_has_promisor_remote(the_repository))
+		strvec_push(&rev_list.args, "--use-bitmap-index");
 	if (opt->progress)
 		strvec_pushf(&rev_list.args, "--progress=%s",
 			     _("Checking connectivity"));
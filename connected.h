@@ -53,6 +53,12 @@ struct check_connected_options {
 	 * already-reachable refs.
 	 */
 	const char *exclude_hidden_refs_section;
+
+	/*
+	 * If non-zero, let rev-list use reachability bitmaps, so that the
+	 * history reachable from existing refs need not be walked.
+	 */
+	unsigned use_bitmap_index : 1;
 };
 
 #define CHECK_CONNECTED_INIT { 0 }
@@ -6,6 +6,9 @@
 #include "gettext.h"
 #include "strbuf.h"
 #include "abspath.h"
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
 
 int copy_fd(int ifd, int ofd)
 {
@@ -22,6 +25,45 @@ int copy_fd(int ifd, int ofd)
 	return 0;
 }
 
+int copy_fd_range(int ifd, off_t offset, int ofd, size_t len)
+{
+#ifdef HAVE_SENDFILE
+	while (len) {
+		ssize_t n = sendfile(ofd, ifd, &offset,
+				     len < MAX_IO_SIZE ? len : MAX_IO_SIZE);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			/*
+			 * Not supported for these descriptors, "ofd" is
+			 * non-blocking, or it failed in a way that does not
+			 * tell whether reading or writing is to blame; let
+			 * the loop below carry on from where we are.
+			 */
+			break;
+		}
+		if (!n)
+			return COPY_SHORT_READ;
+		len -= n;
+	}
+#endif
+	while (len) {
+		char buffer[8192];
+		ssize_t n = pread_in_full(ifd, buffer,
+					  len < sizeof(buffer) ? len : sizeof(buffer),
+					  offset);
+		if (n < 0)
+			return COPY_READ_ERROR;
+		if (!n)
+			return COPY_SHORT_READ;
+		if (write_in_full(ofd, buffer, n) < 0)
+			return COPY_WRITE_ERROR;
+		offset += n;
+		len -= n;
+	}
+	return 0;
+}
+
 static int copy_times(const char *dst, const char *src)
 {
 	struct stat st;
@@ -3,7 +3,18 @@
 
 #define COPY_READ_ERROR (-2)
 #define COPY_WRITE_ERROR (-3)
+#define COPY_SHORT_READ (-4)
 int copy_fd(int ifd, int ofd);
+
+/*
+ * Copy "len" bytes starting at "offset" of the regular file "ifd" to
+ * "ofd", without changing the file offset of "ifd". Where the platform
+ * supports it, the data is moved inside the kernel instead of through a
+ * buffer in userspace. Returns 0 on success, or one of the error codes
+ * above. Hitting the end of "ifd" early gives COPY_SHORT_READ, for
+ * which errno is not meaningful.
+ */
+int copy_fd_range(int ifd, off_t offset, int ofd, size_t len);
 int copy_file(const char *dst, const char *src, int mode);
 int copy_file_with_time(const char *dst, const char *src, int mode);
 
@@ -9,6 +9,7 @@
  */
 
 #include "git-compat-util.h"
+#include "copy.h"
 #include "csum-file.h"
 #include "git-zlib.h"
 #include "hash.h"
@@ -146,6 +147,37 @@ void hashwrite(struct hashfile *f, const void *buf, uint32_t count)
 	}
 }
 
+void hashwrite_from_fd(struct hashfile *f, const void *buf, uint32_t count,
+		       int fd, off_t offset)
+{
+	/* small writes are cheaper through our buffer, checking needs it */
+	if (0 <= f->check_fd || count < f->buffer_len) {
+		hashwrite(f, buf, count);
+		return;
+	}
+
+	hashflush(f);
+	if (f->do_crc)
+		f->crc32 = crc32(f->crc32, buf, count);
+	if (!f->skip_hash)
+		git_hash_update(&f->ctx, buf, count);
+	switch (copy_fd_range(fd, offset, f->fd, count)) {
+	case 0:
+		break;
+	case COPY_SHORT_READ:
+		die("unexpected end of data copied to sha1 file '%s'", f->name);
+	case COPY_READ_ERROR:
+		die_errno("unable to read data copied to sha1 file '%s'", f->name);
+	default:
+		if (errno == ENOSPC)
+			die("sha1 file '%s' write error. Out of diskspace", f->name);
+		die_errno("sha1 file '%s' write error", f->name);
+	}
+
+	f->total += count;
+	display_throughput(f->tp, f->total);
+}
+
 struct hashfile *hashfd_check(const struct git_hash_algo *algop,
 			      const char *name)
 {
@@ -76,6 +76,15 @@ void free_hashfile(struct hashfile *f);
 int finalize_hashfile(struct hashfile *, unsigned char *, enum fsync_component, unsigned int);
 void discard_hashfile(struct hashfile *);
 void hashwrite(struct hashfile *, const void *, uint32_t);
+
+/*
+ * Like hashwrite(), for data that is also found in the regular file "fd"
+ * at "offset". The bytes are hashed from "buf", but written out by
+ * copying them from "fd", which can be done without passing them through
+ * userspace again.
+ */
+void hashwrite_from_fd(struct hashfile *f, const void *buf, uint32_t count,
+		       int fd, off_t offset);
 void hashflush(struct hashfile *f);
 void crc32_begin(struct hashfile *);
 uint32_t crc32_end(struct hashfile *);
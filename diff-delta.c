@@ -114,9 +114,15 @@ static const unsigned int U[256] = {
 	0x133eb0ac, 0x6d8b90a1, 0x450d4467, 0x3bb8646a
 };
 
+/*
+ * Entries refer to the reference buffer by offset rather than by
+ * pointer; the delta format cannot address more than 32 bits of it
+ * anyway, and the smaller entries make a bucket fit in fewer cache
+ * lines.
+ */
 struct index_entry {
-	const unsigned char *ptr;
-	unsigned int val;
+	uint32_t val;
+	uint32_t off;
 };
 
 struct unpacked_index_entry {
@@ -129,7 +135,9 @@ struct delta_index {
 	const void *src_buf;
 	unsigned long src_size;
 	unsigned int hash_mask;
-	struct index_entry *hash[FLEX_ARRAY];
+	struct index_entry *entries;
+	/* bucket i is entries[hash[i]] up to entries[hash[i + 1]] */
+	uint32_t hash[FLEX_ARRAY];
 };
 
 struct delta_index * create_delta_index(const void *buf, unsigned long bufsize)
@@ -138,7 +146,8 @@ struct delta_index * create_delta_index(const void *buf, unsigned long bufsize)
 	const unsigned char *data, *buffer = buf;
 	struct delta_index *index;
 	struct unpacked_index_entry *entry, **hash;
-	struct index_entry *packed_entry, **packed_hash;
+	struct index_entry *packed_entry;
+	uint32_t *packed_hash;
 	void *mem;
 	unsigned long memsize;
 
@@ -190,12 +199,12 @@ struct delta_index * create_delta_index(const void *buf, unsigned long bufsize)
 			val = ((val << 8) | data[i]) ^ T[val >> RABIN_SHIFT];
 		if (val == prev_val) {
 			/* keep the lowest of consecutive identical blocks */
-			entry[-1].entry.ptr = data + RABIN_WINDOW;
+			entry[-1].entry.off = data + RABIN_WINDOW - buffer;
 			--entries;
 		} else {
 			prev_val = val;
 			i = val & hmask;
-			entry->entry.ptr = data + RABIN_WINDOW;
+			entry->entry.off = data + RABIN_WINDOW - buffer;
 			entry->entry.val = val;
 			entry->next = hash[i];
 			hash[i] = entry++;
@@ -273,25 +282,25 @@ struct delta_index * create_delta_index(const void *buf, unsigned long bufsize)
 	index->src_size = bufsize;
 	index->hash_mask = hmask;
 
-	mem = index->hash;
-	packed_hash = mem;
+	packed_hash = index->hash;
 	mem = packed_hash + (hsize+1);
 	packed_entry = mem;
+	index->entries = packed_entry;
 
 	for (i = 0; i < hsize; i++) {
 		/*
 		 * Coalesce all entries belonging to one linked list
 		 * into consecutive array entries.
 		 */
-		packed_hash[i] = packed_entry;
+		packed_hash[i] = packed_entry - index->entries;
 		for (entry = hash[i]; entry; entry = entry->next)
 			*packed_entry++ = entry->entry;
 	}
 
 	/* Sentinel value to indicate the length of the last hash bucket */
-	packed_hash[hsize] = packed_entry;
+	packed_hash[hsize] = packed_entry - index->entries;
 
-	assert(packed_entry - (struct index_entry *)mem == entries);
+	assert(packed_entry - index->entries == entries);
 	free(hash);
 
 	return index;
@@ -310,6 +319,29 @@ unsigned long sizeof_delta_index(struct delta_index *index)
 		return 0;
 }
 
+/*
+ * Return the number of leading bytes "a" and "b" have in common, looking
+ * at no more than "len" of them. Compare a word at a time first; only the
+ * word holding the first difference is looked at byte by byte.
+ */
+static inline size_t match_length(const unsigned char *a,
+				  const unsigned char *b, size_t len)
+{
+	size_t n = 0;
+
+	while (len - n >= sizeof(uint64_t)) {
+		uint64_t x, y;
+		memcpy(&x, a + n, sizeof(x));
+		memcpy(&y, b + n, sizeof(y));
+		if (x != y)
+			break;
+		n += sizeof(uint64_t);
+	}
+	while (n < len && a[n] == b[n])
+		n++;
+	return n;
+}
+
 /*
  * The maximum size for any opcode sequence, including the initial header
  * plus Rabin window plus biggest copy.
@@ -374,26 +406,27 @@ create_delta(const struct delta_index *index,
 	msize = 0;
 	while (data < top) {
 		if (msize < 4096) {
-			struct index_entry *entry;
+			const struct index_entry *entry, *end;
 			val ^= U[data[-RABIN_WINDOW]];
 			val = ((val << 8) | *data) ^ T[val >> RABIN_SHIFT];
 			i = val & index->hash_mask;
-			for (entry = index->hash[i]; entry < index->hash[i+1]; entry++) {
-				const unsigned char *ref = entry->ptr;
-				const unsigned char *src = data;
-				unsigned int ref_size = ref_top - ref;
+			end = index->entries + index->hash[i+1];
+			for (entry = index->entries + index->hash[i]; entry < end; entry++) {
+				const unsigned char *ref;
+				size_t ref_size, len;
 				if (entry->val != val)
 					continue;
-				if (ref_size > top - src)
-					ref_size = top - src;
+				ref = ref_data + entry->off;
+				ref_size = ref_top - ref;
+				if (ref_size > top - data)
+					ref_size = top - data;
 				if (ref_size <= msize)
 					break;
-				while (ref_size-- && *src++ == *ref)
-					ref++;
-				if (msize < ref - entry->ptr) {
+				len = match_length(ref, data, ref_size);
+				if (msize < len) {
 					/* this is our best match so far */
-					msize = ref - entry->ptr;
-					moff = entry->ptr - ref_data;
+					msize = len;
+					moff = entry->off;
 					if (msize >= 4096) /* good enough */
 						break;
 				}
@@ -5324,6 +5324,15 @@ void diff_setup_done(struct diff_options *options)
 	 */
 	if (options->pickaxe_opts & DIFF_PICKAXE_KINDS_MASK)
 		options->flags.recursive = 1;
+	/*
+	 * Allocate the pickaxe cache up front, so that copies of these
+	 * options made during a revision walk share it.
+	 */
+	if (options->pickaxe_opts & (DIFF_PICKAXE_KIND_S | DIFF_PICKAXE_KIND_G) &&
+	    !options->pickaxe_cache) {
+		options->pickaxe_cache = pickaxe_cache_new();
+		options->pickaxe_cache_owner = options;
+	}
 	/*
 	 * When patches are generated, submodules diffed against the work tree
 	 * must be checked for dirtiness too so it can be shown in the output
@@ -7168,6 +7177,11 @@ void diff_free(struct diff_options *options)
 		FREE_AND_NULL(options->objfind);
 	}
 
+	if (options->pickaxe_cache_owner == options)
+		pickaxe_cache_free(options->pickaxe_cache);
+	options->pickaxe_cache = NULL;
+	options->pickaxe_cache_owner = NULL;
+
 	FREE_AND_NULL(options->orderfile);
 	for (size_t i = 0; i < options->anchors_nr; i++)
 		free(options->anchors[i]);
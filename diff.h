@@ -71,6 +71,7 @@ struct diff_options;
 struct diff_queue_struct;
 struct oid_array;
 struct option;
+struct pickaxe_cache;
 struct repository;
 struct rev_info;
 struct userdiff_driver;
@@ -355,6 +356,15 @@ struct diff_options {
 
 	struct oidset *objfind;
 
+	/*
+	 * Compiled -S/-G needle and per-blob match counts, kept across
+	 * the diffcore_pickaxe() calls of a revision walk. Struct copies
+	 * of these options share the cache; only the diff_options that
+	 * allocated it, recorded in pickaxe_cache_owner, frees it.
+	 */
+	struct pickaxe_cache *pickaxe_cache;
+	const struct diff_options *pickaxe_cache_owner;
+
 	/* this is set by diffcore for DIFF_FORMAT_PATCH */
 	int found_changes;
 
@@ -10,13 +10,41 @@
 #include "diffcore.h"
 #include "xdiff-interface.h"
 #include "kwset.h"
+#include "oidmap.h"
 #include "oidset.h"
 #include "pretty.h"
 #include "quote.h"
 
-typedef int (*pickaxe_fn)(mmfile_t *one, mmfile_t *two,
-			  struct diff_options *o,
-			  regex_t *regexp, kwset_t kws);
+struct pickaxe_side {
+	struct diff_filespec *spec;
+	struct userdiff_driver *textconv;
+	mmfile_t mf;
+	unsigned loaded:1;
+};
+
+struct pickaxe_cache;
+
+typedef int (*pickaxe_fn)(struct pickaxe_side *one, struct pickaxe_side *two,
+			  struct diff_options *o, struct pickaxe_cache *pc);
+
+/*
+ * The number of matches of the needle in a blob, kept around because a
+ * revision walk sees most blobs twice: as the postimage of one commit
+ * and as the preimage of its parent.
+ */
+struct pickaxe_count {
+	struct oidmap_entry entry;
+	unsigned int cnt;
+	/* counting stopped at a limit, so cnt is only a lower bound */
+	unsigned incomplete:1;
+};
+
+struct pickaxe_cache {
+	regex_t regex, *regexp;
+	kwset_t kws;
+	pickaxe_fn fn;
+	struct oidmap counts;
+};
 
 struct diffgrep_cb {
 	regex_t *regexp;
@@ -40,40 +68,6 @@ static int diffgrep_consume(void *priv, char *line, unsigned long len)
 	return 0;
 }
 
-static int diff_grep(mmfile_t *one, mmfile_t *two,
-		     struct diff_options *o,
-		     regex_t *regexp, kwset_t kws UNUSED)
-{
-	struct diffgrep_cb ecbdata;
-	xpparam_t xpp;
-	xdemitconf_t xecfg;
-	int ret;
-
-	/*
-	 * We have both sides; need to run textual diff and see if
-	 * the pattern appears on added/deleted lines.
-	 */
-	memset(&xpp, 0, sizeof(xpp));
-	memset(&xecfg, 0, sizeof(xecfg));
-	ecbdata.regexp = regexp;
-	ecbdata.hit = 0;
-	xecfg.flags = XDL_EMIT_NO_HUNK_HDR;
-	xecfg.ctxlen = o->context;
-	xecfg.interhunkctxlen = o->interhunkcontext;
-
-	/*
-	 * An xdiff error might be our "data->hit" from above. See the
-	 * comment for xdiff_emit_line_fn in xdiff-interface.h
-	 */
-	ret = xdi_diff_outf(one, two, NULL, diffgrep_consume,
-			    &ecbdata, &xpp, &xecfg);
-	if (ecbdata.hit)
-		return 1;
-	if (ret)
-		return ret;
-	return 0;
-}
-
 static unsigned int contains(mmfile_t *mf, regex_t *regexp, kwset_t kws,
 			     unsigned int limit)
 {
@@ -117,21 +111,111 @@ static unsigned int contains(mmfile_t *mf, regex_t *regexp, kwset_t kws,
 	return cnt;
 }
 
-static int has_changes(mmfile_t *one, mmfile_t *two,
-		       struct diff_options *o UNUSED,
-		       regex_t *regexp, kwset_t kws)
+static void load_side(struct diff_options *o, struct pickaxe_side *side)
 {
-	unsigned int c1 = one ? contains(one, regexp, kws, 0) : 0;
-	unsigned int c2 = two ? contains(two, regexp, kws, c1 + 1) : 0;
+	if (side->loaded)
+		return;
+	side->mf.size = fill_textconv(o->repo, side->textconv, side->spec,
+				      &side->mf.ptr);
+	side->loaded = 1;
+}
+
+static void release_side(struct pickaxe_side *side)
+{
+	if (side->loaded && side->textconv)
+		free(side->mf.ptr);
+	diff_free_filespec_data(side->spec);
+}
+
+/*
+ * Like contains(), but on the (possibly textconv'ed) contents of one
+ * side of a filepair, and remembering the result for blobs we can
+ * identify by their object name.
+ */
+static unsigned int count_matches(struct diff_options *o,
+				  struct pickaxe_cache *pc,
+				  struct pickaxe_side *side,
+				  unsigned int limit)
+{
+	struct pickaxe_count *e = NULL;
+	int memoize = !side->textconv && side->spec->oid_valid;
+	unsigned int cnt;
+
+	if (!DIFF_FILE_VALID(side->spec))
+		return 0;
+
+	if (memoize) {
+		e = oidmap_get(&pc->counts, &side->spec->oid);
+		if (e && !e->incomplete)
+			return limit && e->cnt > limit ? limit : e->cnt;
+		if (e && limit && e->cnt >= limit)
+			return limit;
+	}
+
+	load_side(o, side);
+	cnt = contains(&side->mf, pc->regexp, pc->kws, limit);
+
+	if (memoize) {
+		if (!e) {
+			CALLOC_ARRAY(e, 1);
+			oidcpy(&e->entry.oid, &side->spec->oid);
+			oidmap_put(&pc->counts, e);
+		}
+		e->cnt = cnt;
+		e->incomplete = limit && cnt == limit;
+	}
+	return cnt;
+}
+
+static int diff_grep(struct pickaxe_side *one, struct pickaxe_side *two,
+		     struct diff_options *o, struct pickaxe_cache *pc)
+{
+	struct diffgrep_cb ecbdata;
+	xpparam_t xpp;
+	xdemitconf_t xecfg;
+	int ret;
+
+	/*
+	 * We have both sides; need to run textual diff and see if
+	 * the pattern appears on added/deleted lines.
+	 */
+	load_side(o, one);
+	load_side(o, two);
+	memset(&xpp, 0, sizeof(xpp));
+	memset(&xecfg, 0, sizeof(xecfg));
+	ecbdata.regexp = pc->regexp;
+	ecbdata.hit = 0;
+	xecfg.flags = XDL_EMIT_NO_HUNK_HDR;
+	xecfg.ctxlen = o->context;
+	xecfg.interhunkctxlen = o->interhunkcontext;
+
+	/*
+	 * An xdiff error might be our "data->hit" from above. See the
+	 * comment for xdiff_emit_line_fn in xdiff-interface.h
+	 */
+	ret = xdi_diff_outf(&one->mf, &two->mf, NULL, diffgrep_consume,
+			    &ecbdata, &xpp, &xecfg);
+	if (ecbdata.hit)
+		return 1;
+	if (ret)
+		return ret;
+	return 0;
+}
+
+static int has_changes(struct pickaxe_side *one, struct pickaxe_side *two,
+		       struct diff_options *o, struct pickaxe_cache *pc)
+{
+	unsigned int c1 = count_matches(o, pc, one, 0);
+	unsigned int c2 = count_matches(o, pc, two, c1 + 1);
 	return c1 != c2;
 }
 
 static int pickaxe_match(struct diff_filepair *p, struct diff_options *o,
-			 regex_t *regexp, kwset_t kws, pickaxe_fn fn)
+			 struct pickaxe_cache *pc)
 {
 	struct userdiff_driver *textconv_one = NULL;
 	struct userdiff_driver *textconv_two = NULL;
-	mmfile_t mf1, mf2;
+	struct pickaxe_side one = { 0 }, two = { 0 };
 	int ret;
 
 	/* ignore unmerged */
@@ -166,23 +250,21 @@ static int pickaxe_match(struct diff_filepair *p, struct diff_options *o,
 	     (!textconv_two && diff_filespec_is_binary(o->repo, p->two))))
 		return 0;
 
-	mf1.size = fill_textconv(o->repo, textconv_one, p->one, &mf1.ptr);
-	mf2.size = fill_textconv(o->repo, textconv_two, p->two, &mf2.ptr);
+	one.spec = p->one;
+	one.textconv = textconv_one;
+	two.spec = p->two;
+	two.textconv = textconv_two;
 
-	ret = fn(&mf1, &mf2, o, regexp, kws);
+	ret = pc->fn(&one, &two, o, pc);
 
-	if (textconv_one)
-		free(mf1.ptr);
-	if (textconv_two)
-		free(mf2.ptr);
-	diff_free_filespec_data(p->one);
-	diff_free_filespec_data(p->two);
+	release_side(&one);
+	release_side(&two);
 
 	return ret;
 }
 
 static void pickaxe(struct diff_queue_struct *q, struct diff_options *o,
-		    regex_t *regexp, kwset_t kws, pickaxe_fn fn)
+		    struct pickaxe_cache *pc)
 {
 	int i;
 	struct diff_queue_struct outq = DIFF_QUEUE_INIT;
@@ -191,7 +273,7 @@ static void pickaxe(struct diff_queue_struct *q, struct diff_options *o,
 		/* Showing the whole changeset if needle exists */
 		for (i = 0; i < q->nr; i++) {
 			struct diff_filepair *p = q->queue[i];
-			if (pickaxe_match(p, o, regexp, kws, fn))
+			if (pickaxe_match(p, o, pc))
 				return; /* do not munge the queue */
 		}
 
@@ -206,7 +288,7 @@ static void pickaxe(struct diff_queue_struct *q, struct diff_options *o,
 		/* Showing only the filepairs that has the needle */
 		for (i = 0; i < q->nr; i++) {
 			struct diff_filepair *p = q->queue[i];
-			if (pickaxe_match(p, o, regexp, kws, fn))
+			if (pickaxe_match(p, o, pc))
 				diff_q(&outq, p);
 			else
 				diff_free_filepair(p);
@@ -228,28 +310,22 @@ static void regcomp_or_die(regex_t *regex, const char *needle, int cflags)
 	}
 }
 
-void diffcore_pickaxe(struct diff_options *o)
+static void compile_needle(struct diff_options *o, struct pickaxe_cache *pc)
 {
 	const char *needle = o->pickaxe;
 	int opts = o->pickaxe_opts;
-	regex_t regex, *regexp = NULL;
-	kwset_t kws = NULL;
-	pickaxe_fn fn;
 
-	if (opts & ~DIFF_PICKAXE_KIND_OBJFIND &&
-	    (!needle || !*needle))
-		BUG("should have needle under -G or -S");
 	if (opts & (DIFF_PICKAXE_REGEX | DIFF_PICKAXE_KIND_G)) {
 		int cflags = REG_EXTENDED | REG_NEWLINE;
 		if (o->pickaxe_opts & DIFF_PICKAXE_IGNORE_CASE)
 			cflags |= REG_ICASE;
-		regcomp_or_die(&regex, needle, cflags);
-		regexp = &regex;
+		regcomp_or_die(&pc->regex, needle, cflags);
+		pc->regexp = &pc->regex;
 
 		if (opts & DIFF_PICKAXE_KIND_G)
-			fn = diff_grep;
+			pc->fn = diff_grep;
 		else if (opts & DIFF_PICKAXE_REGEX)
-			fn = has_changes;
+			pc->fn = has_changes;
 		else
 			/*
 			 * We don't need to check the combination of
@@ -266,27 +342,68 @@ void diffcore_pickaxe(struct diff_options *o)
 			int cflags = REG_NEWLINE | REG_ICASE;
 
 			basic_regex_quote_buf(&sb, needle);
-			regcomp_or_die(&regex, sb.buf, cflags);
+			regcomp_or_die(&pc->regex, sb.buf, cflags);
 			strbuf_release(&sb);
-			regexp = &regex;
+			pc->regexp = &pc->regex;
 		} else {
-			kws = kwsalloc(o->pickaxe_opts & DIFF_PICKAXE_IGNORE_CASE
-				       ? tolower_trans_tbl : NULL);
-			kwsincr(kws, needle, strlen(needle));
-			kwsprep(kws);
+			pc->kws = kwsalloc(o->pickaxe_opts & DIFF_PICKAXE_IGNORE_CASE
+					   ? tolower_trans_tbl : NULL);
+			kwsincr(pc->kws, needle, strlen(needle));
+			kwsprep(pc->kws);
 		}
-		fn = has_changes;
-	} else if (opts & DIFF_PICKAXE_KIND_OBJFIND) {
-		fn = NULL;
+		pc->fn = has_changes;
 	} else {
 		BUG("unknown pickaxe_opts flag");
 	}
+}
+
+struct pickaxe_cache *pickaxe_cache_new(void)
+{
+	struct pickaxe_cache *pc;
+
+	CALLOC_ARRAY(pc, 1);
+	oidmap_init(&pc->counts, 0);
+	return pc;
+}
+
+void pickaxe_cache_free(struct pickaxe_cache *pc)
+{
+	if (!pc)
+		return;
+	if (pc->regexp)
+		regfree(pc->regexp);
+	if (pc->kws)
+		kwsfree(pc->kws);
+	oidmap_clear(&pc->counts, 1);
+	free(pc);
+}
+
+void diffcore_pickaxe(struct diff_options *o)
+{
+	const char *needle = o->pickaxe;
+	int opts = o->pickaxe_opts;
+	struct pickaxe_cache *pc = o->pickaxe_cache;
+
+	if (opts & ~DIFF_PICKAXE_KIND_OBJFIND &&
+	    (!needle || !*needle))
+		BUG("should have needle under -G or -S");
+
+	if (opts & DIFF_PICKAXE_KIND_OBJFIND) {
+		pickaxe(&diff_queued_diff, o, NULL);
+		return;
+	}
+
+	/*
+	 * The cache is set up by diff_setup_done(); make do with a
+	 * short-lived one for callers that do not use it.
+	 */
+	if (!pc)
+		pc = pickaxe_cache_new();
+	if (!pc->fn)
+		compile_needle(o, pc);
 
-	pickaxe(&diff_queued_diff, o, regexp, kws, fn);
+	pickaxe(&diff_queued_diff, o, pc);
 
-	if (regexp)
-		regfree(regexp);
-	if (kws)
-		kwsfree(kws);
-	return;
+	if (pc != o->pickaxe_cache)
+		pickaxe_cache_free(pc);
 }
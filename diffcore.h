@@ -205,6 +205,8 @@ void diffcore_rename_extended(struct diff_options *options,
 			      struct strmap *cached_pairs);
 void diffcore_merge_broken(void);
 void diffcore_pickaxe(struct diff_options *);
+struct pickaxe_cache *pickaxe_cache_new(void);
+void pickaxe_cache_free(struct pickaxe_cache *);
 void diffcore_order(const char *orderfile);
 void diffcore_rotate(struct diff_options *);
 
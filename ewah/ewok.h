@@ -95,6 +95,14 @@ uint32_t ewah_checksum(struct ewah_bitmap *self);
  */
 void ewah_each_bit(struct ewah_bitmap *self, ewah_callback callback, void *payload);
 
+/**
+ * Return whether the bit at position `pos` is set on the bitmap.
+ *
+ * Runs of clean words are skipped over using their length, so this
+ * costs one step per marker word before `pos` rather than one per word.
+ */
+int ewah_get(struct ewah_bitmap *self, size_t pos);
+
 /**
  * Set a given bit on the bitmap.
  *
@@ -3,17 +3,23 @@
 #include "negotiator/default.h"
 #include "negotiator/skipping.h"
 #include "negotiator/noop.h"
+#include "negotiator/summary.h"
 #include "repository.h"
 
 void fetch_negotiator_init(struct repository *r,
 			   struct fetch_negotiator *negotiator)
 {
 	prepare_repo_settings(r);
+	memset(negotiator, 0, sizeof(*negotiator));
 	switch(r->settings.fetch_negotiation_algorithm) {
 	case FETCH_NEGOTIATION_SKIPPING:
 		skipping_negotiator_init(negotiator);
 		return;
 
+	case FETCH_NEGOTIATION_SUMMARY:
+		summary_negotiator_init(negotiator);
+		return;
+
 	case FETCH_NEGOTIATION_NOOP:
 		noop_negotiator_init(negotiator);
 		return;
@@ -26,5 +32,6 @@ void fetch_negotiator_init(struct repository *r,
 
 void fetch_negotiator_init_noop(struct fetch_negotiator *negotiator)
 {
+	memset(negotiator, 0, sizeof(*negotiator));
 	noop_negotiator_init(negotiator);
 }
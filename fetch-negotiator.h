@@ -58,6 +58,14 @@ struct fetch_negotiator {
 
 	void (*release)(struct fetch_negotiator *);
 
+	/*
+	 * Set by negotiators whose "have" lines do not depend on what the
+	 * server acknowledges. All of them are then sent in the first
+	 * request, together with "done", so that negotiation takes a
+	 * single round trip.
+	 */
+	unsigned one_round : 1;
+
 	/* internal use */
 	void *data;
 };
@@ -1366,7 +1366,7 @@ static int add_haves(struct fetch_negotiator *negotiator,
 
 	while ((oid = negotiator->next(negotiator))) {
 		packet_buf_write(req_buf, "have %s\n", oid_to_hex(oid));
-		if (++haves_added >= *haves_to_send)
+		if (++haves_added >= *haves_to_send && !negotiator->one_round)
 			break;
 	}
 
@@ -1473,7 +1473,8 @@ static int send_fetch_request(struct fetch_negotiator *negotiator, int fd_out,
 	*in_vain += haves_added;
 	trace2_data_intmax("negotiation_v2", the_repository, "haves_added", haves_added);
 	trace2_data_intmax("negotiation_v2", the_repository, "in_vain", *in_vain);
-	if (!haves_added || (seen_ack && *in_vain >= MAX_IN_VAIN)) {
+	if (!haves_added || negotiator->one_round ||
+	    (seen_ack && *in_vain >= MAX_IN_VAIN)) {
 		/* Send Done */
 		packet_buf_write(&req_buf, "done\n");
 		done_sent = 1;
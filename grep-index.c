@@ -0,0 +1,818 @@
+#include "git-compat-util.h"
+#include "grep-index.h"
+#include "chunk-format.h"
+#include "commit.h"
+#include "csum-file.h"
+#include "ewah/ewok.h"
+#include "gettext.h"
+#include "grep.h"
+#include "hash-lookup.h"
+#include "hex.h"
+#include "lockfile.h"
+#include "object.h"
+#include "odb.h"
+#include "oid-array.h"
+#include "oidset.h"
+#include "path.h"
+#include "progress.h"
+#include "refs.h"
+#include "repo-settings.h"
+#include "repository.h"
+#include "trace2.h"
+#include "tree-walk.h"
+#include "varint.h"
+
+#define GREP_INDEX_SIGNATURE 0x47545249 /* "GTRI" */
+#define GREP_INDEX_VERSION 1
+#define GREP_INDEX_HEADER_SIZE 8
+#define GREP_INDEX_FANOUT_SIZE (4 * 256)
+#define GREP_INDEX_TRIGRAM_WIDTH 8
+
+#define GREP_INDEX_CHUNKID_OIDFANOUT 0x4f494446 /* "OIDF" */
+#define GREP_INDEX_CHUNKID_OIDLOOKUP 0x4f49444c /* "OIDL" */
+#define GREP_INDEX_CHUNKID_TRIGRAMS 0x5452474d /* "TRGM" */
+#define GREP_INDEX_CHUNKID_POSTINGS 0x504f5354 /* "POST" */
+
+struct grep_index_atom {
+	const struct grep_pat *pat;
+	struct bitmap *matches;
+};
+
+struct grep_index {
+	struct repository *repo;
+	const unsigned char *data;
+	size_t data_len;
+
+	const uint32_t *chunk_oid_fanout;
+	const unsigned char *chunk_oid_lookup;
+	const unsigned char *chunk_trigrams;
+	const unsigned char *chunk_postings;
+	size_t chunk_postings_size;
+	uint32_t num_blobs;
+	uint32_t num_trigrams;
+
+	struct grep_index_atom *atoms;
+	size_t atoms_nr, atoms_alloc;
+
+	uint32_t lookups;
+	uint32_t skipped;
+};
+
+struct grep_index_positions {
+	uint32_t *pos;
+	size_t nr, alloc;
+};
+
+static char *get_grep_index_filename(struct repository *r)
+{
+	return xstrfmt("%s/info/grep-index", repo_get_object_directory(r));
+}
+
+static int grep_index_read_oid_fanout(const unsigned char *chunk_start,
+				      size_t chunk_size, void *data)
+{
+	struct grep_index *gi = data;
+	int i;
+
+	if (chunk_size != GREP_INDEX_FANOUT_SIZE)
+		return error(_("grep-index OID fanout chunk is the wrong size"));
+	gi->chunk_oid_fanout = (const uint32_t *)chunk_start;
+	gi->num_blobs = ntohl(gi->chunk_oid_fanout[255]);
+
+	for (i = 0; i < 255; i++) {
+		if (ntohl(gi->chunk_oid_fanout[i]) >
+		    ntohl(gi->chunk_oid_fanout[i + 1]))
+			return error(_("grep-index fanout values out of order"));
+	}
+	return 0;
+}
+
+static int grep_index_read_oid_lookup(const unsigned char *chunk_start,
+				      size_t chunk_size, void *data)
+{
+	struct grep_index *gi = data;
+
+	if (chunk_size / gi->repo->hash_algo->rawsz != gi->num_blobs)
+		return error(_("grep-index OID lookup chunk is the wrong size"));
+	gi->chunk_oid_lookup = chunk_start;
+	return 0;
+}
+
+static int grep_index_read_postings(const unsigned char *chunk_start,
+				    size_t chunk_size, void *data)
+{
+	struct grep_index *gi = data;
+
+	gi->chunk_postings = chunk_start;
+	gi->chunk_postings_size = chunk_size;
+	return 0;
+}
+
+static int grep_index_read_trigrams(const unsigned char *chunk_start,
+				    size_t chunk_size, void *data)
+{
+	struct grep_index *gi = data;
+	uint32_t i, last_offset = 0;
+
+	if (chunk_size % GREP_INDEX_TRIGRAM_WIDTH)
+		return error(_("grep-index trigram chunk is the wrong size"));
+	gi->chunk_trigrams = chunk_start;
+	gi->num_trigrams = chunk_size / GREP_INDEX_TRIGRAM_WIDTH;
+
+	for (i = 0; i < gi->num_trigrams; i++) {
+		const unsigned char *entry = chunk_start + i * GREP_INDEX_TRIGRAM_WIDTH;
+		uint32_t offset = get_be32(entry + 4);
+
+		if ((i && get_be32(entry) <= get_be32(entry - GREP_INDEX_TRIGRAM_WIDTH)) ||
+		    offset < last_offset || offset > gi->chunk_postings_size)
+			return error(_("grep-index trigram chunk is corrupt"));
+		last_offset = offset;
+	}
+	return 0;
+}
+
+static struct grep_index *parse_grep_index(struct repository *r,
+					   const unsigned char *data,
+					   size_t data_len)
+{
+	struct grep_index *gi;
+	struct chunkfile *cf;
+	unsigned char num_chunks;
+
+	if (data_len < GREP_INDEX_HEADER_SIZE + r->hash_algo->rawsz) {
+		error(_("grep-index file is too small"));
+		return NULL;
+	}
+	if (get_be32(data) != GREP_INDEX_SIGNATURE) {
+		error(_("grep-index signature %X does not match signature %X"),
+		      get_be32(data), GREP_INDEX_SIGNATURE);
+		return NULL;
+	}
+	if (data[4] != GREP_INDEX_VERSION) {
+		error(_("grep-index version %X does not match version %X"),
+		      data[4], GREP_INDEX_VERSION);
+		return NULL;
+	}
+	if (data[5] != oid_version(r->hash_algo)) {
+		error(_("grep-index hash version %X does not match version %X"),
+		      data[5], oid_version(r->hash_algo));
+		return NULL;
+	}
+	num_chunks = data[6];
+	if (data_len < GREP_INDEX_HEADER_SIZE +
+		       (num_chunks + 1) * CHUNK_TOC_ENTRY_SIZE +
+		       r->hash_algo->rawsz) {
+		error(_("grep-index file is too small to hold %u chunks"),
+		      num_chunks);
+		return NULL;
+	}
+
+	CALLOC_ARRAY(gi, 1);
+	gi->repo = r;
+	gi->data = data;
+	gi->data_len = data_len;
+
+	cf = init_chunkfile(NULL);
+	if (read_table_of_contents(cf, data, data_len,
+				   GREP_INDEX_HEADER_SIZE, num_chunks, 1))
+		goto fail;
+
+	if (read_chunk(cf, GREP_INDEX_CHUNKID_OIDFANOUT,
+		       grep_index_read_oid_fanout, gi) ||
+	    read_chunk(cf, GREP_INDEX_CHUNKID_OIDLOOKUP,
+		       grep_index_read_oid_lookup, gi) ||
+	    read_chunk(cf, GREP_INDEX_CHUNKID_POSTINGS,
+		       grep_index_read_postings, gi) ||
+	    read_chunk(cf, GREP_INDEX_CHUNKID_TRIGRAMS,
+		       grep_index_read_trigrams, gi)) {
+		error(_("grep-index required chunk missing or corrupted"));
+		goto fail;
+	}
+
+	free_chunkfile(cf);
+	return gi;
+
+fail:
+	free_chunkfile(cf);
+	free(gi);
+	return NULL;
+}
+
+struct grep_index *grep_index_load(struct repository *r)
+{
+	char *filename = get_grep_index_filename(r);
+	struct grep_index *gi = NULL;
+	struct stat st;
+	size_t len;
+	void *map;
+	int fd;
+
+	fd = git_open(filename);
+	free(filename);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return NULL;
+	}
+
+	len = xsize_t(st.st_size);
+	if (!len) {
+		close(fd);
+		return NULL;
+	}
+	map = xmmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	gi = parse_grep_index(r, map, len);
+	if (!gi)
+		munmap(map, len);
+	return gi;
+}
+
+static void clear_atoms(struct grep_index *gi)
+{
+	for (size_t i = 0; i < gi->atoms_nr; i++)
+		bitmap_free(gi->atoms[i].matches);
+	FREE_AND_NULL(gi->atoms);
+	gi->atoms_nr = gi->atoms_alloc = 0;
+}
+
+void grep_index_free(struct grep_index *gi)
+{
+	if (!gi)
+		return;
+
+	if (gi->lookups) {
+		trace2_data_intmax("grep", gi->repo, "index/lookups", gi->lookups);
+		trace2_data_intmax("grep", gi->repo, "index/skipped", gi->skipped);
+	}
+
+	clear_atoms(gi);
+	munmap((void *)gi->data, gi->data_len);
+	free(gi);
+}
+
+static const unsigned char *trigram_entry(const struct grep_index *gi,
+					  uint32_t i)
+{
+	return gi->chunk_trigrams + st_mult(i, GREP_INDEX_TRIGRAM_WIDTH);
+}
+
+static int find_trigram(const struct grep_index *gi, uint32_t trigram,
+			uint32_t *result)
+{
+	uint32_t lo = 0, hi = gi->num_trigrams;
+
+	while (lo < hi) {
+		uint32_t mi = lo + (hi - lo) / 2;
+		uint32_t t = get_be32(trigram_entry(gi, mi));
+
+		if (t == trigram) {
+			*result = mi;
+			return 1;
+		}
+		if (t < trigram)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+	return 0;
+}
+
+static int decode_postings(const struct grep_index *gi, uint32_t i,
+			   struct grep_index_positions *out)
+{
+	const unsigned char *p, *end;
+	uint64_t pos = 0;
+
+	p = gi->chunk_postings + get_be32(trigram_entry(gi, i) + 4);
+	if (i + 1 < gi->num_trigrams)
+		end = gi->chunk_postings + get_be32(trigram_entry(gi, i + 1) + 4);
+	else
+		end = gi->chunk_postings + gi->chunk_postings_size;
+
+	out->nr = 0;
+	while (p < end) {
+		uint64_t delta = decode_varint(&p);
+
+		pos = out->nr ? pos + delta + 1 : delta;
+		if (p > end || pos >= gi->num_blobs)
+			return error(_("grep-index postings chunk is corrupt"));
+		ALLOC_GROW(out->pos, out->nr + 1, out->alloc);
+		out->pos[out->nr++] = pos;
+	}
+	return 0;
+}
+
+static int cmp_uint32(const void *va, const void *vb)
+{
+	uint32_t a = *(const uint32_t *)va, b = *(const uint32_t *)vb;
+	return a < b ? -1 : a != b;
+}
+
+/*
+ * Collect the distinct trigrams in "buf" that do not span a line
+ * boundary, as no line of a blob can match across one.
+ */
+static void collect_trigrams(const unsigned char *buf, size_t len,
+			     struct grep_index_positions *out)
+{
+	size_t i, j;
+
+	out->nr = 0;
+	for (i = 0; i + 2 < len; i++) {
+		if (buf[i] == '\n' || buf[i + 1] == '\n' || buf[i + 2] == '\n')
+			continue;
+		ALLOC_GROW(out->pos, out->nr + 1, out->alloc);
+		out->pos[out->nr++] = (uint32_t)buf[i] << 16 |
+				      (uint32_t)buf[i + 1] << 8 | buf[i + 2];
+	}
+
+	QSORT(out->pos, out->nr, cmp_uint32);
+	for (i = j = 0; i < out->nr; i++) {
+		if (!j || out->pos[j - 1] != out->pos[i])
+			out->pos[j++] = out->pos[i];
+	}
+	out->nr = j;
+}
+
+/*
+ * Compute the set of indexed blobs containing every trigram of the
+ * literal pattern "p". Returns NULL on error.
+ */
+static struct bitmap *compute_atom_matches(struct grep_index *gi,
+					   const struct grep_pat *p)
+{
+	struct grep_index_positions trigrams = { 0 };
+	struct grep_index_positions cur = { 0 }, next = { 0 };
+	struct bitmap *matches = bitmap_new();
+	int ret = 0;
+
+	collect_trigrams((const unsigned char *)p->pattern, p->patternlen,
+			 &trigrams);
+
+	for (size_t i = 0; i < trigrams.nr; i++) {
+		uint32_t t;
+		size_t a, b, n;
+
+		if (!find_trigram(gi, trigrams.pos[i], &t)) {
+			cur.nr = 0;
+			break;
+		}
+		if (!i) {
+			ret = decode_postings(gi, t, &cur);
+			if (ret)
+				goto out;
+			continue;
+		}
+
+		ret = decode_postings(gi, t, &next);
+		if (ret)
+			goto out;
+		for (a = b = n = 0; a < cur.nr && b < next.nr;) {
+			if (cur.pos[a] < next.pos[b])
+				a++;
+			else if (cur.pos[a] > next.pos[b])
+				b++;
+			else {
+				cur.pos[n++] = cur.pos[a];
+				a++;
+				b++;
+			}
+		}
+		cur.nr = n;
+		if (!cur.nr)
+			break;
+	}
+
+	for (size_t i = 0; i < cur.nr; i++)
+		bitmap_set(matches, cur.pos[i]);
+
+out:
+	free(trigrams.pos);
+	free(cur.pos);
+	free(next.pos);
+	if (ret) {
+		bitmap_free(matches);
+		return NULL;
+	}
+	return matches;
+}
+
+int grep_index_prepare(struct grep_index *gi, struct grep_opt *opt)
+{
+	struct grep_pat *p;
+
+	clear_atoms(gi);
+
+	/*
+	 * These report blobs without any matching line, which are exactly
+	 * the ones we would skip.
+	 */
+	if (opt->invert || opt->unmatch_name_only)
+		return 0;
+	/* We only know about the raw contents of blobs. */
+	if (opt->allow_textconv)
+		return 0;
+
+	for (p = opt->pattern_list; p; p = p->next) {
+		struct bitmap *matches;
+
+		if (p->token != GREP_PATTERN || !p->literal || p->patternlen < 3)
+			continue;
+
+		matches = compute_atom_matches(gi, p);
+		if (!matches) {
+			clear_atoms(gi);
+			return 0;
+		}
+		ALLOC_GROW(gi->atoms, gi->atoms_nr + 1, gi->atoms_alloc);
+		gi->atoms[gi->atoms_nr].pat = p;
+		gi->atoms[gi->atoms_nr].matches = matches;
+		gi->atoms_nr++;
+	}
+
+	return gi->atoms_nr > 0;
+}
+
+static int atom_may_match(struct grep_index *gi, const struct grep_pat *p,
+			  uint32_t pos)
+{
+	for (size_t i = 0; i < gi->atoms_nr; i++) {
+		if (gi->atoms[i].pat == p)
+			return bitmap_get(gi->atoms[i].matches, pos);
+	}
+	return 1;
+}
+
+static int expr_may_match(struct grep_index *gi, const struct grep_expr *x,
+			  uint32_t pos)
+{
+	switch (x->node) {
+	case GREP_NODE_ATOM:
+		return atom_may_match(gi, x->u.atom, pos);
+	case GREP_NODE_AND:
+		return expr_may_match(gi, x->u.binary.left, pos) &&
+		       expr_may_match(gi, x->u.binary.right, pos);
+	case GREP_NODE_OR:
+		return expr_may_match(gi, x->u.binary.left, pos) ||
+		       expr_may_match(gi, x->u.binary.right, pos);
+	case GREP_NODE_NOT:
+	case GREP_NODE_TRUE:
+	default:
+		return 1;
+	}
+}
+
+int grep_index_may_match(struct grep_index *gi, struct grep_opt *opt,
+			 const struct object_id *oid)
+{
+	struct grep_pat *p;
+	uint32_t pos;
+	int ret = 0;
+
+	if (!gi->atoms_nr || gi->repo != opt->repo)
+		return 1;
+
+	gi->lookups++;
+	if (!bsearch_hash(oid->hash, gi->chunk_oid_fanout, gi->chunk_oid_lookup,
+			  gi->repo->hash_algo->rawsz, &pos))
+		return 1;
+
+	if (opt->pattern_expression) {
+		ret = expr_may_match(gi, opt->pattern_expression, pos);
+	} else {
+		for (p = opt->pattern_list; p && !ret; p = p->next)
+			ret = atom_may_match(gi, p, pos);
+	}
+
+	if (!ret)
+		gi->skipped++;
+	return ret;
+}
+
+struct write_grep_index_context {
+	struct repository *r;
+	struct grep_index *old;
+	unsigned long big_file_threshold;
+
+	struct oidset seen;
+	struct oid_array blobs;
+
+	uint64_t *pairs;
+	size_t pairs_nr, pairs_alloc;
+
+	struct strbuf trigrams;
+	struct strbuf postings;
+};
+
+static void collect_blobs_from_tree(struct write_grep_index_context *ctx,
+				    const struct object_id *tree_oid)
+{
+	struct tree_desc desc;
+	struct name_entry entry;
+	enum object_type type;
+	unsigned long size;
+	void *data;
+
+	if (oidset_insert(&ctx->seen, tree_oid) ||
+	    !odb_has_object(ctx->r->objects, tree_oid, 0))
+		return;
+
+	data = odb_read_object(ctx->r->objects, tree_oid, &type, &size);
+	if (!data || type != OBJ_TREE) {
+		free(data);
+		return;
+	}
+
+	init_tree_desc(&desc, tree_oid, data, size);
+	while (tree_entry(&desc, &entry)) {
+		if (S_ISDIR(entry.mode))
+			collect_blobs_from_tree(ctx, &entry.oid);
+		else if (S_ISREG(entry.mode) &&
+			 !oidset_insert(&ctx->seen, &entry.oid))
+			oid_array_append(&ctx->blobs, &entry.oid);
+	}
+	free(data);
+}
+
+static int collect_blobs_from_ref(const struct reference *ref, void *cb_data)
+{
+	struct write_grep_index_context *ctx = cb_data;
+	struct commit *commit;
+
+	commit = lookup_commit_reference_gently(ctx->r, ref->oid, 1);
+	if (commit && !repo_parse_commit(ctx->r, commit))
+		collect_blobs_from_tree(ctx, get_commit_tree_oid(commit));
+	return 0;
+}
+
+static int grep_index_has_blob(struct grep_index *gi,
+			       const struct object_id *oid)
+{
+	return gi && bsearch_hash(oid->hash, gi->chunk_oid_fanout,
+				  gi->chunk_oid_lookup,
+				  gi->repo->hash_algo->rawsz, NULL);
+}
+
+/*
+ * Drop blobs that are neither in the old index nor small enough to be
+ * worth reading; grep will simply scan those.
+ */
+static void filter_blobs(struct write_grep_index_context *ctx)
+{
+	size_t i, j;
+
+	for (i = j = 0; i < ctx->blobs.nr; i++) {
+		const struct object_id *oid = &ctx->blobs.oid[i];
+		unsigned long size;
+
+		if (!grep_index_has_blob(ctx->old, oid)) {
+			if (!odb_has_object(ctx->r->objects, oid, 0) ||
+			    odb_read_object_info(ctx->r->objects, oid, &size) != OBJ_BLOB ||
+			    size > ctx->big_file_threshold)
+				continue;
+		}
+		oidcpy(&ctx->blobs.oid[j++], oid);
+	}
+	ctx->blobs.nr = j;
+	oid_array_sort(&ctx->blobs);
+}
+
+static void add_pair(struct write_grep_index_context *ctx,
+		     uint32_t trigram, uint32_t pos)
+{
+	ALLOC_GROW(ctx->pairs, ctx->pairs_nr + 1, ctx->pairs_alloc);
+	ctx->pairs[ctx->pairs_nr++] = (uint64_t)trigram << 32 | pos;
+}
+
+static int reuse_old_postings(struct write_grep_index_context *ctx)
+{
+	struct grep_index *old = ctx->old;
+	struct grep_index_positions positions = { 0 };
+	const unsigned hashsz = ctx->r->hash_algo->rawsz;
+	int32_t *new_pos;
+	int ret = 0;
+
+	ALLOC_ARRAY(new_pos, old->num_blobs);
+	for (uint32_t i = 0; i < old->num_blobs; i++) {
+		struct object_id oid;
+
+		oidread(&oid, old->chunk_oid_lookup + st_mult(i, hashsz),
+			ctx->r->hash_algo);
+		new_pos[i] = oid_array_lookup(&ctx->blobs, &oid);
+	}
+
+	for (uint32_t i = 0; i < old->num_trigrams; i++) {
+		uint32_t trigram = get_be32(trigram_entry(old, i));
+
+		ret = decode_postings(old, i, &positions);
+		if (ret)
+			break;
+		for (size_t j = 0; j < positions.nr; j++) {
+			if (new_pos[positions.pos[j]] >= 0)
+				add_pair(ctx, trigram, new_pos[positions.pos[j]]);
+		}
+	}
+
+	free(positions.pos);
+	free(new_pos);
+	return ret;
+}
+
+static int index_new_blobs(struct write_grep_index_context *ctx,
+			   enum grep_index_write_flags flags)
+{
+	struct grep_index_positions trigrams = { 0 };
+	struct progress *progress = NULL;
+	int ret = 0;
+
+	if (flags & GREP_INDEX_WRITE_PROGRESS)
+		progress = start_delayed_progress(ctx->r,
+						  _("Indexing blobs for grep"),
+						  ctx->blobs.nr);
+
+	for (size_t i = 0; i < ctx->blobs.nr; i++) {
+		const struct object_id *oid = &ctx->blobs.oid[i];
+		enum object_type type;
+		unsigned long size;
+		void *data;
+
+		display_progress(progress, i + 1);
+		if (grep_index_has_blob(ctx->old, oid))
+			continue;
+
+		data = odb_read_object(ctx->r->objects, oid, &type, &size);
+		if (!data) {
+			ret = error(_("unable to read %s"), oid_to_hex(oid));
+			break;
+		}
+		collect_trigrams(data, size, &trigrams);
+		for (size_t j = 0; j < trigrams.nr; j++)
+			add_pair(ctx, trigrams.pos[j], i);
+		free(data);
+	}
+
+	stop_progress(&progress);
+	free(trigrams.pos);
+	return ret;
+}
+
+static int cmp_uint64(const void *va, const void *vb)
+{
+	uint64_t a = *(const uint64_t *)va, b = *(const uint64_t *)vb;
+	return a < b ? -1 : a != b;
+}
+
+static int build_chunks(struct write_grep_index_context *ctx)
+{
+	uint32_t last_trigram = 0, last_pos = 0;
+
+	QSORT(ctx->pairs, ctx->pairs_nr, cmp_uint64);
+
+	for (size_t i = 0; i < ctx->pairs_nr; i++) {
+		uint32_t trigram = ctx->pairs[i] >> 32;
+		uint32_t pos = (uint32_t)ctx->pairs[i];
+		unsigned char entry[GREP_INDEX_TRIGRAM_WIDTH];
+		unsigned char varint[16];
+		uint64_t value = pos;
+
+		if (!i || trigram != last_trigram) {
+			if (ctx->postings.len > UINT32_MAX)
+				return error(_("grep-index postings exceed 4GB"));
+			put_be32(entry, trigram);
+			put_be32(entry + 4, ctx->postings.len);
+			strbuf_add(&ctx->trigrams, entry, sizeof(entry));
+			last_trigram = trigram;
+		} else {
+			value = pos - last_pos - 1;
+		}
+		strbuf_add(&ctx->postings, varint, encode_varint(value, varint));
+		last_pos = pos;
+	}
+	return 0;
+}
+
+static int write_grep_index_oid_fanout(struct hashfile *f, void *data)
+{
+	struct write_grep_index_context *ctx = data;
+	size_t count = 0;
+
+	for (int i = 0; i < 256; i++) {
+		while (count < ctx->blobs.nr &&
+		       ctx->blobs.oid[count].hash[0] == i)
+			count++;
+		hashwrite_be32(f, count);
+	}
+	return 0;
+}
+
+static int write_grep_index_oid_lookup(struct hashfile *f, void *data)
+{
+	struct write_grep_index_context *ctx = data;
+
+	for (size_t i = 0; i < ctx->blobs.nr; i++)
+		hashwrite(f, ctx->blobs.oid[i].hash, ctx->r->hash_algo->rawsz);
+	return 0;
+}
+
+static int write_grep_index_trigrams(struct hashfile *f, void *data)
+{
+	struct write_grep_index_context *ctx = data;
+
+	hashwrite(f, ctx->trigrams.buf, ctx->trigrams.len);
+	return 0;
+}
+
+static int write_grep_index_postings(struct hashfile *f, void *data)
+{
+	struct write_grep_index_context *ctx = data;
+
+	hashwrite(f, ctx->postings.buf, ctx->postings.len);
+	return 0;
+}
+
+int write_grep_index(struct repository *r, enum grep_index_write_flags flags)
+{
+	struct write_grep_index_context ctx = {
+		.r = r,
+		.seen = OIDSET_INIT,
+		.blobs = OID_ARRAY_INIT,
+		.trigrams = STRBUF_INIT,
+		.postings = STRBUF_INIT,
+	};
+	struct lock_file lk = LOCK_INIT;
+	char *filename = get_grep_index_filename(r);
+	struct chunkfile *cf;
+	struct hashfile *f;
+	int ret;
+
+	ctx.old = grep_index_load(r);
+	ctx.big_file_threshold = repo_settings_get_big_file_threshold(r);
+
+	trace2_region_enter("grep-index", "collect", r);
+	refs_head_ref(get_main_ref_store(r), collect_blobs_from_ref, &ctx);
+	refs_for_each_ref(get_main_ref_store(r), collect_blobs_from_ref, &ctx);
+	filter_blobs(&ctx);
+	trace2_region_leave("grep-index", "collect", r);
+
+	trace2_region_enter("grep-index", "index", r);
+	ret = ctx.old ? reuse_old_postings(&ctx) : 0;
+	if (!ret)
+		ret = index_new_blobs(&ctx, flags);
+	if (!ret)
+		ret = build_chunks(&ctx);
+	trace2_region_leave("grep-index", "index", r);
+	if (ret)
+		goto out;
+
+	trace2_data_intmax("grep-index", r, "blobs", ctx.blobs.nr);
+	trace2_data_intmax("grep-index", r, "trigrams",
+			   ctx.trigrams.len / GREP_INDEX_TRIGRAM_WIDTH);
+
+	if (safe_create_leading_directories(r, filename)) {
+		ret = error(_("unable to create leading directories of %s"),
+			    filename);
+		goto out;
+	}
+	hold_lock_file_for_update_mode(&lk, filename, LOCK_DIE_ON_ERROR, 0444);
+	f = hashfd(r->hash_algo, get_lock_file_fd(&lk), get_lock_file_path(&lk));
+
+	cf = init_chunkfile(f);
+	add_chunk(cf, GREP_INDEX_CHUNKID_OIDFANOUT, GREP_INDEX_FANOUT_SIZE,
+		  write_grep_index_oid_fanout);
+	add_chunk(cf, GREP_INDEX_CHUNKID_OIDLOOKUP,
+		  st_mult(r->hash_algo->rawsz, ctx.blobs.nr),
+		  write_grep_index_oid_lookup);
+	add_chunk(cf, GREP_INDEX_CHUNKID_TRIGRAMS, ctx.trigrams.len,
+		  write_grep_index_trigrams);
+	add_chunk(cf, GREP_INDEX_CHUNKID_POSTINGS, ctx.postings.len,
+		  write_grep_index_postings);
+
+	hashwrite_be32(f, GREP_INDEX_SIGNATURE);
+	hashwrite_u8(f, GREP_INDEX_VERSION);
+	hashwrite_u8(f, oid_version(r->hash_algo));
+	hashwrite_u8(f, get_num_chunks(cf));
+	hashwrite_u8(f, 0); /* unused */
+
+	write_chunkfile(cf, &ctx);
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_PACK_METADATA,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC);
+	free_chunkfile(cf);
+
+	grep_index_free(ctx.old);
+	ctx.old = NULL;
+	if (commit_lock_file(&lk) < 0)
+		ret = error_errno(_("unable to write '%s'"), filename);
+
+out:
+	grep_index_free(ctx.old);
+	oidset_clear(&ctx.seen);
+	oid_array_clear(&ctx.blobs);
+	free(ctx.pairs);
+	strbuf_release(&ctx.trigrams);
+	strbuf_release(&ctx.postings);
+	free(filename);
+	return ret;
+}
@@ -0,0 +1,87 @@
+#ifndef GREP_INDEX_H
+#define GREP_INDEX_H
+
+struct grep_opt;
+struct object_id;
+struct repository;
+
+/*
+ * The grep index maps trigrams (sequences of three bytes that do not
+ * contain a newline) to the blobs containing them. It covers the blobs
+ * reachable from the trees at the tips of all references, and lives in
+ * "$GIT_DIR/objects/info/grep-index".
+ *
+ * The file uses the chunk format (see chunk-format.h):
+ *
+ *   HEADER:
+ *     4-byte signature "GTRI"
+ *     1-byte version number (currently 1)
+ *     1-byte object id version (see oid_version())
+ *     1-byte number of chunks
+ *     1-byte reserved (0)
+ *
+ *   CHUNK LOOKUP:
+ *     (C + 1) * 12 bytes listing the table of contents.
+ *
+ *   OID Fanout (ID: {'O', 'I', 'D', 'F'}) (256 * 4 bytes)
+ *     The ith entry, F[i], stores the number of indexed blobs whose
+ *     first byte is at most i.
+ *
+ *   OID Lookup (ID: {'O', 'I', 'D', 'L'}) (N * H bytes)
+ *     The object ids of the indexed blobs, in lexicographic order.
+ *
+ *   Trigrams (ID: {'T', 'R', 'G', 'M'}) (M * 8 bytes)
+ *     Each entry is a 4-byte trigram (the three bytes in network order,
+ *     most significant byte zero), followed by the 4-byte offset into
+ *     the postings chunk of the list of blobs containing it. Entries
+ *     are sorted by trigram. A list ends where the next one starts, or
+ *     at the end of the postings chunk.
+ *
+ *   Postings (ID: {'P', 'O', 'S', 'T'})
+ *     Lists of positions in the OID lookup chunk in increasing order.
+ *     The first position of each list is stored as is, every following
+ *     one as the difference to its predecessor minus one, all encoded
+ *     with encode_varint().
+ *
+ *   TRAILER:
+ *     Checksum of the contents.
+ */
+
+struct grep_index;
+
+/*
+ * Open the grep index of the repository. Returns NULL if there is none,
+ * or if it cannot be used.
+ */
+struct grep_index *grep_index_load(struct repository *r);
+
+void grep_index_free(struct grep_index *gi);
+
+/*
+ * Precompute which indexed blobs may contain the patterns in `opt`.
+ * Returns 0 when the index is of no use for these patterns, e.g.
+ * because none of them is a literal of at least three bytes, or
+ * because `opt` asks for blobs that do not match (-v, -L).
+ */
+int grep_index_prepare(struct grep_index *gi, struct grep_opt *opt);
+
+/*
+ * Return 0 if the blob `oid` is known to have no match for the
+ * patterns `opt` was prepared with, 1 otherwise. Blobs that are not in
+ * the index always may match.
+ */
+int grep_index_may_match(struct grep_index *gi, struct grep_opt *opt,
+			 const struct object_id *oid);
+
+enum grep_index_write_flags {
+	GREP_INDEX_WRITE_PROGRESS = (1 << 0),
+};
+
+/*
+ * Write the grep index for the blobs reachable from the tips of all
+ * references. Trigrams of blobs that are already in the existing index
+ * are taken from there, so only new blobs need to be read.
+ */
+int write_grep_index(struct repository *r, enum grep_index_write_flags flags);
+
+#endif /* GREP_INDEX_H */
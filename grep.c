@@ -244,6 +244,53 @@ static int is_fixed(const char *s, size_t len)
 	return 1;
 }
 
+/*
+ * Approximate rank of each byte value by how often it shows up in
+ * source code and prose, from 0 (rarest) to 255 (most common). Used
+ * to pick the bytes of a literal pattern that make good anchors for
+ * memchr().
+ */
+static const unsigned char byte_frequency_rank[256] = {
+	  0,   1,   2,   3,   4,   5,   6,   7,   8, 246, 247,   9, 136,  10,  11,  12,
+	 13,  14,  15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25,  26,  27,  28,
+	255, 180, 229, 197, 202, 177, 233, 217, 230, 231, 225, 184, 228, 239, 226, 219,
+	213, 211, 200, 178, 179, 174, 175, 165, 171, 164, 204, 227, 195, 220, 216, 162,
+	163, 212, 186, 203, 201, 218, 196, 187, 192, 209, 160, 170, 205, 189, 207, 210,
+	193, 159, 208, 206, 214, 194, 166, 173, 168, 172, 161, 185, 188, 183, 169, 243,
+	190, 249, 232, 244, 241, 254, 237, 234, 236, 252, 191, 215, 242, 235, 245, 248,
+	238, 176, 250, 251, 253, 240, 222, 224, 223, 221, 181, 199, 182, 198, 167,  29,
+	146, 140, 103,  76, 141, 142, 152,  93, 128,  83,  88,  66, 105, 104,  97,  84,
+	 94, 116,  67, 143, 106, 107, 110,  89,  90, 108, 134, 111,  91, 120, 124,  68,
+	137, 153, 117, 112, 109, 150, 151,  98,  69, 127,  85, 125, 121, 126,  77, 118,
+	145, 148,  78, 122,  99, 100, 155,  30, 132, 138, 129, 101, 131, 156,  86, 130,
+	 31,  32,  87, 158,  81, 133,  70, 113,  33,  34,  35,  36,  37,  38, 157, 147,
+	135, 119,  39,  71,  40,  41,  72,  42,  43,  44,  45,  46,  47,  48,  49,  50,
+	 51, 149, 154, 123, 144, 139, 115, 114, 102,  92,  52,  73,  82,  74,  75,  79,
+	 95,  53,  54,  80,  55,  56,  57,  58,  96,  59,  60,  61,  62,  63,  64,  65,
+};
+
+static void compile_literal(struct grep_pat *p)
+{
+	const unsigned char *s = (const unsigned char *)p->pattern;
+	size_t i, rare1 = 0, rare2 = 0;
+
+	for (i = 1; i < p->patternlen; i++) {
+		if (byte_frequency_rank[s[i]] < byte_frequency_rank[s[rare1]])
+			rare1 = i;
+	}
+	for (i = 0; i < p->patternlen; i++) {
+		if (i == rare1)
+			continue;
+		if (rare2 == rare1 ||
+		    byte_frequency_rank[s[i]] < byte_frequency_rank[s[rare2]])
+			rare2 = i;
+	}
+
+	p->literal_rare1 = rare1;
+	p->literal_rare2 = rare2;
+	p->literal = 1;
+}
+
 #ifdef USE_LIBPCRE2
 #define GREP_PCRE2_DEBUG_MALLOC 0
 
@@ -508,6 +555,8 @@ static void compile_regexp(struct grep_pat *p, struct grep_opt *opt)
 		die(_("given pattern contains NULL byte (via -f <file>). This is only supported with -P under PCRE v2"));
 
 	p->is_fixed = is_fixed(p->pattern, p->patternlen);
+	if ((p->fixed || p->is_fixed) && !p->ignore_case && p->patternlen)
+		compile_literal(p);
 #ifdef USE_LIBPCRE2
        if (!p->fixed && !p->is_fixed) {
 	       const char *no_jit = "(*NO_JIT)";
@@ -905,10 +954,50 @@ static void show_name(struct grep_opt *opt, const char *name)
 	opt->output(opt, opt->null_following_name ? "\0" : "\n", 1);
 }
 
+/*
+ * Look for a case-sensitive literal pattern by letting memchr() scan
+ * for its rarest byte, and only comparing the whole pattern at
+ * positions where the second rarest byte lines up as well.
+ */
+static int literal_match(struct grep_pat *p,
+			 const char *line, const char *eol,
+			 regmatch_t *match)
+{
+	size_t len = p->patternlen;
+	unsigned char rare1 = p->pattern[p->literal_rare1];
+	unsigned char rare2 = p->pattern[p->literal_rare2];
+	const char *sp, *end;
+
+	if (eol - line < (ptrdiff_t)len)
+		return 0;
+
+	sp = line + p->literal_rare1;
+	end = eol - len + p->literal_rare1 + 1;
+	while (sp < end) {
+		const char *start;
+
+		sp = memchr(sp, rare1, end - sp);
+		if (!sp)
+			return 0;
+		start = sp - p->literal_rare1;
+		if ((unsigned char)start[p->literal_rare2] == rare2 &&
+		    !memcmp(start, p->pattern, len)) {
+			match->rm_so = start - line;
+			match->rm_eo = match->rm_so + len;
+			return 1;
+		}
+		sp++;
+	}
+	return 0;
+}
+
 static int patmatch(struct grep_pat *p,
 		    const char *line, const char *eol,
 		    regmatch_t *match, int eflags)
 {
+	if (p->literal)
+		return literal_match(p, line, eol, match);
+
 	if (p->pcre2_pattern)
 		return !pcre2match(p, line, eol, match, eflags);
 
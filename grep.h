@@ -82,8 +82,11 @@ struct grep_pat {
 	pcre2_general_context *pcre2_general_context;
 	const uint8_t *pcre2_tables;
 	uint32_t pcre2_jit_on;
+	size_t literal_rare1;
+	size_t literal_rare2;
 	unsigned fixed:1;
 	unsigned is_fixed:1;
+	unsigned literal:1;
 	unsigned ignore_case:1;
 	unsigned word_regexp:1;
 };
@@ -0,0 +1,383 @@
+#include "git-compat-util.h"
+#include "last-modified-index.h"
+#include "chunk-format.h"
+#include "csum-file.h"
+#include "gettext.h"
+#include "lockfile.h"
+#include "object.h"
+#include "odb.h"
+#include "oid-array.h"
+#include "path.h"
+#include "repository.h"
+#include "string-list.h"
+#include "trace2.h"
+
+#define LAST_MODIFIED_INDEX_SIGNATURE 0x4c4d4f44 /* "LMOD" */
+#define LAST_MODIFIED_INDEX_VERSION 1
+#define LAST_MODIFIED_INDEX_HEADER_SIZE 8
+#define LAST_MODIFIED_INDEX_ENTRY_WIDTH 8
+
+#define LAST_MODIFIED_INDEX_CHUNKID_TIP 0x54495043 /* "TIPC" */
+#define LAST_MODIFIED_INDEX_CHUNKID_COMMITS 0x434d544c /* "CMTL" */
+#define LAST_MODIFIED_INDEX_CHUNKID_ENTRIES 0x50415445 /* "PATE" */
+#define LAST_MODIFIED_INDEX_CHUNKID_NAMES 0x5041544e /* "PATN" */
+
+struct last_modified_index {
+	struct repository *repo;
+	const unsigned char *data;
+	size_t data_len;
+
+	struct object_id tip;
+	const unsigned char *chunk_commits;
+	const unsigned char *chunk_entries;
+	const char *chunk_names;
+	size_t chunk_names_size;
+	uint32_t num_commits;
+	uint32_t num_paths;
+
+	uint32_t lookups;
+	uint32_t found;
+};
+
+static char *get_last_modified_index_filename(struct repository *r)
+{
+	return xstrfmt("%s/info/last-modified", repo_get_object_directory(r));
+}
+
+static int last_modified_index_read_tip(const unsigned char *chunk_start,
+					size_t chunk_size, void *data)
+{
+	struct last_modified_index *lmi = data;
+
+	if (chunk_size != lmi->repo->hash_algo->rawsz)
+		return error(_("last-modified index tip chunk is the wrong size"));
+	oidread(&lmi->tip, chunk_start, lmi->repo->hash_algo);
+	return 0;
+}
+
+static int last_modified_index_read_commits(const unsigned char *chunk_start,
+					    size_t chunk_size, void *data)
+{
+	struct last_modified_index *lmi = data;
+
+	if (chunk_size % lmi->repo->hash_algo->rawsz)
+		return error(_("last-modified index commit chunk is the wrong size"));
+	lmi->chunk_commits = chunk_start;
+	lmi->num_commits = chunk_size / lmi->repo->hash_algo->rawsz;
+	return 0;
+}
+
+static int last_modified_index_read_names(const unsigned char *chunk_start,
+					  size_t chunk_size, void *data)
+{
+	struct last_modified_index *lmi = data;
+
+	if (chunk_size && chunk_start[chunk_size - 1])
+		return error(_("last-modified index path names are not terminated"));
+	lmi->chunk_names = (const char *)chunk_start;
+	lmi->chunk_names_size = chunk_size;
+	return 0;
+}
+
+static int last_modified_index_read_entries(const unsigned char *chunk_start,
+					    size_t chunk_size, void *data)
+{
+	struct last_modified_index *lmi = data;
+
+	if (chunk_size % LAST_MODIFIED_INDEX_ENTRY_WIDTH)
+		return error(_("last-modified index path chunk is the wrong size"));
+	lmi->chunk_entries = chunk_start;
+	lmi->num_paths = chunk_size / LAST_MODIFIED_INDEX_ENTRY_WIDTH;
+
+	for (uint32_t i = 0; i < lmi->num_paths; i++) {
+		const unsigned char *entry =
+			chunk_start + i * LAST_MODIFIED_INDEX_ENTRY_WIDTH;
+
+		if (get_be32(entry) >= lmi->chunk_names_size ||
+		    get_be32(entry + 4) >= lmi->num_commits)
+			return error(_("last-modified index path chunk is corrupt"));
+	}
+	return 0;
+}
+
+static struct last_modified_index *parse_last_modified_index(struct repository *r,
+							     const unsigned char *data,
+							     size_t data_len)
+{
+	struct last_modified_index *lmi;
+	struct chunkfile *cf;
+	unsigned char num_chunks;
+
+	if (data_len < LAST_MODIFIED_INDEX_HEADER_SIZE + r->hash_algo->rawsz) {
+		error(_("last-modified index file is too small"));
+		return NULL;
+	}
+	if (get_be32(data) != LAST_MODIFIED_INDEX_SIGNATURE) {
+		error(_("last-modified index signature %X does not match signature %X"),
+		      get_be32(data), LAST_MODIFIED_INDEX_SIGNATURE);
+		return NULL;
+	}
+	if (data[4] != LAST_MODIFIED_INDEX_VERSION) {
+		error(_("last-modified index version %X does not match version %X"),
+		      data[4], LAST_MODIFIED_INDEX_VERSION);
+		return NULL;
+	}
+	if (data[5] != oid_version(r->hash_algo)) {
+		error(_("last-modified index hash version %X does not match version %X"),
+		      data[5], oid_version(r->hash_algo));
+		return NULL;
+	}
+	num_chunks = data[6];
+	if (data_len < LAST_MODIFIED_INDEX_HEADER_SIZE +
+		       (num_chunks + 1) * CHUNK_TOC_ENTRY_SIZE +
+		       r->hash_algo->rawsz) {
+		error(_("last-modified index file is too small to hold %u chunks"),
+		      num_chunks);
+		return NULL;
+	}
+
+	CALLOC_ARRAY(lmi, 1);
+	lmi->repo = r;
+	lmi->data = data;
+	lmi->data_len = data_len;
+
+	cf = init_chunkfile(NULL);
+	if (read_table_of_contents(cf, data, data_len,
+				   LAST_MODIFIED_INDEX_HEADER_SIZE, num_chunks, 1))
+		goto fail;
+
+	if (read_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_TIP,
+		       last_modified_index_read_tip, lmi) ||
+	    read_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_COMMITS,
+		       last_modified_index_read_commits, lmi) ||
+	    read_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_NAMES,
+		       last_modified_index_read_names, lmi) ||
+	    read_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_ENTRIES,
+		       last_modified_index_read_entries, lmi)) {
+		error(_("last-modified index required chunk missing or corrupted"));
+		goto fail;
+	}
+
+	free_chunkfile(cf);
+	return lmi;
+
+fail:
+	free_chunkfile(cf);
+	free(lmi);
+	return NULL;
+}
+
+struct last_modified_index *last_modified_index_load(struct repository *r)
+{
+	char *filename = get_last_modified_index_filename(r);
+	struct last_modified_index *lmi = NULL;
+	struct stat st;
+	size_t len;
+	void *map;
+	int fd;
+
+	fd = git_open(filename);
+	free(filename);
+	if (fd < 0)
+		return NULL;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return NULL;
+	}
+
+	len = xsize_t(st.st_size);
+	if (!len) {
+		close(fd);
+		return NULL;
+	}
+	map = xmmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	lmi = parse_last_modified_index(r, map, len);
+	if (!lmi)
+		munmap(map, len);
+	return lmi;
+}
+
+void last_modified_index_free(struct last_modified_index *lmi)
+{
+	if (!lmi)
+		return;
+
+	if (lmi->lookups) {
+		trace2_data_intmax("last-modified", lmi->repo, "index/lookups",
+				   lmi->lookups);
+		trace2_data_intmax("last-modified", lmi->repo, "index/found",
+				   lmi->found);
+	}
+
+	munmap((void *)lmi->data, lmi->data_len);
+	free(lmi);
+}
+
+const struct object_id *last_modified_index_tip(struct last_modified_index *lmi)
+{
+	return &lmi->tip;
+}
+
+static const unsigned char *path_entry(const struct last_modified_index *lmi,
+				       uint32_t i)
+{
+	return lmi->chunk_entries + st_mult(i, LAST_MODIFIED_INDEX_ENTRY_WIDTH);
+}
+
+int last_modified_index_lookup(struct last_modified_index *lmi,
+			       const char *path, struct object_id *commit)
+{
+	uint32_t lo = 0, hi = lmi->num_paths;
+
+	lmi->lookups++;
+	while (lo < hi) {
+		uint32_t mi = lo + (hi - lo) / 2;
+		const unsigned char *entry = path_entry(lmi, mi);
+		int cmp = strcmp(lmi->chunk_names + get_be32(entry), path);
+
+		if (!cmp) {
+			oidread(commit, lmi->chunk_commits +
+				st_mult(get_be32(entry + 4),
+					lmi->repo->hash_algo->rawsz),
+				lmi->repo->hash_algo);
+			lmi->found++;
+			return 1;
+		}
+		if (cmp < 0)
+			lo = mi + 1;
+		else
+			hi = mi;
+	}
+	return 0;
+}
+
+struct write_last_modified_index_context {
+	struct repository *r;
+	const struct object_id *tip;
+	const struct string_list *paths;
+	struct oid_array commits;
+};
+
+static int write_last_modified_index_tip(struct hashfile *f, void *data)
+{
+	struct write_last_modified_index_context *ctx = data;
+
+	hashwrite(f, ctx->tip->hash, ctx->r->hash_algo->rawsz);
+	return 0;
+}
+
+static int write_last_modified_index_commits(struct hashfile *f, void *data)
+{
+	struct write_last_modified_index_context *ctx = data;
+
+	for (size_t i = 0; i < ctx->commits.nr; i++)
+		hashwrite(f, ctx->commits.oid[i].hash, ctx->r->hash_algo->rawsz);
+	return 0;
+}
+
+static int write_last_modified_index_entries(struct hashfile *f, void *data)
+{
+	struct write_last_modified_index_context *ctx = data;
+	uint32_t offset = 0;
+
+	for (size_t i = 0; i < ctx->paths->nr; i++) {
+		const struct string_list_item *item = &ctx->paths->items[i];
+
+		hashwrite_be32(f, offset);
+		hashwrite_be32(f, oid_array_lookup(&ctx->commits, item->util));
+		offset += strlen(item->string) + 1;
+	}
+	return 0;
+}
+
+static int write_last_modified_index_names(struct hashfile *f, void *data)
+{
+	struct write_last_modified_index_context *ctx = data;
+
+	for (size_t i = 0; i < ctx->paths->nr; i++) {
+		const char *path = ctx->paths->items[i].string;
+
+		hashwrite(f, path, strlen(path) + 1);
+	}
+	return 0;
+}
+
+static int add_commit(const struct object_id *oid, void *data)
+{
+	oid_array_append(data, oid);
+	return 0;
+}
+
+int write_last_modified_index(struct repository *r,
+			      const struct object_id *tip,
+			      const struct string_list *paths)
+{
+	struct write_last_modified_index_context ctx = {
+		.r = r,
+		.tip = tip,
+		.paths = paths,
+		.commits = OID_ARRAY_INIT,
+	};
+	struct oid_array all_commits = OID_ARRAY_INIT;
+	struct lock_file lk = LOCK_INIT;
+	char *filename = get_last_modified_index_filename(r);
+	struct chunkfile *cf;
+	struct hashfile *f;
+	size_t names_len = 0;
+	int ret = 0;
+
+	for (size_t i = 0; i < paths->nr; i++) {
+		names_len += strlen(paths->items[i].string) + 1;
+		oid_array_append(&all_commits, paths->items[i].util);
+	}
+	if (names_len > UINT32_MAX) {
+		ret = error(_("last-modified index path names exceed 4GB"));
+		goto out;
+	}
+	oid_array_for_each_unique(&all_commits, add_commit, &ctx.commits);
+
+	trace2_data_intmax("last-modified", r, "index/paths", paths->nr);
+	trace2_data_intmax("last-modified", r, "index/commits", ctx.commits.nr);
+
+	if (safe_create_leading_directories(r, filename)) {
+		ret = error(_("unable to create leading directories of %s"),
+			    filename);
+		goto out;
+	}
+	hold_lock_file_for_update_mode(&lk, filename, LOCK_DIE_ON_ERROR, 0444);
+	f = hashfd(r->hash_algo, get_lock_file_fd(&lk), get_lock_file_path(&lk));
+
+	cf = init_chunkfile(f);
+	add_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_TIP, r->hash_algo->rawsz,
+		  write_last_modified_index_tip);
+	add_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_COMMITS,
+		  st_mult(r->hash_algo->rawsz, ctx.commits.nr),
+		  write_last_modified_index_commits);
+	add_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_ENTRIES,
+		  st_mult(LAST_MODIFIED_INDEX_ENTRY_WIDTH, paths->nr),
+		  write_last_modified_index_entries);
+	add_chunk(cf, LAST_MODIFIED_INDEX_CHUNKID_NAMES, names_len,
+		  write_last_modified_index_names);
+
+	hashwrite_be32(f, LAST_MODIFIED_INDEX_SIGNATURE);
+	hashwrite_u8(f, LAST_MODIFIED_INDEX_VERSION);
+	hashwrite_u8(f, oid_version(r->hash_algo));
+	hashwrite_u8(f, get_num_chunks(cf));
+	hashwrite_u8(f, 0); /* unused */
+
+	write_chunkfile(cf, &ctx);
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_PACK_METADATA,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC);
+	free_chunkfile(cf);
+
+	if (commit_lock_file(&lk) < 0)
+		ret = error_errno(_("unable to write '%s'"), filename);
+
+out:
+	oid_array_clear(&all_commits);
+	oid_array_clear(&ctx.commits);
+	free(filename);
+	return ret;
+}
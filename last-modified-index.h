@@ -0,0 +1,74 @@
+#ifndef LAST_MODIFIED_INDEX_H
+#define LAST_MODIFIED_INDEX_H
+
+struct object_id;
+struct repository;
+struct string_list;
+
+/*
+ * The last-modified index records, for every path in the tree of a single
+ * commit (the "tip"), the commit that last modified it, as computed by
+ * git-last-modified(1). Trees are included, at every depth. It lives in
+ * "$GIT_DIR/objects/info/last-modified".
+ *
+ * The file uses the chunk format (see chunk-format.h):
+ *
+ *   HEADER:
+ *     4-byte signature "LMOD"
+ *     1-byte version number (currently 1)
+ *     1-byte object id version (see oid_version())
+ *     1-byte number of chunks
+ *     1-byte reserved (0)
+ *
+ *   CHUNK LOOKUP:
+ *     (C + 1) * 12 bytes listing the table of contents.
+ *
+ *   Tip (ID: {'T', 'I', 'P', 'C'}) (H bytes)
+ *     The object id of the commit the index was computed for.
+ *
+ *   Commit Lookup (ID: {'C', 'M', 'T', 'L'}) (N * H bytes)
+ *     The object ids of the commits paths were last modified by, in
+ *     lexicographic order.
+ *
+ *   Path Entries (ID: {'P', 'A', 'T', 'E'}) (P * 8 bytes)
+ *     For each path, in strcmp() order, the 4-byte offset of its name in
+ *     the path names chunk, followed by the 4-byte position of the
+ *     commit that last modified it in the commit lookup chunk.
+ *
+ *   Path Names (ID: {'P', 'A', 'T', 'N'})
+ *     NUL-terminated path names.
+ *
+ *   TRAILER:
+ *     Checksum of the contents.
+ */
+
+struct last_modified_index;
+
+/*
+ * Open the last-modified index of the repository. Returns NULL if there is
+ * none, or if it cannot be used.
+ */
+struct last_modified_index *last_modified_index_load(struct repository *r);
+
+void last_modified_index_free(struct last_modified_index *lmi);
+
+/* Return the commit the index was computed for. */
+const struct object_id *last_modified_index_tip(struct last_modified_index *lmi);
+
+/*
+ * Look up the commit that last modified `path` as of the tip of the index.
+ * Returns 1 and fills in `commit` if the path is in the index, 0 otherwise.
+ */
+int last_modified_index_lookup(struct last_modified_index *lmi,
+			       const char *path, struct object_id *commit);
+
+/*
+ * Write the last-modified index for `tip`. `paths` must be sorted, and the
+ * `util` field of each item must point to the object id of the commit that
+ * last modified it.
+ */
+int write_last_modified_index(struct repository *r,
+			      const struct object_id *tip,
+			      const struct string_list *paths);
+
+#endif /* LAST_MODIFIED_INDEX_H */
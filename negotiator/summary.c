@@ -0,0 +1,164 @@
+#define USE_THE_REPOSITORY_VARIABLE
+
+#include "git-compat-util.h"
+#include "summary.h"
+#include "../commit.h"
+#include "../fetch-negotiator.h"
+#include "../hex.h"
+#include "../repository.h"
+
+/*
+ * This negotiator summarizes the history of each tip in a single batch
+ * of "have" lines, instead of walking it in rounds guided by the
+ * server's acknowledgements: it sends the tip, and then the commits on
+ * its first-parent chain at distances 1, 2, 4, 8, ... from it, down to
+ * the root or to history that is already covered by another tip.
+ *
+ * The server learns about the common history in one go, at the price of
+ * sending at most about as many commits as the client has on top of it
+ * again. That is a good trade for clients that fetch a lot of new
+ * history after having been offline for a while, especially from
+ * servers that can compute the resulting pack from reachability
+ * bitmaps.
+ */
+
+/* Remember to update object flag allocation in object.h */
+/*
+ * Both us and the server know that both parties have this object.
+ */
+#define COMMON		(1U << 2)
+/*
+ * This commit is a tip, or has been looked at while summarizing one.
+ */
+#define SEEN		(1U << 4)
+
+struct data {
+	struct commit_stack tips;
+	struct commit_stack to_send;
+	size_t sent;
+	int prepared;
+};
+
+static void summarize_tip(struct data *data, struct commit *tip)
+{
+	struct commit *c = tip;
+	size_t distance = 0, next_sample = 1;
+
+	commit_stack_push(&data->to_send, tip);
+	while (!repo_parse_commit(the_repository, c) && c->parents) {
+		struct commit *parent = c->parents->item;
+
+		/* the rest is summarized by another tip */
+		if (parent->object.flags & SEEN)
+			return;
+		parent->object.flags |= SEEN;
+
+		if (++distance == next_sample) {
+			commit_stack_push(&data->to_send, parent);
+			next_sample *= 2;
+		}
+		c = parent;
+	}
+
+	/* the root, which the server is likely to have */
+	if (c != data->to_send.items[data->to_send.nr - 1])
+		commit_stack_push(&data->to_send, c);
+}
+
+static int compare_tips(const void *a_, const void *b_)
+{
+	struct commit *a = *(struct commit **)a_;
+	struct commit *b = *(struct commit **)b_;
+	return compare_commits_by_commit_date(a, b, NULL);
+}
+
+static void prepare(struct data *data)
+{
+	size_t i;
+
+	/* newer tips first, so that older ones cut their walk short */
+	QSORT(data->tips.items, data->tips.nr, compare_tips);
+	for (i = 0; i < data->tips.nr; i++)
+		summarize_tip(data, data->tips.items[i]);
+	data->prepared = 1;
+}
+
+static void known_common(struct fetch_negotiator *n, struct commit *c)
+{
+	struct data *data = n->data;
+
+	if (c->object.flags & SEEN)
+		return;
+	c->object.flags |= SEEN | COMMON;
+	/* tell the server, so that it need not send its history */
+	commit_stack_push(&data->to_send, c);
+}
+
+static void add_tip(struct fetch_negotiator *n, struct commit *c)
+{
+	struct data *data = n->data;
+
+	n->known_common = NULL;
+	if (c->object.flags & SEEN)
+		return;
+	c->object.flags |= SEEN;
+	commit_stack_push(&data->tips, c);
+}
+
+static const struct object_id *next(struct fetch_negotiator *n)
+{
+	struct data *data = n->data;
+
+	n->known_common = NULL;
+	n->add_tip = NULL;
+	if (!data->prepared)
+		prepare(data);
+	if (data->sent == data->to_send.nr)
+		return NULL;
+	return &data->to_send.items[data->sent++]->object.oid;
+}
+
+static int ack(struct fetch_negotiator *n UNUSED, struct commit *c)
+{
+	int known_to_be_common = !!(c->object.flags & COMMON);
+	if (!(c->object.flags & SEEN))
+		die("received ack for commit %s not sent as 'have'",
+		    oid_to_hex(&c->object.oid));
+	c->object.flags |= COMMON;
+	return known_to_be_common;
+}
+
+static void have_sent(struct fetch_negotiator *n UNUSED, struct commit *c)
+{
+	/* its history need not be summarized again */
+	c->object.flags |= SEEN | COMMON;
+}
+
+static void release(struct fetch_negotiator *n)
+{
+	struct data *data = n->data;
+	size_t i;
+
+	for (i = 0; i < data->to_send.nr; i++)
+		clear_commit_marks(data->to_send.items[i], SEEN | COMMON);
+	for (i = 0; i < data->tips.nr; i++)
+		clear_commit_marks(data->tips.items[i], SEEN | COMMON);
+	commit_stack_clear(&data->to_send);
+	commit_stack_clear(&data->tips);
+	FREE_AND_NULL(n->data);
+}
+
+void summary_negotiator_init(struct fetch_negotiator *negotiator)
+{
+	struct data *data;
+	negotiator->known_common = known_common;
+	negotiator->add_tip = add_tip;
+	negotiator->next = next;
+	negotiator->ack = ack;
+	negotiator->have_sent = have_sent;
+	negotiator->release = release;
+	negotiator->one_round = 1;
+	negotiator->data = CALLOC_ARRAY(data, 1);
+	commit_stack_init(&data->tips);
+	commit_stack_init(&data->to_send);
+}
@@ -0,0 +1,8 @@
+#ifndef NEGOTIATOR_SUMMARY_H
+#define NEGOTIATOR_SUMMARY_H
+
+struct fetch_negotiator;
+
+void summary_negotiator_init(struct fetch_negotiator *negotiator);
+
+#endif
@@ -68,6 +68,7 @@ void object_array_init(struct object_array *array);
  * fetch-pack.c:             01    67
  * negotiator/default.c:       2--5
  * negotiator/skipping.c:      2--5
+ * negotiator/summary.c:       2 4
  * walker.c:                 0-2
  * upload-pack.c:                4       11-----14  16-----19
  * builtin/blame.c:                        12-13
@@ -3204,6 +3204,57 @@ int bitmap_has_oid_in_uninteresting(struct bitmap_index *bitmap_git,
 		bitmap_walk_contains(bitmap_git, bitmap_git->haves, oid);
 }
 
+int bitmap_tips_reachable_from_bases(struct repository *r,
+				     struct commit_list *bases,
+				     struct commit **tips, size_t tips_nr,
+				     unsigned int mark)
+{
+	struct bitmap_index *bitmap_git;
+	struct rev_info revs;
+
+	repo_init_revisions(r, &revs, NULL);
+	for (; bases; bases = bases->next)
+		add_pending_object(&revs, &bases->item->object, "");
+
+	bitmap_git = prepare_bitmap_walk(&revs, 0);
+	reset_revision_walk();
+	if (!bitmap_git) {
+		release_revisions(&revs);
+		return -1;
+	}
+
+	for (size_t i = 0; i < tips_nr; i++)
+		if (bitmap_walk_contains(bitmap_git, bitmap_git->result,
+					 &tips[i]->object.oid))
+			tips[i]->object.flags |= mark;
+
+	free_bitmap_index(bitmap_git);
+	release_revisions(&revs);
+	return 0;
+}
+
+int bitmap_commit_contains(struct bitmap_index *bitmap_git,
+			   struct commit *commit,
+			   const struct commit_list *list)
+{
+	struct ewah_bitmap *ewah = bitmap_for_commit(bitmap_git, commit);
+	int ret = 0;
+
+	if (!ewah)
+		return -1;
+
+	for (; list; list = list->next) {
+		int pos = bitmap_position(bitmap_git, &list->item->object.oid);
+
+		if (pos < 0 || pos >= (int)bitmap_num_objects_total(bitmap_git))
+			ret = -1;
+		else if (ewah_get(ewah, pos))
+			return 1;
+	}
+
+	return ret;
+}
+
 static off_t get_disk_usage_for_type(struct bitmap_index *bitmap_git,
 				     enum object_type object_type)
 {
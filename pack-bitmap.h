@@ -9,6 +9,7 @@
 #include "string-list.h"
 
 struct commit;
+struct commit_list;
 struct repository;
 struct rev_info;
 
@@ -130,6 +131,27 @@ int bitmap_walk_contains(struct bitmap_index *,
  */
 int bitmap_has_oid_in_uninteresting(struct bitmap_index *, const struct object_id *oid);
 
+/*
+ * Like tips_reachable_from_bases(), but answer the question by computing
+ * the set of objects reachable from `bases` with a bitmap walk, and testing
+ * each tip for membership. Returns -1 without marking any tips if there is
+ * no usable reachability bitmap.
+ */
+int bitmap_tips_reachable_from_bases(struct repository *r,
+				     struct commit_list *bases,
+				     struct commit **tips, size_t tips_nr,
+				     unsigned int mark);
+
+/*
+ * Check whether any of the commits in `list` is reachable from `commit`
+ * by looking them up in the bitmap of `commit`. Returns 1 if one is, 0
+ * if none is, and -1 if this cannot be told because `commit` has no
+ * bitmap or some commit in `list` is not in the bitmapped packs.
+ */
+int bitmap_commit_contains(struct bitmap_index *bitmap_git,
+			   struct commit *commit,
+			   const struct commit_list *list);
+
 off_t get_disk_usage_from_bitmap(struct bitmap_index *, struct rev_info *);
 
 struct bitmap_pos_cache_entry;
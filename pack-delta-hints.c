@@ -0,0 +1,150 @@
+#include "git-compat-util.h"
+#include "chunk-format.h"
+#include "gettext.h"
+#include "pack-delta-hints.h"
+#include "packfile.h"
+#include "strbuf.h"
+
+static char *pack_delta_hints_filename(struct packed_git *p)
+{
+	size_t len;
+	if (!strip_suffix(p->pack_name, ".pack", &len))
+		BUG("pack_name does not end in .pack");
+	return xstrfmt("%.*s.hints", (int)len, p->pack_name);
+}
+
+#define DELTA_HINTS_HEADER_SIZE (12)
+
+struct delta_hints_header {
+	uint32_t signature;
+	uint32_t version;
+	uint32_t hash_id;
+};
+
+static int load_pack_delta_hints_file(char *hints_file,
+				      uint32_t num_objects,
+				      const struct git_hash_algo *algo,
+				      const unsigned char *pack_hash,
+				      const uint32_t **data_p, size_t *len_p)
+{
+	int fd, ret = 0;
+	struct stat st;
+	uint32_t *data = NULL;
+	size_t hints_size, expected_size;
+	struct delta_hints_header header;
+
+	fd = git_open(hints_file);
+
+	if (fd < 0) {
+		ret = -1;
+		goto cleanup;
+	}
+	if (fstat(fd, &st)) {
+		ret = error_errno(_("failed to read %s"), hints_file);
+		goto cleanup;
+	}
+
+	hints_size = xsize_t(st.st_size);
+
+	if (hints_size < DELTA_HINTS_HEADER_SIZE) {
+		ret = error(_("delta hints file %s is too small"), hints_file);
+		goto cleanup;
+	}
+
+	data = xmmap(NULL, hints_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	header.signature = ntohl(data[0]);
+	header.version = ntohl(data[1]);
+	header.hash_id = ntohl(data[2]);
+
+	if (header.signature != DELTA_HINTS_SIGNATURE) {
+		ret = error(_("delta hints file %s has unknown signature"),
+			    hints_file);
+		goto cleanup;
+	}
+
+	if (header.version != DELTA_HINTS_VERSION) {
+		ret = error(_("delta hints file %s has unsupported version %"PRIu32),
+			    hints_file, header.version);
+		goto cleanup;
+	}
+
+	if (header.hash_id != oid_version(algo)) {
+		ret = error(_("delta hints file %s has unsupported hash id %"PRIu32),
+			    hints_file, header.hash_id);
+		goto cleanup;
+	}
+
+	expected_size = DELTA_HINTS_HEADER_SIZE;
+	expected_size = st_add(expected_size, st_mult(sizeof(uint32_t), num_objects));
+	expected_size = st_add(expected_size, st_mult(2, algo->rawsz));
+
+	if (hints_size != expected_size) {
+		ret = error(_("delta hints file %s is corrupt"), hints_file);
+		goto cleanup;
+	}
+
+	/*
+	 * The hint positions are only meaningful for the pack the file
+	 * was written with, so ignore a .hints file left over from another
+	 * pack of the same name.
+	 */
+	if (!hasheq((unsigned char *)data + hints_size - 2 * algo->rawsz,
+		    pack_hash, algo)) {
+		ret = error(_("delta hints file %s does not match its pack"),
+			    hints_file);
+		goto cleanup;
+	}
+
+cleanup:
+	if (ret) {
+		if (data)
+			munmap(data, hints_size);
+	} else {
+		*len_p = hints_size;
+		*data_p = data;
+	}
+
+	if (fd >= 0)
+		close(fd);
+	return ret;
+}
+
+int load_pack_delta_hints(struct packed_git *p)
+{
+	char *hints_name = NULL;
+	int ret = 0;
+
+	if (p->delta_hints_map)
+		return ret; /* already loaded */
+	if (p->delta_hints_tried)
+		return -1; /* there is none, or it is unusable */
+	p->delta_hints_tried = 1;
+
+	ret = open_pack_index(p);
+	if (ret < 0)
+		goto cleanup;
+
+	hints_name = pack_delta_hints_filename(p);
+	ret = load_pack_delta_hints_file(hints_name,
+					 p->num_objects,
+					 p->repo->hash_algo,
+					 (unsigned char *)p->index_data +
+					 p->index_size - 2 * p->repo->hash_algo->rawsz,
+					 &p->delta_hints_map,
+					 &p->delta_hints_size);
+cleanup:
+	free(hints_name);
+	return ret;
+}
+
+uint32_t nth_packed_delta_hint(struct packed_git *p, uint32_t pos)
+{
+	if (!p->delta_hints_map)
+		BUG("pack .hints file not loaded for %s", p->pack_name);
+	if (p->num_objects <= pos)
+		BUG("pack .hints out-of-bounds (%"PRIu32" vs %"PRIu32")",
+		    pos, p->num_objects);
+
+	return get_be32(p->delta_hints_map + pos + 3);
+}
@@ -0,0 +1,31 @@
+#ifndef PACK_DELTA_HINTS_H
+#define PACK_DELTA_HINTS_H
+
+#define DELTA_HINTS_SIGNATURE 0x44484e54 /* "DHNT" */
+#define DELTA_HINTS_VERSION 1
+
+/* Nothing is known about a delta base for the object. */
+#define DELTA_HINT_NONE 0xffffffff
+/* A delta base was searched for, but none was found. */
+#define DELTA_HINT_WHOLE 0xfffffffe
+
+struct packed_git;
+
+/*
+ * Loads the .hints file corresponding to "p", if any, returning zero
+ * on success.
+ */
+int load_pack_delta_hints(struct packed_git *p);
+
+/*
+ * Returns the delta hint of the object at position "pos" (in
+ * lexicographic/index order) in pack "p": either the position of its
+ * delta base in the same pack, or one of the DELTA_HINT_* values
+ * above.
+ *
+ * Note that it is a BUG() to call this function if "p" does not have a
+ * loaded .hints file.
+ */
+uint32_t nth_packed_delta_hint(struct packed_git *p, uint32_t pos);
+
+#endif
@@ -158,6 +158,7 @@ void clear_packing_data(struct packing_data *pdata)
 		return;
 
 	free(pdata->cruft_mtime);
+	free(pdata->delta_hint);
 	free(pdata->in_pack);
 	free(pdata->in_pack_by_idx);
 	free(pdata->in_pack_pos);
@@ -118,6 +118,7 @@ struct object_entry {
 	unsigned dfs_state:OE_DFS_STATE_BITS;
 	unsigned depth:OE_DEPTH_BITS;
 	unsigned ext_base:1; /* delta_idx points outside packlist */
+	unsigned delta_hint_whole:1; /* an earlier search found no base */
 };
 
 /**
@@ -180,6 +181,14 @@ struct packing_data {
 	 * written out in lexicographic (index) order.
 	 */
 	uint32_t *cruft_mtime;
+
+	/*
+	 * Used when writing delta hints (see pack-delta-hints.h).
+	 *
+	 * For each object, either 1 + the position in "objects" of its
+	 * delta base, or one of DELTA_HINT_NONE and DELTA_HINT_WHOLE.
+	 */
+	uint32_t *delta_hint;
 };
 
 void prepare_packing_data(struct repository *r, struct packing_data *pdata);
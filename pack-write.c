@@ -8,6 +8,7 @@
 #include "chunk-format.h"
 #include "object-file.h"
 #include "pack-mtimes.h"
+#include "pack-delta-hints.h"
 #include "pack-objects.h"
 #include "pack-revindex.h"
 #include "path.h"
@@ -361,6 +362,73 @@ static char *write_mtimes_file(struct repository *repo,
 	return mtimes_name;
 }
 
+static int idx_entry_cmp(const void *key, const void *entry)
+{
+	const struct object_id *oid = key;
+	const struct pack_idx_entry *const *e = entry;
+	return oidcmp(oid, &(*e)->oid);
+}
+
+/*
+ * Writes the delta hints of "objects" for use in a .hints file. As for
+ * .mtimes files, objects must be in lexicographic (index) order.
+ */
+static void write_delta_hints_objects(struct hashfile *f,
+				      struct packing_data *to_pack,
+				      struct pack_idx_entry **objects,
+				      uint32_t nr_objects)
+{
+	uint32_t i;
+	for (i = 0; i < nr_objects; i++) {
+		struct object_entry *e = (struct object_entry *)objects[i];
+		uint32_t hint = to_pack->delta_hint[e - to_pack->objects];
+
+		if (hint != DELTA_HINT_NONE && hint != DELTA_HINT_WHOLE) {
+			struct object_entry *base = &to_pack->objects[hint - 1];
+			struct pack_idx_entry **pos;
+
+			/* The base may have been written to another pack. */
+			pos = bsearch(&base->idx.oid, objects, nr_objects,
+				      sizeof(*objects), idx_entry_cmp);
+			hint = pos ? pos - objects : DELTA_HINT_NONE;
+		}
+		hashwrite_be32(f, hint);
+	}
+}
+
+static char *write_delta_hints_file(struct repository *repo,
+				    struct packing_data *to_pack,
+				    struct pack_idx_entry **objects,
+				    uint32_t nr_objects,
+				    const unsigned char *hash)
+{
+	struct strbuf tmp_file = STRBUF_INIT;
+	char *hints_name;
+	struct hashfile *f;
+	int fd;
+
+	if (!to_pack || !to_pack->delta_hint)
+		BUG("cannot call write_delta_hints_file without delta hints");
+
+	fd = odb_mkstemp(repo->objects, &tmp_file, "pack/tmp_hints_XXXXXX");
+	hints_name = strbuf_detach(&tmp_file, NULL);
+	f = hashfd(repo->hash_algo, fd, hints_name);
+
+	hashwrite_be32(f, DELTA_HINTS_SIGNATURE);
+	hashwrite_be32(f, DELTA_HINTS_VERSION);
+	hashwrite_be32(f, oid_version(repo->hash_algo));
+	write_delta_hints_objects(f, to_pack, objects, nr_objects);
+	hashwrite(f, hash, repo->hash_algo->rawsz);
+
+	if (adjust_shared_perm(repo, hints_name) < 0)
+		die(_("failed to make %s readable"), hints_name);
+
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_PACK_METADATA,
+			  CSUM_HASH_IN_STREAM | CSUM_CLOSE | CSUM_FSYNC);
+
+	return hints_name;
+}
+
 off_t write_pack_header(struct hashfile *f, uint32_t nr_entries)
 {
 	struct pack_header hdr;
@@ -570,6 +638,7 @@ void stage_tmp_packfiles(struct repository *repo,
 {
 	char *rev_tmp_name = NULL;
 	char *mtimes_tmp_name = NULL;
+	char *hints_tmp_name = NULL;
 
 	if (adjust_shared_perm(repo, pack_tmp_name))
 		die_errno("unable to make temporary pack file readable");
@@ -588,14 +657,23 @@ void stage_tmp_packfiles(struct repository *repo,
 						    hash);
 	}
 
+	if (pack_idx_opts->flags & WRITE_DELTA_HINTS) {
+		hints_tmp_name = write_delta_hints_file(repo, to_pack,
+							written_list, nr_written,
+							hash);
+	}
+
 	rename_tmp_packfile(repo, name_buffer, pack_tmp_name, "pack");
 	if (rev_tmp_name)
 		rename_tmp_packfile(repo, name_buffer, rev_tmp_name, "rev");
 	if (mtimes_tmp_name)
 		rename_tmp_packfile(repo, name_buffer, mtimes_tmp_name, "mtimes");
+	if (hints_tmp_name)
+		rename_tmp_packfile(repo, name_buffer, hints_tmp_name, "hints");
 
 	free(rev_tmp_name);
 	free(mtimes_tmp_name);
+	free(hints_tmp_name);
 }
 
 void write_promisor_file(const char *promisor_name, struct ref **sought, int nr_sought)
@@ -48,6 +48,7 @@ struct pack_idx_option {
 #define WRITE_REV 04
 #define WRITE_REV_VERIFY 010
 #define WRITE_MTIMES 020
+#define WRITE_DELTA_HINTS 040
 
 	uint32_t version;
 	uint32_t off32_limit;
@@ -33,7 +33,8 @@ struct packed_git {
 		 do_not_close:1,
 		 pack_promisor:1,
 		 multi_pack_index:1,
-		 is_cruft:1;
+		 is_cruft:1,
+		 delta_hints_tried:1;
 	unsigned char hash[GIT_MAX_RAWSZ];
 	struct revindex_entry *revindex;
 	const uint32_t *revindex_data;
@@ -46,6 +47,12 @@ struct packed_git {
 	 */
 	const uint32_t *mtimes_map;
 	size_t mtimes_size;
+	/*
+	 * delta_hints_map points at the memory mapped .hints file of this
+	 * pack, if any (see pack-delta-hints.h).
+	 */
+	const uint32_t *delta_hints_map;
+	size_t delta_hints_size;
 
 	/* repo denotes the repository this packfile belongs to */
 	struct repository *repo;
@@ -16,11 +16,13 @@
 #include "oid-array.h"
 #include "path.h"
 #include "prio-queue.h"
+#include "promisor-remote.h"
 #include "repository.h"
 #include "revision.h"
 #include "string-list.h"
 #include "strmap.h"
 #include "tag.h"
+#include "thread-utils.h"
 #include "trace2.h"
 #include "tree.h"
 #include "tree-walk.h"
@@ -67,6 +69,9 @@ struct path_walk_context {
 	struct prio_queue path_stack;
 	struct strset path_stack_pushed;
 
+	/* The number of trees read from multiple threads. */
+	size_t threaded_trees_nr;
+
 	unsigned exact_pathspecs:1;
 };
 
@@ -282,6 +287,117 @@ static int add_tree_entries(struct path_walk_context *ctx,
 	return 0;
 }
 
+/*
+ * Trees at a path are read in batches of this many. Each batch is read
+ * from multiple threads before its trees are expanded on the main
+ * thread, which bounds how many tree buffers are held at once.
+ */
+#define TREE_BATCH_SIZE 512
+#define TREE_BATCH_MIN_PER_THREAD 32
+
+struct read_trees_data {
+	struct repository *repo;
+	struct tree **trees;
+	void **buffers;
+	unsigned long *sizes;
+	size_t nr;
+	size_t next;
+};
+
+static void *read_trees_thread(void *arg)
+{
+	struct read_trees_data *d = arg;
+
+	for (;;) {
+		enum object_type type;
+		size_t i;
+
+		/* The object read lock also protects the next tree to read. */
+		obj_read_lock();
+		i = d->next++;
+		obj_read_unlock();
+		if (i >= d->nr)
+			break;
+
+		d->buffers[i] = odb_read_object(d->repo->objects,
+						&d->trees[i]->object.oid,
+						&type, &d->sizes[i]);
+		if (d->buffers[i] && type != OBJ_TREE)
+			FREE_AND_NULL(d->buffers[i]);
+	}
+	return NULL;
+}
+
+/*
+ * Parse the trees in 'oids' that are not parsed yet, inflating them in
+ * parallel. Trees that cannot be read are left alone, so that
+ * add_tree_entries() reports them as usual.
+ */
+static void read_trees(struct path_walk_context *ctx,
+		       const struct object_id *oids, size_t oids_nr)
+{
+	struct read_trees_data d = { .repo = ctx->repo };
+	pthread_t *threads;
+	int nr_threads = ctx->info->threads;
+	int lock_was_enabled = obj_read_use_lock;
+
+	if (nr_threads <= 1 || oids_nr < 2 * TREE_BATCH_MIN_PER_THREAD)
+		return;
+
+	/*
+	 * Reading a tree that is missing locally fetches it lazily, which
+	 * must not be started from the worker threads. Leave all trees to
+	 * the main thread instead.
+	 */
+	if (repo_has_promisor_remote(ctx->repo))
+		return;
+
+	ALLOC_ARRAY(d.trees, oids_nr);
+	for (size_t i = 0; i < oids_nr; i++) {
+		struct tree *tree = lookup_tree(ctx->repo, &oids[i]);
+		if (tree && !tree->object.parsed)
+			d.trees[d.nr++] = tree;
+	}
+	if ((size_t)nr_threads > d.nr / TREE_BATCH_MIN_PER_THREAD)
+		nr_threads = d.nr / TREE_BATCH_MIN_PER_THREAD;
+	if (nr_threads <= 1) {
+		free(d.trees);
+		return;
+	}
+
+	CALLOC_ARRAY(d.buffers, d.nr);
+	CALLOC_ARRAY(d.sizes, d.nr);
+	CALLOC_ARRAY(threads, nr_threads);
+
+	enable_obj_read_lock();
+	for (int i = 0; i < nr_threads; i++) {
+		int ret = pthread_create(&threads[i], NULL,
+					 read_trees_thread, &d);
+		if (ret)
+			die(_("unable to create thread: %s"), strerror(ret));
+	}
+	for (int i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	if (!lock_was_enabled)
+		disable_obj_read_lock();
+
+	ctx->threaded_trees_nr += d.nr;
+	for (size_t i = 0; i < d.nr; i++) {
+		if (!d.buffers[i])
+			continue;
+		/* The same tree may appear more than once in a batch. */
+		if (d.trees[i]->object.parsed)
+			free(d.buffers[i]);
+		else
+			parse_tree_buffer(d.trees[i], d.buffers[i], d.sizes[i]);
+	}
+
+	free(threads);
+	free(d.sizes);
+	free(d.buffers);
+	free(d.trees);
+}
+
 /*
  * Paths starting with '/' (e.g., "/tags", "/tagged-blobs") hold objects that
  * were directly requested by 'pending' objects rather than discovered during
@@ -399,10 +515,17 @@ static int walk_path(struct path_walk_context *ctx,
 		/* Use root path if expanding from tagged/direct trees. */
 		const char *expand_path = !strcmp(path, "/tagged-trees")
 					  ? root_path : path;
-		for (size_t i = 0; i < list->oids.nr; i++) {
-			ret |= add_tree_entries(ctx,
-					    expand_path,
-					    &list->oids.oid[i]);
+		for (size_t i = 0; i < list->oids.nr; i += TREE_BATCH_SIZE) {
+			size_t end = i + TREE_BATCH_SIZE;
+
+			if (end > list->oids.nr)
+				end = list->oids.nr;
+			read_trees(ctx, list->oids.oid + i, end - i);
+
+			for (size_t j = i; j < end; j++)
+				ret |= add_tree_entries(ctx,
+						expand_path,
+						&list->oids.oid[j]);
 		}
 	}
 
@@ -836,6 +959,9 @@ int walk_objects_by_path(struct path_walk_info *info)
 	}
 
 	trace2_data_intmax("path-walk", ctx.repo, "paths", paths_nr);
+	if (ctx.threaded_trees_nr)
+		trace2_data_intmax("path-walk", ctx.repo, "threaded-trees",
+				   ctx.threaded_trees_nr);
 	trace2_region_leave("path-walk", "path-walk", info->revs->repo);
 
 	clear_paths_to_lists(&ctx.paths_to_lists);
@@ -90,6 +90,13 @@ struct path_walk_info {
 	 */
 	struct pattern_list *pl;
 	int pl_sparse_trees;
+
+	/**
+	 * The number of threads used to read the trees at a path before
+	 * walking their children. The trees are read on the calling
+	 * thread when this is 0 or 1.
+	 */
+	int threads;
 };
 
 #define PATH_WALK_INFO_INIT {   \
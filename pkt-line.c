@@ -202,7 +202,7 @@ int packet_write_fmt_gently(int fd, const char *fmt, ...)
 static int do_packet_write(const int fd_out, const char *buf, size_t size,
 			   struct strbuf *err)
 {
-	char header[4];
+	char packet[DEFAULT_PACKET_MAX];
 	size_t packet_size;
 
 	if (size > LARGE_PACKET_DATA_MAX) {
@@ -213,7 +213,20 @@ static int do_packet_write(const int fd_out, const char *buf, size_t size,
 	packet_trace(buf, size, 1);
 	packet_size = size + 4;
 
-	set_packet_header(header, packet_size);
+	set_packet_header(packet, packet_size);
+
+	/*
+	 * Small packets are assembled on the stack, so that they go out
+	 * with a single write(2).
+	 */
+	if (packet_size <= sizeof(packet)) {
+		memcpy(packet + 4, buf, size);
+		if (write_in_full(fd_out, packet, packet_size) < 0) {
+			strbuf_addf(err, _("packet write failed: %s"), strerror(errno));
+			return -1;
+		}
+		return 0;
+	}
 
 	/*
 	 * Write the header and the buffer in 2 parts so that we do
@@ -222,7 +235,7 @@ static int do_packet_write(const int fd_out, const char *buf, size_t size,
 	 * might have multi-threading issues.
 	 */
 
-	if (write_in_full(fd_out, header, 4) < 0 ||
+	if (write_in_full(fd_out, packet, 4) < 0 ||
 	    write_in_full(fd_out, buf, size) < 0) {
 		strbuf_addf(err, _("packet write failed: %s"), strerror(errno));
 		return -1;
@@ -678,6 +691,37 @@ void packet_writer_init(struct packet_writer *writer, int dest_fd)
 {
 	writer->dest_fd = dest_fd;
 	writer->use_sideband = 0;
+	writer->buffered = 0;
+	strbuf_init(&writer->buf, 0);
+}
+
+void packet_writer_release(struct packet_writer *writer)
+{
+	strbuf_release(&writer->buf);
+}
+
+void packet_writer_drain(struct packet_writer *writer)
+{
+	if (!writer->buf.len)
+		return;
+	if (write_in_full(writer->dest_fd, writer->buf.buf, writer->buf.len) < 0) {
+		check_pipe(errno);
+		die_errno(_("packet write failed"));
+	}
+	strbuf_reset(&writer->buf);
+}
+
+static void packet_writer_fmt(struct packet_writer *writer, const char *prefix,
+			      const char *fmt, va_list args)
+{
+	if (!writer->buffered) {
+		packet_write_fmt_1(writer->dest_fd, 0, prefix, fmt, args);
+		return;
+	}
+
+	format_packet(&writer->buf, prefix, fmt, args);
+	if (writer->buf.len >= LARGE_PACKET_MAX)
+		packet_writer_drain(writer);
 }
 
 void packet_writer_write(struct packet_writer *writer, const char *fmt, ...)
@@ -685,8 +729,7 @@ void packet_writer_write(struct packet_writer *writer, const char *fmt, ...)
 	va_list args;
 
 	va_start(args, fmt);
-	packet_write_fmt_1(writer->dest_fd, 0,
-			   writer->use_sideband ? "\001" : "", fmt, args);
+	packet_writer_fmt(writer, writer->use_sideband ? "\001" : "", fmt, args);
 	va_end(args);
 }
 
@@ -695,17 +738,27 @@ void packet_writer_error(struct packet_writer *writer, const char *fmt, ...)
 	va_list args;
 
 	va_start(args, fmt);
-	packet_write_fmt_1(writer->dest_fd, 0,
-			   writer->use_sideband ? "\003" : "ERR ", fmt, args);
+	packet_writer_fmt(writer, writer->use_sideband ? "\003" : "ERR ", fmt, args);
 	va_end(args);
+
+	/* the caller is likely to die() soon */
+	packet_writer_drain(writer);
 }
 
 void packet_writer_delim(struct packet_writer *writer)
 {
-	packet_delim(writer->dest_fd);
+	if (writer->buffered)
+		packet_buf_delim(&writer->buf);
+	else
+		packet_delim(writer->dest_fd);
 }
 
 void packet_writer_flush(struct packet_writer *writer)
 {
-	packet_flush(writer->dest_fd);
+	if (writer->buffered) {
+		packet_buf_flush(&writer->buf);
+		packet_writer_drain(writer);
+	} else {
+		packet_flush(writer->dest_fd);
+	}
 }
@@ -237,9 +237,23 @@ extern char packet_buffer[LARGE_PACKET_MAX];
 struct packet_writer {
 	int dest_fd;
 	unsigned use_sideband : 1;
+
+	/*
+	 * If set, packets are collected in "buf" and written out in
+	 * batches: whenever a flush packet is written, an error is
+	 * reported, packet_writer_drain() is called, or enough data
+	 * for a large packet has piled up. The caller must drain the
+	 * writer before writing to dest_fd by other means.
+	 */
+	unsigned buffered : 1;
+	struct strbuf buf;
 };
 
 void packet_writer_init(struct packet_writer *writer, int dest_fd);
+void packet_writer_release(struct packet_writer *writer);
+
+/* Write out the packets buffered so far. Dies upon failure. */
+void packet_writer_drain(struct packet_writer *writer);
 
 /* These functions die upon failure. */
 __attribute__((format (printf, 2, 3)))
@@ -83,6 +83,7 @@ int cap_object_info(struct repository *r, struct packet_reader *request)
 	struct string_list oid_str_list = STRING_LIST_INIT_DUP;
 
 	packet_writer_init(&writer, 1);
+	writer.buffered = 1;
 
 	while (packet_reader_read(request) == PACKET_READ_NORMAL) {
 		if (!strcmp("size", request->line)) {
@@ -108,7 +109,8 @@ int cap_object_info(struct repository *r, struct packet_reader *request)
 
 	string_list_clear(&oid_str_list, 1);
 
-	packet_flush(1);
+	packet_writer_flush(&writer);
+	packet_writer_release(&writer);
 
 	return 0;
 }
@@ -14,6 +14,7 @@
 #include "object-name.h"
 #include "odb.h"
 #include "oid-array.h"
+#include "pack-bitmap.h"
 #include "repo-settings.h"
 #include "repository.h"
 #include "commit.h"
@@ -33,6 +34,7 @@
 #include "commit-reach.h"
 #include "worktree.h"
 #include "hashmap.h"
+#include "trace2.h"
 
 static struct ref_msg {
 	const char *gone;
@@ -3154,10 +3156,17 @@ static void reach_filter(struct ref_array *array,
 		to_clear[i] = item->commit;
 	}
 
-	tips_reachable_from_bases(the_repository,
-				  *check_reachable,
-				  to_clear, array->nr,
-				  UNINTERESTING);
+	if (!bitmap_tips_reachable_from_bases(the_repository,
+					      *check_reachable,
+					      to_clear, array->nr,
+					      UNINTERESTING))
+		trace2_data_intmax("ref-filter", the_repository,
+				   "merged/bitmap", array->nr);
+	else
+		tips_reachable_from_bases(the_repository,
+					  *check_reachable,
+					  to_clear, array->nr,
+					  UNINTERESTING);
 
 	old_nr = array->nr;
 	array->nr = 0;
@@ -3296,6 +3305,10 @@ static int do_filter_refs(struct ref_filter *filter, unsigned int type, refs_for
 
 	init_contains_cache(&filter->internal.contains_cache);
 	init_contains_cache(&filter->internal.no_contains_cache);
+	if (filter->with_commit || filter->no_commit) {
+		filter->internal.bitmap_git = prepare_bitmap_git(the_repository);
+		filter->internal.bitmap_contains_nr = 0;
+	}
 
 	/*  Simple per-ref filtering */
 	if (!filter->kind)
@@ -3317,14 +3330,17 @@ static int do_filter_refs(struct ref_filter *filter, unsigned int type, refs_for
 	if (prefix) {
 		struct ref_iterator *iter;
 
+		/*
+		 * Do not start out iterating over all references only to
+		 * seek to the prefix right away, as that would make the
+		 * "files" backend read all loose references.
+		 */
 		iter = refs_ref_iterator_begin(get_main_ref_store(the_repository),
-					       "", NULL, 0, 0);
+					       filter->start_after ? "" : prefix,
+					       NULL, 0, 0);
 
 		if (filter->start_after)
 			ret = start_ref_iterator_after(iter, filter->start_after);
-		else
-			ret = ref_iterator_seek(iter, prefix,
-						REF_ITERATOR_SEEK_SET_PREFIX);
 
 		if (!ret)
 			ret = do_for_each_ref_iterator(iter, fn, cb_data);
@@ -3344,6 +3360,12 @@ static int do_filter_refs(struct ref_filter *filter, unsigned int type, refs_for
 
 	clear_contains_cache(&filter->internal.contains_cache);
 	clear_contains_cache(&filter->internal.no_contains_cache);
+	if (filter->internal.bitmap_git) {
+		trace2_data_intmax("ref-filter", the_repository, "contains/bitmap",
+				   filter->internal.bitmap_contains_nr);
+		free_bitmap_index(filter->internal.bitmap_git);
+		filter->internal.bitmap_git = NULL;
+	}
 
 	return ret;
 }
@@ -30,6 +30,7 @@
 struct atom_value;
 struct ref_sorting;
 struct ahead_behind_count;
+struct bitmap_index;
 struct option;
 
 enum ref_sorting_order {
@@ -85,6 +86,8 @@ struct ref_filter {
 	struct {
 		struct contains_cache contains_cache;
 		struct contains_cache no_contains_cache;
+		struct bitmap_index *bitmap_git;
+		size_t bitmap_contains_nr;
 	} internal;
 };
 
@@ -774,6 +774,13 @@ enum ref_transaction_flag {
 	 * while rejecting updates which do not match the expected state.
 	 */
 	REF_TRANSACTION_ALLOW_FAILURE = (1 << 1),
+
+	/*
+	 * Do not run the reference-transaction hook. This is meant for
+	 * transactions that a backend runs internally on behalf of another
+	 * one, whose updates the hook has already been told about.
+	 */
+	REF_TRANSACTION_SKIP_HOOK = (1 << 2),
 };
 
 /*
@@ -27,6 +27,8 @@
 #include "../wrapper.h"
 #include "../write-or-die.h"
 #include "../revision.h"
+#include "../object.h"
+#include "../tempfile.h"
 #include <wildmatch.h>
 
 /*
@@ -72,6 +74,13 @@
  */
 #define REF_LOG_VIA_SPLIT (1 << 14)
 
+/*
+ * Used as a flag in ref_update::flags when the new value is written
+ * to packed-refs instead of to the loose reference, see
+ * `files_ref_store::packed_batch_size`.
+ */
+#define REF_WRITE_PACKED (1 << 16)
+
 struct ref_lock {
 	char *ref_name;
 	struct lock_file lk;
@@ -87,6 +96,13 @@ struct files_ref_store {
 	enum log_refs_config log_all_ref_updates;
 	int prefer_symlink_refs;
 
+	/*
+	 * Transactions updating at least this many references write
+	 * their new values to packed-refs instead of creating a loose
+	 * reference for each of them. Zero disables this.
+	 */
+	unsigned long packed_batch_size;
+
 	struct ref_cache *loose;
 
 	struct ref_store *packed_ref_store;
@@ -127,6 +143,7 @@ static struct ref_store *files_ref_store_init(struct repository *repo,
 	refs->log_all_ref_updates = opts->log_all_ref_updates;
 
 	repo_config_get_bool(repo, "core.prefersymlinkrefs", &refs->prefer_symlink_refs);
+	repo_config_get_ulong(repo, "core.packedrefsbatchsize", &refs->packed_batch_size);
 
 	chdir_notify_reparent("files-backend $GIT_DIR", &refs->base.gitdir);
 	chdir_notify_reparent("files-backend $GIT_COMMONDIR",
@@ -357,6 +374,23 @@ static void loose_fill_ref_dir(struct ref_store *ref_store,
 	add_per_worktree_entries_to_dir(dir, dirname);
 }
 
+/*
+ * Check whether the loose reference directory dirname exists, so that
+ * it can be read without reading its parent directory first.
+ */
+static int loose_probe_ref_dir(struct ref_store *ref_store, const char *dirname)
+{
+	struct files_ref_store *refs =
+		files_downcast(ref_store, REF_STORE_READ, "probe_ref_dir");
+	struct strbuf path = STRBUF_INIT;
+	int ret;
+
+	files_ref_path(refs, &path, dirname);
+	ret = is_directory(path.buf);
+	strbuf_release(&path);
+	return ret;
+}
+
 static int for_each_root_ref(struct files_ref_store *refs,
 			     int (*cb)(const char *refname, void *cb_data),
 			     void *cb_data)
@@ -441,6 +475,7 @@ static struct ref_cache *get_loose_ref_cache(struct files_ref_store *refs,
 		 * hold references:
 		 */
 		refs->loose = create_ref_cache(&refs->base, loose_fill_ref_dir);
+		refs->loose->probe_ref_dir = loose_probe_ref_dir;
 
 		/* We're going to fill the top level ourselves: */
 		refs->loose->root->flag &= ~REF_INCOMPLETE;
@@ -1998,6 +2033,40 @@ static int files_log_ref_write(struct files_ref_store *refs,
 	return 0;
 }
 
+/*
+ * Harden a newly written loose reference. In batch mode, only ask for
+ * the data to be written out here; `flush_batch_fsync()` issues a
+ * single hardware flush for all of them before the lockfiles are
+ * renamed into place.
+ */
+static int fsync_ref_lockfile(int fd)
+{
+	if (batch_fsync_enabled(FSYNC_COMPONENT_REFERENCE)) {
+		if (git_fsync(fd, FSYNC_WRITEOUT_ONLY) >= 0)
+			return 0;
+		if (errno == ENOSYS)
+			warning(_("core.fsyncMethod = batch is unsupported on this platform"));
+	}
+	return fsync_component(FSYNC_COMPONENT_REFERENCE, fd);
+}
+
+/*
+ * Issue a full hardware flush against a temporary file, so that all
+ * lockfiles written out by `fsync_ref_lockfile()` are durable before
+ * any of them becomes visible under its final name.
+ */
+static void flush_batch_fsync(struct files_ref_store *refs)
+{
+	struct strbuf temp_path = STRBUF_INIT;
+	struct tempfile *temp;
+
+	strbuf_addf(&temp_path, "%s/bulk_fsync_XXXXXX", refs->gitcommondir);
+	temp = xmks_tempfile(temp_path.buf);
+	fsync_or_die(get_tempfile_fd(temp), get_tempfile_path(temp));
+	delete_tempfile(&temp);
+	strbuf_release(&temp_path);
+}
+
 /*
  * Write oid into the open lockfile, then close the lockfile. On
  * errors, rollback the lockfile, fill in *err and return -1.
@@ -2013,7 +2082,7 @@ static enum ref_transaction_error write_ref_to_lockfile(struct files_ref_store *
 	fd = get_lock_file_fd(&lock->lk);
 	if (write_in_full(fd, oid_to_hex(oid), refs->base.repo->hash_algo->hexsz) < 0 ||
 	    write_in_full(fd, &term, 1) < 0 ||
-	    fsync_component(FSYNC_COMPONENT_REFERENCE, get_lock_file_fd(&lock->lk)) < 0 ||
+	    fsync_ref_lockfile(fd) < 0 ||
 	    close_ref_gently(lock) < 0) {
 		strbuf_addf(err,
 			    "couldn't write '%s'", get_lock_file_path(&lock->lk));
@@ -2615,6 +2684,7 @@ static enum ref_transaction_error check_old_oid(struct ref_update *update,
 struct files_transaction_backend_data {
 	struct ref_transaction *packed_transaction;
 	int packed_refs_locked;
+	int write_packed;
 	struct strmap ref_locks;
 };
 
@@ -2810,6 +2880,16 @@ static enum ref_transaction_error lock_ref_for_update(struct files_ref_store *re
 			 * The reference already has the desired
 			 * value, so we don't need to write it.
 			 */
+		} else if (backend_data->write_packed &&
+			   !(update->type & REF_ISSYMREF) &&
+			   parse_worktree_ref(update->refname, NULL, NULL, NULL) ==
+			   REF_WORKTREE_SHARED) {
+			/*
+			 * The new value goes to packed-refs. We keep
+			 * holding the lock so that nobody else writes
+			 * the loose reference in the meantime.
+			 */
+			update->flags |= REF_WRITE_PACKED;
 		} else {
 			ret = write_ref_to_lockfile(
 				refs, lock, &update->new_oid,
@@ -2893,6 +2973,23 @@ static void files_transaction_cleanup(struct files_ref_store *refs,
 	transaction->state = REF_TRANSACTION_CLOSED;
 }
 
+/*
+ * Return the flags to begin the packed-refs transaction of `transaction`
+ * with. When references are written to packed-refs directly, the
+ * reference-transaction hook has already seen them as part of
+ * `transaction`, so it must not see them a second time, without their
+ * old values, from the packed-refs transaction.
+ */
+static unsigned int packed_transaction_flags(struct ref_transaction *transaction)
+{
+	struct files_transaction_backend_data *backend_data =
+		transaction->backend_data;
+
+	if (backend_data->write_packed)
+		return transaction->flags | REF_TRANSACTION_SKIP_HOOK;
+	return transaction->flags;
+}
+
 static int files_transaction_prepare(struct ref_store *ref_store,
 				     struct ref_transaction *transaction,
 				     struct strbuf *err)
@@ -2917,6 +3014,8 @@ static int files_transaction_prepare(struct ref_store *ref_store,
 
 	CALLOC_ARRAY(backend_data, 1);
 	strmap_init(&backend_data->ref_locks);
+	backend_data->write_packed = refs->packed_batch_size &&
+		transaction->nr >= refs->packed_batch_size;
 	transaction->backend_data = backend_data;
 
 	/*
@@ -2989,7 +3088,8 @@ static int files_transaction_prepare(struct ref_store *ref_store,
 			if (!packed_transaction) {
 				packed_transaction = ref_store_transaction_begin(
 						refs->packed_ref_store,
-						transaction->flags, err);
+						packed_transaction_flags(transaction),
+						err);
 				if (!packed_transaction) {
 					ret = REF_TRANSACTION_ERROR_GENERIC;
 					goto cleanup;
@@ -3028,6 +3128,47 @@ static int files_transaction_prepare(struct ref_store *ref_store,
 		goto cleanup;
 	}
 
+	/*
+	 * Queue the new values of references that go to packed-refs.
+	 * This has to wait until the check above, which may reject
+	 * some of them.
+	 */
+	for (i = 0; i < transaction->nr; i++) {
+		struct ref_update *update = transaction->updates[i];
+		unsigned int flags = REF_HAVE_NEW | REF_NO_DEREF;
+
+		if (!(update->flags & REF_WRITE_PACKED) ||
+		    update->rejection_err)
+			continue;
+
+		if (!packed_transaction) {
+			packed_transaction = ref_store_transaction_begin(
+					refs->packed_ref_store,
+					packed_transaction_flags(transaction),
+					err);
+			if (!packed_transaction) {
+				ret = REF_TRANSACTION_ERROR_GENERIC;
+				goto cleanup;
+			}
+
+			backend_data->packed_transaction = packed_transaction;
+		}
+
+		/*
+		 * packed-refs promises to record the peeled value of all
+		 * tags, so compute it if the caller did not.
+		 */
+		if (!(update->flags & REF_HAVE_PEELED) &&
+		    peel_object(refs->base.repo, &update->new_oid,
+				&update->peeled, 0) == PEEL_PEELED)
+			update->flags |= REF_HAVE_PEELED;
+		flags |= update->flags & REF_HAVE_PEELED;
+
+		ref_transaction_add_update(packed_transaction, update->refname,
+					   flags, &update->new_oid, NULL,
+					   &update->peeled, NULL, NULL, NULL, NULL);
+	}
+
 	if (packed_transaction) {
 		if (packed_refs_lock(refs->packed_ref_store, 0, err)) {
 			ret = REF_TRANSACTION_ERROR_GENERIC;
@@ -3290,6 +3431,18 @@ static int files_transaction_finish(struct ref_store *ref_store,
 	backend_data = transaction->backend_data;
 	packed_transaction = backend_data->packed_transaction;
 
+	if (batch_fsync_enabled(FSYNC_COMPONENT_REFERENCE)) {
+		for (i = 0; i < transaction->nr; i++) {
+			struct ref_update *update = transaction->updates[i];
+
+			if (!update->rejection_err &&
+			    update->flags & REF_NEEDS_COMMIT) {
+				flush_batch_fsync(refs);
+				break;
+			}
+		}
+	}
+
 	/* Perform updates first so live commits remain referenced */
 	for (i = 0; i < transaction->nr; i++) {
 		struct ref_update *update = transaction->updates[i];
@@ -3299,6 +3452,7 @@ static int files_transaction_finish(struct ref_store *ref_store,
 			continue;
 
 		if (update->flags & REF_NEEDS_COMMIT ||
+		    update->flags & REF_WRITE_PACKED ||
 		    update->flags & REF_LOG_ONLY) {
 			if (parse_and_write_reflog(refs, update, lock, err)) {
 				ret = REF_TRANSACTION_ERROR_GENERIC;
@@ -3361,7 +3515,8 @@ static int files_transaction_finish(struct ref_store *ref_store,
 	 * Perform deletes now that updates are safely completed.
 	 *
 	 * First delete any packed versions of the references, while
-	 * retaining the packed-refs lock:
+	 * retaining the packed-refs lock. This also writes the new
+	 * values of updates that go to packed-refs:
 	 */
 	if (packed_transaction) {
 		ret = ref_transaction_commit(packed_transaction, err);
@@ -3372,7 +3527,10 @@ static int files_transaction_finish(struct ref_store *ref_store,
 			goto cleanup;
 	}
 
-	/* Now delete the loose versions of the references: */
+	/*
+	 * Now delete the loose versions of the references, including
+	 * those that would shadow the values just written to packed-refs:
+	 */
 	for (i = 0; i < transaction->nr; i++) {
 		struct ref_update *update = transaction->updates[i];
 		struct ref_lock *lock = update->backend_data;
@@ -3380,7 +3538,14 @@ static int files_transaction_finish(struct ref_store *ref_store,
 		if (update->rejection_err)
 			continue;
 
-		if (update->flags & REF_DELETING &&
+		if (update->flags & REF_WRITE_PACKED) {
+			strbuf_reset(&sb);
+			files_ref_path(refs, &sb, lock->ref_name);
+			if (unlink_or_msg(sb.buf, err)) {
+				ret = REF_TRANSACTION_ERROR_GENERIC;
+				goto cleanup;
+			}
+		} else if (update->flags & REF_DELETING &&
 		    !(update->flags & REF_LOG_ONLY)) {
 			update->flags |= REF_DELETED_RMDIR;
 			if (!(update->type & REF_ISPACKED) ||
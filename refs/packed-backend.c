@@ -3,6 +3,7 @@
 
 #include "../git-compat-util.h"
 #include "../config.h"
+#include "../csum-file.h"
 #include "../dir.h"
 #include "../fsck.h"
 #include "../gettext.h"
@@ -119,6 +120,20 @@ struct snapshot {
 	 * replaced since we read it.
 	 */
 	struct stat_validity validity;
+
+	/*
+	 * The mmapped `packed-refs.idx` file, if one exists that was
+	 * written for this very `packed-refs` file (see the comment
+	 * above `write_packed_refs_index()` for its format). If so,
+	 * `index_nr` is the number of records, and binary searches
+	 * consult the record offsets in the index instead of searching
+	 * for line boundaries in the text.
+	 */
+	const unsigned char *index_map;
+	size_t index_map_size;
+	const unsigned char *index_fanout;
+	const unsigned char *index_offsets;
+	uint32_t index_nr;
 };
 
 /*
@@ -162,6 +177,12 @@ struct packed_ref_store {
 	 * `packed_ref_store`) must not be freed.
 	 */
 	struct tempfile *tempfile;
+
+	/*
+	 * Temporary file holding the index for the new "packed-refs"
+	 * file, if "core.packedRefsIndex" is enabled.
+	 */
+	struct tempfile *index_tempfile;
 };
 
 /*
@@ -172,6 +193,15 @@ static void acquire_snapshot(struct snapshot *snapshot)
 	snapshot->referrers++;
 }
 
+static void release_packed_refs_index(struct snapshot *snapshot)
+{
+	if (snapshot->index_map) {
+		munmap((void *)snapshot->index_map, snapshot->index_map_size);
+		snapshot->index_map = NULL;
+		snapshot->index_nr = 0;
+	}
+}
+
 /*
  * If the buffer in `snapshot` is active, then either munmap the
  * memory and close the file, or free the memory. Then set the buffer
@@ -188,6 +218,8 @@ static void clear_snapshot_buffer(struct snapshot *snapshot)
 		free(snapshot->buf);
 	}
 	snapshot->buf = snapshot->start = snapshot->eof = NULL;
+
+	release_packed_refs_index(snapshot);
 }
 
 /*
@@ -274,6 +306,7 @@ static void packed_ref_store_release(struct ref_store *ref_store)
 	clear_snapshot(refs);
 	rollback_lock_file(&refs->lock);
 	delete_tempfile(&refs->tempfile);
+	delete_tempfile(&refs->index_tempfile);
 	free(refs->path);
 }
 
@@ -505,6 +538,284 @@ static void verify_buffer_safe(struct snapshot *snapshot)
 				 last_line, eof - last_line);
 }
 
+/*
+ * The `packed-refs.idx` file lists the offsets of all records in a
+ * sorted `packed-refs` file, so that looking up a reference only has
+ * to touch the pages of the records it compares against. It is laid
+ * out as follows, with all numbers in network byte order:
+ *
+ *   - 4-byte signature "PRIX"
+ *   - 4-byte version number (currently 1)
+ *   - 4-byte hash format id of the repository
+ *   - 4-byte number of records N
+ *   - 4-byte length of the header line of `packed-refs`
+ *   - 4-byte nanoseconds of the modification time of `packed-refs`
+ *   - 8-byte seconds of the modification time of `packed-refs`
+ *   - 8-byte size of `packed-refs`
+ *   - 8-byte inode number of `packed-refs`
+ *   - 256 4-byte fanout entries, where entry `i` is the number of
+ *     records whose bucket is at most `i` (see `index_bucket()`)
+ *   - N 4-byte offsets of the records, relative to the end of the
+ *     header line
+ *   - a checksum of all of the above
+ *
+ * The modification time, size and inode number identify the
+ * `packed-refs` file the index was written for. Versions of Git that
+ * do not know about the index rewrite `packed-refs` without updating
+ * it, in which case it no longer matches and is ignored.
+ */
+#define PACKED_REFS_INDEX_SIGNATURE 0x50524958 /* "PRIX" */
+#define PACKED_REFS_INDEX_VERSION 1
+#define PACKED_REFS_INDEX_HEADER_SIZE 48
+#define PACKED_REFS_INDEX_FANOUT_SIZE (256 * 4)
+
+/*
+ * Records are bucketed by the first character following "refs/",
+ * so that the fanout narrows down lookups to e.g. "refs/heads/" or
+ * "refs/tags/" right away. Names that do not start with "refs/" sort
+ * either before or after all of those and go into the first or last
+ * bucket, respectively.
+ */
+static unsigned char index_bucket(const char *refname)
+{
+	const char *rest;
+
+	if (skip_prefix(refname, "refs/", &rest) && *rest)
+		return *rest;
+	return strcmp(refname, "refs/") < 0 ? 0 : 255;
+}
+
+static char *packed_refs_index_path(struct packed_ref_store *refs)
+{
+	return xstrfmt("%s.idx", refs->path);
+}
+
+static void load_packed_refs_index(struct snapshot *snapshot,
+				   const struct stat *packed_st)
+{
+	const struct git_hash_algo *algop = snapshot->refs->base.repo->hash_algo;
+	char *path = packed_refs_index_path(snapshot->refs);
+	const unsigned char *map;
+	size_t map_size;
+	struct stat st;
+	uint32_t nr;
+	int fd;
+
+	fd = git_open(path);
+	free(path);
+	if (fd < 0)
+		return;
+	if (fstat(fd, &st) < 0 ||
+	    st.st_size < PACKED_REFS_INDEX_HEADER_SIZE + PACKED_REFS_INDEX_FANOUT_SIZE) {
+		close(fd);
+		return;
+	}
+
+	map_size = xsize_t(st.st_size);
+	map = xmmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	nr = get_be32(map + 12);
+	if (get_be32(map) != PACKED_REFS_INDEX_SIGNATURE ||
+	    get_be32(map + 4) != PACKED_REFS_INDEX_VERSION ||
+	    get_be32(map + 8) != algop->format_id ||
+	    get_be32(map + 16) != snapshot->start - snapshot->buf ||
+	    get_be32(map + 20) != ST_MTIME_NSEC(*packed_st) ||
+	    get_be64(map + 24) != (uint64_t)packed_st->st_mtime ||
+	    get_be64(map + 32) != (uint64_t)packed_st->st_size ||
+	    get_be64(map + 40) != (uint64_t)packed_st->st_ino ||
+	    map_size != PACKED_REFS_INDEX_HEADER_SIZE + PACKED_REFS_INDEX_FANOUT_SIZE +
+			(uint64_t)nr * 4 + algop->rawsz ||
+	    get_be32(map + PACKED_REFS_INDEX_HEADER_SIZE + 255 * 4) != nr ||
+	    !hashfile_checksum_valid(algop, map, map_size)) {
+		munmap((void *)map, map_size);
+		return;
+	}
+
+	snapshot->index_map = map;
+	snapshot->index_map_size = map_size;
+	snapshot->index_fanout = map + PACKED_REFS_INDEX_HEADER_SIZE;
+	snapshot->index_offsets = snapshot->index_fanout + PACKED_REFS_INDEX_FANOUT_SIZE;
+	snapshot->index_nr = nr;
+
+	trace2_data_intmax("packed-refs", snapshot->refs->base.repo,
+			   "index/records", nr);
+}
+
+/*
+ * Return the record at position `pos` of the index, or NULL if the
+ * offset stored there does not point at the start of a reference
+ * record (peeled "^" lines start a line too, but are not one). The
+ * stat data the index was validated with can match a different
+ * `packed-refs` file of the same size, e.g. on filesystems with coarse
+ * timestamps, so offsets must not be trusted blindly.
+ */
+static const char *index_record(struct snapshot *snapshot, uint32_t pos)
+{
+	uint32_t offset = get_be32(snapshot->index_offsets + 4 * pos);
+
+	if (offset + snapshot_hexsz(snapshot) + 2 > snapshot->eof - snapshot->start ||
+	    (offset && snapshot->start[offset - 1] != '\n') ||
+	    snapshot->start[offset] == '^')
+		return NULL;
+	return snapshot->start + offset;
+}
+
+/*
+ * Look up `refname` using the index, like find_reference_location()
+ * does, and store the result in `*result`. Return -1 if the index
+ * turns out not to match the `packed-refs` file, 0 otherwise.
+ */
+static int find_reference_location_index(struct snapshot *snapshot,
+					 const char *refname,
+					 int mustexist, int start,
+					 const char **result)
+{
+	uint32_t lo = 0, hi = snapshot->index_nr;
+	const char *rest;
+
+	if (skip_prefix(refname, "refs/", &rest) && *rest) {
+		unsigned char bucket = *rest;
+
+		lo = get_be32(snapshot->index_fanout + 4 * (bucket - 1));
+		hi = get_be32(snapshot->index_fanout + 4 * bucket);
+		if (lo > hi || hi > snapshot->index_nr)
+			die(_("corrupt packed-refs index for %s"),
+			    snapshot->refs->path);
+	}
+
+	while (lo < hi) {
+		uint32_t mid = lo + (hi - lo) / 2;
+		const char *rec = index_record(snapshot, mid);
+		int cmp;
+
+		if (!rec)
+			return -1;
+		cmp = cmp_record_to_refname(rec, refname, start, snapshot);
+		if (cmp < 0) {
+			lo = mid + 1;
+		} else if (cmp > 0) {
+			hi = mid;
+		} else {
+			*result = rec;
+			return 0;
+		}
+	}
+
+	if (mustexist) {
+		*result = NULL;
+	} else if (lo < snapshot->index_nr) {
+		*result = index_record(snapshot, lo);
+		if (!*result)
+			return -1;
+	} else {
+		*result = snapshot->eof;
+	}
+	return 0;
+}
+
+struct packed_refs_index_builder {
+	uint32_t *offsets;
+	size_t nr, alloc;
+	uint32_t fanout[256];
+	size_t header_len;
+	/* Offset of the next record relative to the end of the header line. */
+	size_t pos;
+};
+
+static void packed_refs_index_add(struct packed_refs_index_builder *builder,
+				  const char *refname, int peeled)
+{
+	size_t hexsz = the_hash_algo->hexsz;
+
+	ALLOC_GROW(builder->offsets, builder->nr + 1, builder->alloc);
+	builder->offsets[builder->nr++] = builder->pos;
+	builder->fanout[index_bucket(refname)]++;
+
+	builder->pos += hexsz + 1 + strlen(refname) + 1;
+	if (peeled)
+		builder->pos += 1 + hexsz + 1;
+}
+
+/*
+ * Write the index for the new `packed-refs` file that has just been
+ * written to `refs->tempfile` to `refs->index_tempfile`. It has to be
+ * moved into place before the `packed-refs` file itself.
+ */
+static int write_packed_refs_index(struct packed_ref_store *refs,
+				   struct packed_refs_index_builder *builder,
+				   struct strbuf *err)
+{
+	char *path = packed_refs_index_path(refs);
+	struct strbuf sb = STRBUF_INIT;
+	struct hashfile *f;
+	uint32_t count = 0;
+	struct stat st;
+	int ret = -1;
+
+	/*
+	 * Offsets are stored with 32 bits, so very large files can not be
+	 * indexed. Fall back to not having an index for them.
+	 */
+	if (builder->pos > UINT32_MAX) {
+		ret = 0;
+		goto out;
+	}
+
+	/*
+	 * Renaming the file into place keeps its inode number, size and
+	 * modification time, so we can record them already now.
+	 */
+	if (stat(get_tempfile_path(refs->tempfile), &st) < 0) {
+		strbuf_addf(err, "unable to stat %s: %s",
+			    get_tempfile_path(refs->tempfile), strerror(errno));
+		goto out;
+	}
+
+	strbuf_addf(&sb, "%s.new", path);
+	refs->index_tempfile = create_tempfile(sb.buf);
+	if (!refs->index_tempfile) {
+		strbuf_addf(err, "unable to create file %s: %s",
+			    sb.buf, strerror(errno));
+		goto out;
+	}
+
+	f = hashfd(the_hash_algo, get_tempfile_fd(refs->index_tempfile),
+		   get_tempfile_path(refs->index_tempfile));
+	hashwrite_be32(f, PACKED_REFS_INDEX_SIGNATURE);
+	hashwrite_be32(f, PACKED_REFS_INDEX_VERSION);
+	hashwrite_be32(f, the_hash_algo->format_id);
+	hashwrite_be32(f, builder->nr);
+	hashwrite_be32(f, builder->header_len);
+	hashwrite_be32(f, ST_MTIME_NSEC(st));
+	hashwrite_be64(f, st.st_mtime);
+	hashwrite_be64(f, st.st_size);
+	hashwrite_be64(f, st.st_ino);
+	for (size_t i = 0; i < ARRAY_SIZE(builder->fanout); i++) {
+		count += builder->fanout[i];
+		hashwrite_be32(f, count);
+	}
+	for (size_t i = 0; i < builder->nr; i++)
+		hashwrite_be32(f, builder->offsets[i]);
+	finalize_hashfile(f, NULL, FSYNC_COMPONENT_REFERENCE,
+			  CSUM_HASH_IN_STREAM | CSUM_FSYNC);
+
+	if (close_tempfile_gently(refs->index_tempfile)) {
+		strbuf_addf(err, "error closing file %s: %s",
+			    get_tempfile_path(refs->index_tempfile),
+			    strerror(errno));
+		delete_tempfile(&refs->index_tempfile);
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	strbuf_release(&sb);
+	free(path);
+	return ret;
+}
+
 /*
  * When parsing the "packed-refs" file, we will parse it line by line.
  * Because we know the start pointer of the refname and the next
@@ -550,13 +861,12 @@ static int allocate_snapshot_buffer(struct snapshot *snapshot, int fd, struct st
 
 /*
  * Depending on `mmap_strategy`, either mmap or read the contents of
- * the `packed-refs` file into the snapshot. Return 1 if the file
- * existed and was read, or 0 if the file was absent or empty. Die on
- * errors.
+ * the `packed-refs` file into the snapshot, and store its metadata in
+ * `st`. Return 1 if the file existed and was read, or 0 if the file
+ * was absent or empty. Die on errors.
  */
-static int load_contents(struct snapshot *snapshot)
+static int load_contents(struct snapshot *snapshot, struct stat *st)
 {
-	struct stat st;
 	int ret;
 	int fd;
 
@@ -578,10 +888,10 @@ static int load_contents(struct snapshot *snapshot)
 
 	stat_validity_update(&snapshot->validity, fd);
 
-	if (fstat(fd, &st) < 0)
+	if (fstat(fd, st) < 0)
 		die_errno("couldn't stat %s", snapshot->refs->path);
 
-	ret = allocate_snapshot_buffer(snapshot, fd, &st);
+	ret = allocate_snapshot_buffer(snapshot, fd, st);
 
 	close(fd);
 	return ret;
@@ -613,6 +923,18 @@ static const char *find_reference_location_1(struct snapshot *snapshot,
 	 */
 	const char *hi = snapshot->eof;
 
+	if (snapshot->index_nr) {
+		const char *rec;
+
+		if (!find_reference_location_index(snapshot, refname,
+						   mustexist, start, &rec))
+			return rec;
+
+		trace2_data_string("packed-refs", snapshot->refs->base.repo,
+				   "index/stale", snapshot->refs->path);
+		release_packed_refs_index(snapshot);
+	}
+
 	while (lo != hi) {
 		const char *mid, *rec;
 		int cmp;
@@ -706,13 +1028,14 @@ static const char *find_reference_location_end(struct snapshot *snapshot,
 static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 {
 	struct snapshot *snapshot = xcalloc(1, sizeof(*snapshot));
+	struct stat st;
 	int sorted = 0;
 
 	snapshot->refs = refs;
 	acquire_snapshot(snapshot);
 	snapshot->peeled = PEELED_NONE;
 
-	if (!load_contents(snapshot))
+	if (!load_contents(snapshot, &st))
 		return snapshot;
 
 	/* If the file has a header line, process it: */
@@ -777,6 +1100,13 @@ static struct snapshot *create_snapshot(struct packed_ref_store *refs)
 		clear_snapshot_buffer(snapshot);
 		snapshot->buf = snapshot->start = buf_copy;
 		snapshot->eof = buf_copy + size;
+	} else if (sorted && mmap_strategy != MMAP_TEMPORARY) {
+		/*
+		 * The index stays mmapped for as long as the snapshot
+		 * lives, which would prevent it from being replaced
+		 * where files cannot be renamed while mmapped.
+		 */
+		load_packed_refs_index(snapshot, &st);
 	}
 
 	return snapshot;
@@ -1336,13 +1666,19 @@ static int packed_ref_store_remove_on_disk(struct ref_store *ref_store,
 					   struct strbuf *err)
 {
 	struct packed_ref_store *refs = packed_downcast(ref_store, 0, "remove");
+	char *index_path = packed_refs_index_path(refs);
+	int ret = 0;
 
 	if (remove_path(refs->path) < 0) {
 		strbuf_addstr(err, "could not delete packed-refs");
-		return -1;
+		ret = -1;
+	} else if (unlink(index_path) < 0 && errno != ENOENT) {
+		strbuf_addstr(err, "could not delete packed-refs.idx");
+		ret = -1;
 	}
 
-	return 0;
+	free(index_path);
+	return ret;
 }
 
 /*
@@ -1362,6 +1698,8 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 	enum ref_transaction_error ret = REF_TRANSACTION_ERROR_GENERIC;
 	struct string_list *updates = &transaction->refnames;
 	struct ref_iterator *iter = NULL;
+	struct packed_refs_index_builder index = { 0 };
+	int write_index = 0;
 	size_t i;
 	int ok;
 	FILE *out;
@@ -1371,6 +1709,9 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 	if (!is_lock_file_locked(&refs->lock))
 		BUG("write_with_updates() called while unlocked");
 
+	repo_config_get_bool(refs->base.repo, "core.packedrefsindex", &write_index);
+	index.header_len = strlen(PACKED_REFS_HEADER);
+
 	/*
 	 * If packed-refs is a symlink, we want to overwrite the
 	 * symlinked-to file, not the symlink itself. Also, put the
@@ -1516,6 +1857,9 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 			if (write_packed_entry(out, iter->ref.name,
 					       iter->ref.oid, iter->ref.peeled_oid))
 				goto write_error;
+			if (write_index)
+				packed_refs_index_add(&index, iter->ref.name,
+						      !!iter->ref.peeled_oid);
 
 			if ((ok = ref_iterator_advance(iter)) != ITER_OK) {
 				ref_iterator_free(iter);
@@ -1537,6 +1881,8 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 					       &update->new_oid,
 					       peeled ? &update->peeled : NULL))
 				goto write_error;
+			if (write_index)
+				packed_refs_index_add(&index, update->refname, peeled);
 
 			i++;
 		}
@@ -1556,9 +1902,17 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 			    strerror(errno));
 		strbuf_release(&sb);
 		delete_tempfile(&refs->tempfile);
+		free(index.offsets);
+		return REF_TRANSACTION_ERROR_GENERIC;
+	}
+
+	if (write_index && write_packed_refs_index(refs, &index, err)) {
+		delete_tempfile(&refs->tempfile);
+		free(index.offsets);
 		return REF_TRANSACTION_ERROR_GENERIC;
 	}
 
+	free(index.offsets);
 	return 0;
 
 write_error:
@@ -1569,6 +1923,7 @@ static enum ref_transaction_error write_with_updates(struct packed_ref_store *re
 error:
 	ref_iterator_free(iter);
 	delete_tempfile(&refs->tempfile);
+	free(index.offsets);
 	return ret;
 }
 
@@ -1606,11 +1961,13 @@ int is_packed_transaction_needed(struct ref_store *ref_store,
 	 *    is identical to the current packed value of the
 	 *    reference.
 	 *
-	 * Neither of these cases will come up in the current code,
-	 * because the only caller of this function passes to it a
-	 * transaction that only includes `delete` updates with no
-	 * `old_id`. Even if that ever changes, false positives only
-	 * cause an optimization to be missed; they do not affect
+	 * The first case does not come up in the current code: the
+	 * only caller of this function passes to it a transaction
+	 * that includes `delete` updates with no `old_id` and, when
+	 * `core.packedRefsBatchSize` makes it write references to
+	 * `packed-refs` directly, updates setting new values without
+	 * an `old_id`. The second case could, but as false positives
+	 * only cause an optimization to be missed, they do not affect
 	 * correctness.
 	 */
 
@@ -1680,6 +2037,8 @@ static void packed_transaction_cleanup(struct packed_ref_store *refs,
 	if (data) {
 		if (is_tempfile_active(refs->tempfile))
 			delete_tempfile(&refs->tempfile);
+		if (is_tempfile_active(refs->index_tempfile))
+			delete_tempfile(&refs->index_tempfile);
 
 		if (data->own_lock && is_lock_file_locked(&refs->lock)) {
 			packed_refs_unlock(&refs->base);
@@ -1757,10 +2116,29 @@ static int packed_transaction_finish(struct ref_store *ref_store,
 			REF_STORE_READ | REF_STORE_WRITE | REF_STORE_ODB,
 			"ref_transaction_finish");
 	int ret = REF_TRANSACTION_ERROR_GENERIC;
-	char *packed_refs_path;
+	char *packed_refs_path, *index_path;
 
 	clear_snapshot(refs);
 
+	/*
+	 * The index has to be in place before the new `packed-refs`
+	 * file, as the latter is what readers validate it against.
+	 * Without a new index, remove the old one, which is stale now.
+	 */
+	index_path = packed_refs_index_path(refs);
+	if (refs->index_tempfile) {
+		if (rename_tempfile(&refs->index_tempfile, index_path)) {
+			strbuf_addf(err, "error replacing %s: %s",
+				    index_path, strerror(errno));
+			free(index_path);
+			packed_refs_path = NULL;
+			goto cleanup;
+		}
+	} else {
+		unlink_or_warn(index_path);
+	}
+	free(index_path);
+
 	packed_refs_path = get_locked_file_path(&refs->lock);
 	if (rename_tempfile(&refs->tempfile, packed_refs_path)) {
 		strbuf_addf(err, "error replacing %s: %s",
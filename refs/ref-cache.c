@@ -18,17 +18,42 @@ void add_entry_to_dir(struct ref_dir *dir, struct ref_entry *entry)
 		dir->sorted = dir->nr;
 }
 
+static void free_ref_entry(struct ref_entry *entry);
+
 struct ref_dir *get_ref_dir(struct ref_entry *entry)
 {
 	struct ref_dir *dir;
 	assert(entry->flag & REF_DIR);
 	dir = &entry->u.subdir;
 	if (entry->flag & REF_INCOMPLETE) {
+		struct ref_entry **probed = dir->entries;
+		int probed_nr = dir->nr;
+
 		if (!dir->cache->fill_ref_dir)
 			BUG("incomplete ref_store without fill_ref_dir function");
 
+		dir->entries = NULL;
+		dir->nr = dir->alloc = dir->sorted = 0;
 		dir->cache->fill_ref_dir(dir->cache->ref_store, dir, entry->name);
 		entry->flag &= ~REF_INCOMPLETE;
+
+		/*
+		 * Replace the stubs for subdirectories that have been
+		 * probed before with the probed entries, which may
+		 * have been read already.
+		 */
+		for (int i = 0; i < probed_nr; i++) {
+			struct ref_entry *sub = probed[i];
+			int pos = search_ref_dir(dir, sub->name, strlen(sub->name));
+
+			if (pos < 0) {
+				free_ref_entry(sub);
+			} else {
+				free_ref_entry(dir->entries[pos]);
+				dir->entries[pos] = sub;
+			}
+		}
+		free(probed);
 	}
 	return dir;
 }
@@ -150,48 +175,70 @@ int search_ref_dir(struct ref_dir *dir, const char *refname, size_t len)
 }
 
 /*
- * Search for a directory entry directly within dir (without
- * recursing).  Sort dir if necessary.  subdirname must be a directory
- * name (i.e., end in '/'). Returns NULL if the desired
- * directory cannot be found.  dir must already be complete.
+ * Return the index of the first entry in the sorted dir whose name,
+ * truncated to len bytes, does not sort before the first len bytes of
+ * refname, or dir->nr if there is none.
  */
-static struct ref_dir *search_for_subdir(struct ref_dir *dir,
-					 const char *subdirname, size_t len)
+static int ref_dir_lower_bound(struct ref_dir *dir, const char *refname,
+			       size_t len)
 {
-	int entry_index = search_ref_dir(dir, subdirname, len);
-	struct ref_entry *entry;
+	int lo = 0, hi = dir->nr;
 
-	if (entry_index == -1)
-		return NULL;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
 
-	entry = dir->entries[entry_index];
-	return get_ref_dir(entry);
+		if (strncmp(refname, dir->entries[mid]->name, len) > 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
 }
 
 /*
- * If refname is a reference name, find the ref_dir within the dir
- * tree that should hold refname. If refname is a directory name
- * (i.e., it ends in '/'), then return that ref_dir itself. dir must
- * represent the top-level directory and must already be complete.
- * Sort ref_dirs and recurse into subdirectories as necessary. Will
- * return NULL if the desired directory cannot be found.
+ * If refname is a reference name, find the directory entry within the
+ * tree below `entry` that should hold refname. If refname is a
+ * directory name (i.e., it ends in '/'), then return the entry of that
+ * directory itself. `entry` must represent the top-level directory.
+ * Will return NULL if the desired directory cannot be found.
+ *
+ * The returned directory has not necessarily been read. If the cache
+ * can probe for directories, neither have the directories on the way
+ * to it: only the subdirectory leading towards refname is looked up
+ * and added to them.
  */
-static struct ref_dir *find_containing_dir(struct ref_dir *dir,
-					   const char *refname)
+static struct ref_entry *find_containing_dir(struct ref_entry *entry,
+					     const char *refname)
 {
+	struct ref_cache *cache = entry->u.subdir.cache;
 	const char *slash;
+
 	for (slash = strchr(refname, '/'); slash; slash = strchr(slash + 1, '/')) {
 		size_t dirnamelen = slash - refname + 1;
-		struct ref_dir *subdir;
-		subdir = search_for_subdir(dir, refname, dirnamelen);
-		if (!subdir) {
-			dir = NULL;
-			break;
+		struct ref_dir *dir = &entry->u.subdir;
+		int pos;
+
+		if (!(entry->flag & REF_INCOMPLETE) || !cache->probe_ref_dir)
+			dir = get_ref_dir(entry);
+
+		pos = search_ref_dir(dir, refname, dirnamelen);
+		if (pos >= 0) {
+			entry = dir->entries[pos];
+		} else if (entry->flag & REF_INCOMPLETE) {
+			char *dirname = xmemdupz(refname, dirnamelen);
+			int exists = cache->probe_ref_dir(cache->ref_store, dirname);
+
+			free(dirname);
+			if (!exists)
+				return NULL;
+			entry = create_dir_entry(cache, refname, dirnamelen);
+			add_entry_to_dir(dir, entry);
+		} else {
+			return NULL;
 		}
-		dir = subdir;
 	}
 
-	return dir;
+	return entry;
 }
 
 /*
@@ -408,6 +455,15 @@ static int cache_ref_iterator_advance(struct ref_iterator *ref_iterator)
 
 		if (level->prefix_state == PREFIX_WITHIN_DIR) {
 			entry_prefix_state = overlaps_prefix(entry->name, iter->prefix);
+			if (entry_prefix_state == PREFIX_EXCLUDES_DIR &&
+			    strcmp(entry->name, iter->prefix) > 0) {
+				/*
+				 * This and all following entries sort
+				 * after anything the prefix matches.
+				 */
+				level->index = dir->nr - 1;
+				continue;
+			}
 			if (entry_prefix_state == PREFIX_EXCLUDES_DIR ||
 			    (entry_prefix_state == PREFIX_WITHIN_DIR && !(entry->flag & REF_DIR)))
 				continue;
@@ -439,16 +495,17 @@ static int cache_ref_iterator_set_prefix(struct cache_ref_iterator *iter,
 					 const char *prefix)
 {
 	struct cache_ref_iterator_level *level;
+	struct ref_entry *entry = iter->cache->root;
 	struct ref_dir *dir;
 
-	dir = get_ref_dir(iter->cache->root);
 	if (prefix && *prefix)
-		dir = find_containing_dir(dir, prefix);
-	if (!dir) {
+		entry = find_containing_dir(entry, prefix);
+	if (!entry) {
 		iter->levels_nr = 0;
 		return 0;
 	}
 
+	dir = get_ref_dir(entry);
 	if (iter->prime_dir)
 		prime_ref_dir(dir, prefix);
 	iter->levels_nr = 1;
@@ -460,6 +517,10 @@ static int cache_ref_iterator_set_prefix(struct cache_ref_iterator *iter,
 		free(iter->prefix);
 		iter->prefix = xstrdup(prefix);
 		level->prefix_state = PREFIX_WITHIN_DIR;
+
+		/* Skip the entries that sort before the prefix: */
+		sort_ref_dir(dir);
+		level->index = ref_dir_lower_bound(dir, prefix, strlen(prefix)) - 1;
 	} else {
 		FREE_AND_NULL(iter->prefix);
 		level->prefix_state = PREFIX_CONTAINS_DIR;
@@ -508,13 +569,10 @@ static int cache_ref_iterator_seek(struct ref_iterator *ref_iterator,
 			slash = strchr(slash, '/');
 			len = slash ? (size_t)(slash - refname) : strlen(refname);
 
-			for (idx = 0; idx < dir->nr; idx++) {
-				cmp = strncmp(refname, dir->entries[idx]->name, len);
-				if (cmp <= 0)
-					break;
-			}
+			idx = ref_dir_lower_bound(dir, refname, len);
 			/* don't overflow the index */
 			idx = idx >= dir->nr ? dir->nr - 1 : idx;
+			cmp = strncmp(refname, dir->entries[idx]->name, len);
 
 			if (slash)
 				slash = slash + 1;
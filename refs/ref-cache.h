@@ -15,6 +15,13 @@ struct repository;
 typedef void fill_ref_dir_fn(struct ref_store *ref_store,
 			     struct ref_dir *dir, const char *dirname);
 
+/*
+ * If this ref_cache is filled lazily, this function may be used to
+ * check whether the directory dirname (including a trailing slash)
+ * exists without reading its parent directory.
+ */
+typedef int probe_ref_dir_fn(struct ref_store *ref_store, const char *dirname);
+
 struct ref_cache {
 	struct ref_entry *root;
 
@@ -26,6 +33,14 @@ struct ref_cache {
 	 * NULL.
 	 */
 	fill_ref_dir_fn *fill_ref_dir;
+
+	/*
+	 * Function used (if set) to look up single subdirectories of
+	 * incomplete directories when iterating over a prefix, so
+	 * that e.g. iterating over "refs/pull/1234/" does not have to
+	 * read all of "refs/pull/". May be NULL.
+	 */
+	probe_ref_dir_fn *probe_ref_dir;
 };
 
 /*
@@ -70,6 +85,12 @@ struct ref_value {
  * in that directory are stored, and REF_INCOMPLETE stubs are created
  * for any subdirectories, but the subdirectories themselves are not
  * read.  The reading is triggered by get_ref_dir().
+ *
+ * An incomplete directory may already hold some REF_DIR entries,
+ * namely the subdirectories that were looked up individually via
+ * ref_cache::probe_ref_dir when iterating over a prefix. Those are
+ * kept (along with whatever has been read into them) when the
+ * directory is read in full.
  */
 struct ref_dir {
 	int nr, alloc;
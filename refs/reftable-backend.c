@@ -22,6 +22,7 @@
 #include "../reftable/reftable-record.h"
 #include "../reftable/reftable-stack.h"
 #include "../repo-settings.h"
+#include "../run-command.h"
 #include "../setup.h"
 #include "../strmap.h"
 #include "../trace2.h"
@@ -35,9 +36,28 @@
  */
 #define REF_UPDATE_VIA_HEAD (1 << 8)
 
+/*
+ * How the stacks are compacted after a write has made compaction necessary,
+ * as configured via "reftable.autoCompaction".
+ */
+enum reftable_auto_compaction {
+	/* Compact the stack before the write returns. */
+	REFTABLE_AUTO_COMPACTION_INLINE,
+	/* Spawn git-pack-refs(1) in the background to compact the stack. */
+	REFTABLE_AUTO_COMPACTION_DETACH,
+	/* Leave compaction to git-pack-refs(1) or git-maintenance(1). */
+	REFTABLE_AUTO_COMPACTION_NONE,
+};
+
 struct reftable_backend {
 	struct reftable_stack *stack;
 	struct reftable_iterator it;
+	struct repository *repo;
+	enum reftable_auto_compaction auto_compaction;
+	/* The GIT_DIR hosting the stack. */
+	char *gitdir;
+	/* The detached compaction, if one has been spawned. */
+	struct child_process compaction;
 };
 
 static void reftable_backend_on_reload(void *payload)
@@ -46,13 +66,96 @@ static void reftable_backend_on_reload(void *payload)
 	reftable_iterator_destroy(&be->it);
 }
 
+static int reftable_backend_compact(struct repository *repo,
+				    struct reftable_stack *stack,
+				    int auto_compact)
+{
+	struct reftable_compaction_stats before, *after;
+	int ret;
+
+	before = *reftable_stack_compaction_stats(stack);
+
+	trace2_region_enter("reftable", "compact", repo);
+	if (auto_compact)
+		ret = reftable_stack_auto_compact(stack);
+	else
+		ret = reftable_stack_compact_all(stack, NULL);
+	after = reftable_stack_compaction_stats(stack);
+	trace2_data_intmax("reftable", repo, "compact/bytes",
+			   after->bytes - before.bytes);
+	trace2_data_intmax("reftable", repo, "compact/entries",
+			   after->entries_written - before.entries_written);
+	trace2_data_intmax("reftable", repo, "compact/failures",
+			   after->failures - before.failures);
+	trace2_region_leave("reftable", "compact", repo);
+
+	return ret;
+}
+
+static int reftable_backend_on_compaction_required(struct reftable_stack *stack,
+						   void *payload)
+{
+	struct reftable_backend *be = payload;
+	struct child_process *cmd = &be->compaction;
+
+	if (be->auto_compaction != REFTABLE_AUTO_COMPACTION_DETACH)
+		return reftable_backend_compact(be->repo, stack, 1);
+
+	/*
+	 * Spawn at most one compaction at a time. While it is still running,
+	 * further writes leave the stack alone; the first write after it has
+	 * exited spawns the next one if the stack still needs compacting.
+	 */
+	if (cmd->pid > 0) {
+		if (!waitpid(cmd->pid, NULL, WNOHANG)) {
+			trace2_data_string("reftable", be->repo,
+					   "compact/detach", "running");
+			return 0;
+		}
+		child_process_clear(cmd);
+		child_process_init(cmd);
+	}
+
+	/*
+	 * Compacting the stack may take a while for large tables, so we hand
+	 * it off to a separate process that we do not wait for. Compaction
+	 * only locks the tables it rewrites and releases the lock on
+	 * "tables.list" while doing so, so concurrent writes, including our
+	 * own ones, can still land in the meantime.
+	 */
+	cmd->git_cmd = 1;
+	cmd->no_stdin = 1;
+	cmd->no_stdout = 1;
+	cmd->no_stderr = 1;
+	strvec_pushf(&cmd->args, "--git-dir=%s", be->gitdir);
+	strvec_pushl(&cmd->args, "pack-refs", "--auto", NULL);
+
+	if (start_command(cmd)) {
+		warning(_("unable to spawn background reftable compaction"));
+		child_process_init(cmd);
+	}
+
+	return 0;
+}
+
 static int reftable_backend_init(struct reftable_backend *be,
+				 struct repository *repo,
+				 enum reftable_auto_compaction auto_compaction,
 				 const char *path,
 				 const struct reftable_write_options *_opts)
 {
 	struct reftable_write_options opts = *_opts;
+	const char *gitdir_end = strrchr(path, '/');
+
+	be->repo = repo;
+	be->auto_compaction = auto_compaction;
+	be->gitdir = xstrndup(path, gitdir_end ? gitdir_end - path : 0);
+	child_process_init(&be->compaction);
+
 	opts.on_reload = reftable_backend_on_reload;
 	opts.on_reload_payload = be;
+	opts.on_compaction_required = reftable_backend_on_compaction_required;
+	opts.on_compaction_required_payload = be;
 	return reftable_new_stack(&be->stack, path, &opts);
 }
 
@@ -61,6 +164,9 @@ static void reftable_backend_release(struct reftable_backend *be)
 	reftable_stack_destroy(be->stack);
 	be->stack = NULL;
 	reftable_iterator_destroy(&be->it);
+	FREE_AND_NULL(be->gitdir);
+	/* A detached compaction is not waited for. */
+	child_process_clear(&be->compaction);
 }
 
 static int reftable_backend_read_ref(struct reftable_backend *be,
@@ -141,9 +247,12 @@ struct reftable_ref_store {
 	 */
 	struct strmap worktree_backends;
 	struct reftable_write_options write_options;
+	enum reftable_auto_compaction auto_compaction;
 
 	unsigned int store_flags;
 	enum log_refs_config log_all_ref_updates;
+	/* Whether to warn that "reftable.logCompression=0" is ignored. */
+	unsigned warn_log_compression : 1;
 	int err;
 };
 
@@ -169,6 +278,12 @@ static struct reftable_ref_store *reftable_be_downcast(struct ref_store *ref_sto
 		BUG("operation %s requires abilities 0x%x, but only have 0x%x",
 		    caller, required_flags, refs->store_flags);
 
+	if ((required_flags & REF_STORE_WRITE) && refs->warn_log_compression) {
+		warning(_("ignoring reftable.logCompression=0 without "
+			  "extensions.reftableUncompressedLogs"));
+		refs->warn_log_compression = 0;
+	}
+
 	return refs;
 }
 
@@ -189,7 +304,9 @@ static int backend_for_worktree(struct reftable_backend **out,
 		    store->base.repo->commondir, worktree_name);
 
 	CALLOC_ARRAY(*out, 1);
-	store->err = ret = reftable_backend_init(*out, worktree_dir.buf,
+	store->err = ret = reftable_backend_init(*out, store->base.repo,
+						 store->auto_compaction,
+						 worktree_dir.buf,
 						 &store->write_options);
 	if (ret < 0) {
 		free(*out);
@@ -332,9 +449,10 @@ static void fill_reftable_log_record(struct reftable_log_record *log, const stru
 
 static int reftable_be_config(const char *var, const char *value,
 			      const struct config_context *ctx,
-			      void *_opts)
+			      void *payload)
 {
-	struct reftable_write_options *opts = _opts;
+	struct reftable_ref_store *refs = payload;
+	struct reftable_write_options *opts = &refs->write_options;
 
 	if (!strcmp(var, "reftable.blocksize")) {
 		unsigned long block_size = git_config_ulong(var, value, ctx->kvi);
@@ -360,6 +478,26 @@ static int reftable_be_config(const char *var, const char *value,
 		if (lock_timeout < 0 && lock_timeout != -1)
 			die("reftable lock timeout does not support negative values other than -1");
 		opts->lock_timeout_ms = lock_timeout;
+	} else if (!strcmp(var, "reftable.blockcachesize")) {
+		opts->block_cache_size = git_config_ulong(var, value, ctx->kvi);
+	} else if (!strcmp(var, "reftable.logcompression")) {
+		int level = git_config_int(var, value, ctx->kvi);
+		if (level == -1)
+			level = 0;
+		else if (level == 0)
+			level = REFTABLE_LOG_UNCOMPRESSED;
+		else if (level < 0 || level > Z_BEST_COMPRESSION)
+			die(_("bad zlib compression level %d"), level);
+		opts->log_compression_level = level;
+	} else if (!strcmp(var, "reftable.autocompaction")) {
+		int b = git_parse_maybe_bool(value);
+		if (b >= 0)
+			refs->auto_compaction = b ? REFTABLE_AUTO_COMPACTION_INLINE :
+						    REFTABLE_AUTO_COMPACTION_NONE;
+		else if (!strcmp(value, "detach"))
+			refs->auto_compaction = REFTABLE_AUTO_COMPACTION_DETACH;
+		else
+			die(_("invalid value for '%s': '%s'"), var, value);
 	}
 
 	return 0;
@@ -399,11 +537,27 @@ static struct ref_store *reftable_be_init(struct repository *repo,
 		BUG("unknown hash algorithm %d", repo->hash_algo->format_id);
 	}
 	refs->write_options.default_permissions = calc_shared_perm(repo, 0666 & ~mask);
-	refs->write_options.disable_auto_compact =
-		!git_env_bool("GIT_TEST_REFTABLE_AUTOCOMPACTION", 1);
 	refs->write_options.lock_timeout_ms = 100;
+	refs->write_options.block_cache_size = 4 * 1024 * 1024;
+
+	repo_config(repo, reftable_be_config, refs);
+
+	/*
+	 * Uncompressed log blocks need reftable format version 3, which older
+	 * readers cannot parse. Only write them when the repository has the
+	 * extension that makes those readers refuse the repository up front,
+	 * and compress them as usual otherwise. We only warn about that once
+	 * we are about to write, as readers are not affected.
+	 */
+	if (refs->write_options.log_compression_level == REFTABLE_LOG_UNCOMPRESSED &&
+	    !repo->repository_format_reftable_uncompressed_logs) {
+		refs->write_options.log_compression_level = 0;
+		refs->warn_log_compression = 1;
+	}
 
-	repo_config(repo, reftable_be_config, &refs->write_options);
+	refs->write_options.disable_auto_compact =
+		refs->auto_compaction == REFTABLE_AUTO_COMPACTION_NONE ||
+		!git_env_bool("GIT_TEST_REFTABLE_AUTOCOMPACTION", 1);
 
 	/*
 	 * It is somewhat unfortunate that we have to mirror the default block
@@ -425,7 +579,8 @@ static struct ref_store *reftable_be_init(struct repository *repo,
 		strbuf_realpath(&path, ref_common_dir.buf, 0);
 	}
 	strbuf_addstr(&path, "/reftable");
-	refs->err = reftable_backend_init(&refs->main_backend, path.buf,
+	refs->err = reftable_backend_init(&refs->main_backend, repo,
+					  refs->auto_compaction, path.buf,
 					  &refs->write_options);
 	if (refs->err)
 		goto done;
@@ -441,7 +596,8 @@ static struct ref_store *reftable_be_init(struct repository *repo,
 	if (is_worktree) {
 		strbuf_addstr(&refdir, "/reftable");
 
-		refs->err = reftable_backend_init(&refs->worktree_backend, refdir.buf,
+		refs->err = reftable_backend_init(&refs->worktree_backend, repo,
+						  refs->auto_compaction, refdir.buf,
 						  &refs->write_options);
 		if (refs->err)
 			goto done;
@@ -1668,10 +1824,8 @@ static int reftable_be_optimize(struct ref_store *ref_store,
 	if (!stack)
 		stack = refs->main_backend.stack;
 
-	if (opts->flags & REFS_OPTIMIZE_AUTO)
-		ret = reftable_stack_auto_compact(stack);
-	else
-		ret = reftable_stack_compact_all(stack, NULL);
+	ret = reftable_backend_compact(refs->base.repo, stack,
+				       opts->flags & REFS_OPTIMIZE_AUTO);
 	if (ret < 0) {
 		ret = error(_("unable to compact stack: %s"),
 			    reftable_error_str(ret));
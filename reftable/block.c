@@ -8,6 +8,7 @@
 
 #include "block.h"
 
+#include "blockcache.h"
 #include "blocksource.h"
 #include "constants.h"
 #include "iter.h"
@@ -21,6 +22,7 @@ size_t header_size(int version)
 	case 1:
 		return 24;
 	case 2:
+	case 3:
 		return 28;
 	}
 	abort();
@@ -32,6 +34,7 @@ size_t footer_size(int version)
 	case 1:
 		return 68;
 	case 2:
+	case 3:
 		return 72;
 	}
 	abort();
@@ -80,15 +83,10 @@ int block_writer_init(struct block_writer *bw, uint8_t typ, uint8_t *block,
 	bw->block[header_off] = typ;
 	bw->next = header_off + 4;
 	bw->restart_interval = 16;
+	bw->compression_level = Z_BEST_COMPRESSION;
 	bw->entries = 0;
 	bw->restart_len = 0;
 	bw->last_key.len = 0;
-	if (!bw->zstream) {
-		REFTABLE_CALLOC_ARRAY(bw->zstream, 1);
-		if (!bw->zstream)
-			return REFTABLE_OUT_OF_MEMORY_ERROR;
-		deflateInit(bw->zstream, 9);
-	}
 
 	return 0;
 }
@@ -158,14 +156,28 @@ int block_writer_finish(struct block_writer *w)
 	reftable_put_be24(w->block + 1 + w->header_off, w->next);
 
 	/*
-	 * Log records are stored zlib-compressed. Note that the compression
-	 * also spans over the restart points we have just written.
+	 * Log records are stored zlib-compressed unless asked otherwise. Note
+	 * that the compression also spans over the restart points we have just
+	 * written.
 	 */
-	if (block_writer_type(w) == REFTABLE_BLOCK_TYPE_LOG) {
+	if (block_writer_type(w) == REFTABLE_BLOCK_TYPE_LOG &&
+	    w->compression_level != Z_NO_COMPRESSION) {
 		int block_header_skip = 4 + w->header_off;
 		uLongf src_len = w->next - block_header_skip, compressed_len;
 		int ret;
 
+		/*
+		 * The stream is set up lazily so that callers can adjust the
+		 * compression level after having initialized the writer.
+		 */
+		if (!w->zstream) {
+			REFTABLE_CALLOC_ARRAY(w->zstream, 1);
+			if (!w->zstream)
+				return REFTABLE_OUT_OF_MEMORY_ERROR;
+			if (deflateInit(w->zstream, w->compression_level) != Z_OK)
+				return REFTABLE_ZLIB_ERROR;
+		}
+
 		ret = deflateReset(w->zstream);
 		if (ret != Z_OK)
 			return REFTABLE_ZLIB_ERROR;
@@ -229,10 +241,23 @@ int reftable_block_init(struct reftable_block *block,
 			uint32_t offset, uint32_t header_size,
 			uint32_t table_block_size, uint32_t hash_size,
 			uint8_t want_type)
+{
+	return block_init_cached(block, source, offset, header_size,
+				 table_block_size, hash_size, want_type, 1,
+				 NULL, 0);
+}
+
+int block_init_cached(struct reftable_block *block,
+		      struct reftable_block_source *source,
+		      uint32_t offset, uint32_t header_size,
+		      uint32_t table_block_size, uint32_t hash_size,
+		      uint8_t want_type, int compressed_logs,
+		      struct reftable_block_cache *cache, uint64_t cache_id)
 {
 	uint32_t guess_block_size = table_block_size ?
 		table_block_size : DEFAULT_BLOCK_SIZE;
 	uint32_t full_block_size = table_block_size;
+	const struct block_cache_entry *cached = NULL;
 	uint16_t restart_count;
 	uint32_t restart_off;
 	uint32_t block_size;
@@ -254,13 +279,23 @@ int reftable_block_init(struct reftable_block *block,
 	}
 
 	block_size = reftable_get_be24(block->block_data.data + header_size + 1);
-	if (block_size > guess_block_size) {
+	if (block_type == REFTABLE_BLOCK_TYPE_LOG && compressed_logs && cache)
+		cached = block_cache_get(cache, cache_id, offset);
+	if (cached && cached->len != block_size) {
+		err = REFTABLE_FORMAT_ERROR;
+		goto done;
+	}
+
+	if (block_size > guess_block_size && !cached) {
 		err = read_block(source, &block->block_data, offset, block_size);
 		if (err < 0)
 			goto done;
 	}
 
-	if (block_type == REFTABLE_BLOCK_TYPE_LOG) {
+	if (block_type == REFTABLE_BLOCK_TYPE_LOG && !compressed_logs) {
+		/* Uncompressed log blocks are never padded. */
+		full_block_size = block_size;
+	} else if (block_type == REFTABLE_BLOCK_TYPE_LOG) {
 		uint32_t block_header_skip = 4 + header_size;
 		uLong dst_len = block_size - block_header_skip;
 		uLong src_len = block->block_data.len - block_header_skip;
@@ -273,6 +308,16 @@ int reftable_block_init(struct reftable_block *block,
 			goto done;
 		}
 
+		if (cached) {
+			/* Copying is a lot cheaper than inflating the block again. */
+			memcpy(block->uncompressed_data, cached->data, block_size);
+			block_source_release_data(&block->block_data);
+			block->block_data.data = block->uncompressed_data;
+			block->block_data.len = block_size;
+			full_block_size = cached->full_block_size;
+			goto parse_restarts;
+		}
+
 		/* Copy over the block header verbatim. It's not compressed. */
 		memcpy(block->uncompressed_data, block->block_data.data, block_header_skip);
 
@@ -321,6 +366,14 @@ int reftable_block_init(struct reftable_block *block,
 		block->block_data.data = block->uncompressed_data;
 		block->block_data.len = block_size;
 		full_block_size = src_len + block_header_skip - block->zstream->avail_in;
+
+		if (cache) {
+			err = block_cache_put(cache, cache_id, offset,
+					      block->uncompressed_data, block_size,
+					      full_block_size);
+			if (err < 0)
+				goto done;
+		}
 	} else if (full_block_size == 0) {
 		full_block_size = block_size;
 	} else if (block_size < full_block_size && block_size < block->block_data.len &&
@@ -331,6 +384,7 @@ int reftable_block_init(struct reftable_block *block,
 		full_block_size = block_size;
 	}
 
+parse_restarts:
 	restart_count = reftable_get_be16(block->block_data.data + block_size - 2);
 	restart_off = block_size - 2 - 3 * restart_count;
 
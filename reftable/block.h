@@ -31,6 +31,8 @@ struct block_writer {
 
 	/* How often to restart keys. */
 	uint16_t restart_interval;
+	/* zlib compression level for log blocks, 0 to store them uncompressed. */
+	int compression_level;
 	uint32_t hash_size;
 
 	/* Offset of next uint8_t to write. */
@@ -106,6 +108,21 @@ void block_iter_reset(struct block_iter *it);
 /* deallocate memory for `it`. The block reader and its block is left intact. */
 void block_iter_close(struct block_iter *it);
 
+struct reftable_block_cache;
+
+/*
+ * Like `reftable_block_init()`, but serve log blocks from the given cache if
+ * it is non-NULL, and add the ones that had to be inflated to it. The blocks
+ * of a table are keyed with `cache_id`. Log blocks are only inflated if
+ * `compressed_logs` is set, as tables of version 3 store them uncompressed.
+ */
+int block_init_cached(struct reftable_block *block,
+		      struct reftable_block_source *source,
+		      uint32_t offset, uint32_t header_size,
+		      uint32_t table_block_size, uint32_t hash_size,
+		      uint8_t want_type, int compressed_logs,
+		      struct reftable_block_cache *cache, uint64_t cache_id);
+
 /* size of file header, depending on format version */
 size_t header_size(int version);
 
@@ -0,0 +1,215 @@
+#include "blockcache.h"
+
+#include "basics.h"
+#include "reftable-error.h"
+
+struct reftable_block_cache {
+	size_t max_bytes;
+	size_t bytes;
+	uint64_t refcount;
+	uint64_t next_table_id;
+
+	/* Chained hash table; the number of buckets is a power of two. */
+	struct block_cache_entry **buckets;
+	size_t buckets_nr;
+	size_t entries_nr;
+
+	/* Most recently used entry first. */
+	struct block_cache_entry *lru_head, *lru_tail;
+
+	struct reftable_block_cache_stats stats;
+};
+
+static size_t bucket_of(const struct reftable_block_cache *cache,
+			uint64_t table_id, uint64_t offset)
+{
+	uint64_t h = (table_id * 0x9e3779b97f4a7c15ULL) ^ offset;
+	h ^= h >> 29;
+	return (size_t)h & (cache->buckets_nr - 1);
+}
+
+int block_cache_new(struct reftable_block_cache **out, size_t max_bytes)
+{
+	struct reftable_block_cache *cache;
+
+	REFTABLE_CALLOC_ARRAY(cache, 1);
+	if (!cache)
+		return REFTABLE_OUT_OF_MEMORY_ERROR;
+	cache->buckets_nr = 64;
+	REFTABLE_CALLOC_ARRAY(cache->buckets, cache->buckets_nr);
+	if (!cache->buckets) {
+		reftable_free(cache);
+		return REFTABLE_OUT_OF_MEMORY_ERROR;
+	}
+	cache->max_bytes = max_bytes;
+	cache->refcount = 1;
+
+	*out = cache;
+	return 0;
+}
+
+static void lru_unlink(struct reftable_block_cache *cache,
+		       struct block_cache_entry *e)
+{
+	if (e->lru_prev)
+		e->lru_prev->lru_next = e->lru_next;
+	else
+		cache->lru_head = e->lru_next;
+	if (e->lru_next)
+		e->lru_next->lru_prev = e->lru_prev;
+	else
+		cache->lru_tail = e->lru_prev;
+	e->lru_prev = e->lru_next = NULL;
+}
+
+static void lru_push_front(struct reftable_block_cache *cache,
+			   struct block_cache_entry *e)
+{
+	e->lru_prev = NULL;
+	e->lru_next = cache->lru_head;
+	if (cache->lru_head)
+		cache->lru_head->lru_prev = e;
+	else
+		cache->lru_tail = e;
+	cache->lru_head = e;
+}
+
+static void evict(struct reftable_block_cache *cache,
+		  struct block_cache_entry *e)
+{
+	struct block_cache_entry **pp = &cache->buckets[bucket_of(cache, e->table_id,
+								  e->offset)];
+
+	while (*pp != e)
+		pp = &(*pp)->hash_next;
+	*pp = e->hash_next;
+
+	lru_unlink(cache, e);
+	cache->bytes -= e->len;
+	cache->entries_nr--;
+	reftable_free(e->data);
+	reftable_free(e);
+}
+
+void block_cache_incref(struct reftable_block_cache *cache)
+{
+	cache->refcount++;
+}
+
+void block_cache_decref(struct reftable_block_cache *cache)
+{
+	if (!cache)
+		return;
+	if (--cache->refcount)
+		return;
+	while (cache->lru_head)
+		evict(cache, cache->lru_head);
+	reftable_free(cache->buckets);
+	reftable_free(cache);
+}
+
+uint64_t block_cache_table_id(struct reftable_block_cache *cache)
+{
+	return ++cache->next_table_id;
+}
+
+const struct block_cache_entry *block_cache_get(struct reftable_block_cache *cache,
+						uint64_t table_id,
+						uint64_t offset)
+{
+	struct block_cache_entry *e;
+
+	for (e = cache->buckets[bucket_of(cache, table_id, offset)]; e; e = e->hash_next) {
+		if (e->table_id != table_id || e->offset != offset)
+			continue;
+		if (cache->lru_head != e) {
+			lru_unlink(cache, e);
+			lru_push_front(cache, e);
+		}
+		cache->stats.hits++;
+		return e;
+	}
+
+	cache->stats.misses++;
+	return NULL;
+}
+
+static int grow_buckets(struct reftable_block_cache *cache)
+{
+	struct block_cache_entry **old = cache->buckets;
+	size_t old_nr = cache->buckets_nr;
+
+	REFTABLE_CALLOC_ARRAY(cache->buckets, 2 * old_nr);
+	if (!cache->buckets) {
+		cache->buckets = old;
+		return REFTABLE_OUT_OF_MEMORY_ERROR;
+	}
+	cache->buckets_nr = 2 * old_nr;
+
+	for (size_t i = 0; i < old_nr; i++) {
+		struct block_cache_entry *e = old[i], *next;
+
+		for (; e; e = next) {
+			size_t b = bucket_of(cache, e->table_id, e->offset);
+
+			next = e->hash_next;
+			e->hash_next = cache->buckets[b];
+			cache->buckets[b] = e;
+		}
+	}
+
+	reftable_free(old);
+	return 0;
+}
+
+int block_cache_put(struct reftable_block_cache *cache,
+		    uint64_t table_id, uint64_t offset,
+		    const unsigned char *data, uint32_t len,
+		    uint32_t full_block_size)
+{
+	struct block_cache_entry *e;
+	size_t b;
+
+	if (len > cache->max_bytes)
+		return 0;
+
+	while (cache->bytes + len > cache->max_bytes) {
+		evict(cache, cache->lru_tail);
+		cache->stats.evictions++;
+	}
+
+	if (cache->entries_nr >= cache->buckets_nr) {
+		int err = grow_buckets(cache);
+		if (err < 0)
+			return err;
+	}
+
+	REFTABLE_CALLOC_ARRAY(e, 1);
+	if (!e)
+		return REFTABLE_OUT_OF_MEMORY_ERROR;
+	REFTABLE_ALLOC_ARRAY(e->data, len);
+	if (!e->data) {
+		reftable_free(e);
+		return REFTABLE_OUT_OF_MEMORY_ERROR;
+	}
+	memcpy(e->data, data, len);
+	e->len = len;
+	e->table_id = table_id;
+	e->offset = offset;
+	e->full_block_size = full_block_size;
+
+	b = bucket_of(cache, table_id, offset);
+	e->hash_next = cache->buckets[b];
+	cache->buckets[b] = e;
+	lru_push_front(cache, e);
+	cache->bytes += len;
+	cache->entries_nr++;
+
+	return 0;
+}
+
+const struct reftable_block_cache_stats *
+block_cache_stats(struct reftable_block_cache *cache)
+{
+	return &cache->stats;
+}
@@ -0,0 +1,68 @@
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "system.h"
+#include "reftable-stack.h"
+
+/*
+ * A cache of inflated log blocks. It is owned by a stack and shared by its
+ * tables, so that reading the same log block again, e.g. when looking up the
+ * reflogs of many refs that share it, does not require inflating it again.
+ * Entries are keyed by the table they belong to and their offset in it, and
+ * are evicted in least-recently-used order once the cache grows beyond its
+ * size limit.
+ *
+ * The cache is reference counted, as tables may outlive their stack.
+ */
+struct reftable_block_cache;
+
+struct block_cache_entry {
+	uint64_t table_id;
+	uint64_t offset;
+
+	/* The inflated block, including its header. */
+	unsigned char *data;
+	uint32_t len;
+
+	/* Size of the compressed block in the file. */
+	uint32_t full_block_size;
+
+	struct block_cache_entry *hash_next;
+	struct block_cache_entry *lru_prev, *lru_next;
+};
+
+/* Create a cache that holds at most `max_bytes` of block data. */
+int block_cache_new(struct reftable_block_cache **out, size_t max_bytes);
+
+void block_cache_incref(struct reftable_block_cache *cache);
+void block_cache_decref(struct reftable_block_cache *cache);
+
+/*
+ * Return a new identifier to key the blocks of a table with. Identifiers are
+ * never reused, so that blocks of a closed table cannot be confused with those
+ * of a new one.
+ */
+uint64_t block_cache_table_id(struct reftable_block_cache *cache);
+
+/*
+ * Look up a block and mark it as the most recently used one. The returned
+ * entry is valid until the next call to `block_cache_put()`.
+ */
+const struct block_cache_entry *block_cache_get(struct reftable_block_cache *cache,
+						uint64_t table_id,
+						uint64_t offset);
+
+/*
+ * Add a copy of the given inflated block to the cache, evicting the least
+ * recently used blocks as needed. Blocks that are larger than the cache are
+ * not added.
+ */
+int block_cache_put(struct reftable_block_cache *cache,
+		    uint64_t table_id, uint64_t offset,
+		    const unsigned char *data, uint32_t len,
+		    uint32_t full_block_size);
+
+const struct reftable_block_cache_stats *
+block_cache_stats(struct reftable_block_cache *cache);
+
+#endif
@@ -164,6 +164,20 @@ struct reftable_compaction_stats {
 struct reftable_compaction_stats *
 reftable_stack_compaction_stats(struct reftable_stack *st);
 
+/* statistics on the cache of inflated log blocks. */
+struct reftable_block_cache_stats {
+	uint64_t hits; /* blocks that were served from the cache */
+	uint64_t misses; /* blocks that had to be inflated */
+	uint64_t evictions; /* blocks dropped to make room for others */
+};
+
+/*
+ * return statistics for the log block cache up till now. All of them are
+ * zero if the stack has no cache, see `block_cache_size`.
+ */
+const struct reftable_block_cache_stats *
+reftable_stack_block_cache_stats(struct reftable_stack *st);
+
 /* Return the hash of the stack. */
 enum reftable_hash reftable_stack_hash_id(struct reftable_stack *st);
 
@@ -14,6 +14,8 @@
 #include "reftable-block.h"
 #include "reftable-blocksource.h"
 
+struct reftable_block_cache;
+
 /*
  * Reading single tables
  *
@@ -52,6 +54,14 @@ struct reftable_table {
 	struct reftable_table_offsets obj_offsets;
 	struct reftable_table_offsets log_offsets;
 
+	/*
+	 * Cache of inflated log blocks shared with the other tables of the
+	 * stack, if any, and the identifier this table's blocks are cached
+	 * under.
+	 */
+	struct reftable_block_cache *block_cache;
+	uint64_t block_cache_id;
+
 	uint64_t refcount;
 };
 
@@ -14,6 +14,11 @@
 
 /* Writing single reftables */
 
+/* See `reftable_write_options.log_compression_level`. */
+#define REFTABLE_LOG_UNCOMPRESSED (-1)
+
+struct reftable_stack;
+
 /* reftable_write_options sets options for writing a single reftable. */
 struct reftable_write_options {
 	/* boolean: do not pad out blocks to block size. */
@@ -41,6 +46,15 @@ struct reftable_write_options {
 	 */
 	unsigned exact_log_message : 1;
 
+	/*
+	 * zlib compression level used for log blocks, from 1 (fastest) to 9
+	 * (smallest). Defaults to 9 if unset. Pass `REFTABLE_LOG_UNCOMPRESSED`
+	 * to store log blocks without compressing them, which makes reading
+	 * them a lot cheaper at the cost of larger tables. This requires
+	 * format version 3, which older readers refuse to read.
+	 */
+	int log_compression_level;
+
 	/* boolean: Prevent auto-compaction of tables. */
 	unsigned disable_auto_compact : 1;
 
@@ -61,6 +75,13 @@ struct reftable_write_options {
 	 */
 	long lock_timeout_ms;
 
+	/*
+	 * The maximum number of bytes of inflated log blocks that a stack
+	 * keeps in memory, so that reading them again does not require
+	 * inflating them again. Passing 0 disables the cache.
+	 */
+	size_t block_cache_size;
+
 	/*
 	 * Callback function to execute whenever the stack is being reloaded.
 	 * This can be used e.g. to discard cached information that relies on
@@ -69,6 +90,18 @@ struct reftable_write_options {
 	 */
 	void (*on_reload)(void *payload);
 	void *on_reload_payload;
+
+	/*
+	 * Callback function to execute instead of auto-compacting the stack
+	 * when a committed addition has made compaction necessary. This can be
+	 * used e.g. to defer compaction to a separate process so that writers
+	 * do not have to wait for it. The callback may also compact the stack
+	 * itself via `reftable_stack_auto_compact()`. Errors it returns are
+	 * handled like those of auto-compaction. Has no effect when
+	 * auto-compaction is disabled.
+	 */
+	int (*on_compaction_required)(struct reftable_stack *st, void *payload);
+	void *on_compaction_required_payload;
 };
 
 /* reftable_block_stats holds statistics for a single block type */
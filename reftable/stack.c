@@ -9,6 +9,7 @@
 #include "stack.h"
 
 #include "system.h"
+#include "blockcache.h"
 #include "constants.h"
 #include "merged.h"
 #include "reftable-error.h"
@@ -206,6 +207,7 @@ void reftable_stack_destroy(struct reftable_stack *st)
 		st->list_fd = -1;
 	}
 
+	block_cache_decref(st->block_cache);
 	REFTABLE_FREE_AND_NULL(st->list_file);
 	REFTABLE_FREE_AND_NULL(st->reftable_dir);
 	reftable_free(st);
@@ -303,6 +305,9 @@ static int reftable_stack_reload_once(struct reftable_stack *st,
 			err = reftable_table_new(&table, &src, name);
 			if (err < 0)
 				goto done;
+
+			if (st->block_cache)
+				table_set_block_cache(table, st->block_cache);
 		}
 
 		new_tables[new_tables_len] = table;
@@ -535,6 +540,12 @@ int reftable_new_stack(struct reftable_stack **dest, const char *dir,
 		goto out;
 	}
 
+	if (opts.block_cache_size) {
+		err = block_cache_new(&p->block_cache, opts.block_cache_size);
+		if (err < 0)
+			goto out;
+	}
+
 	err = reftable_stack_reload_maybe_reuse(p, 1);
 	if (err < 0)
 		goto out;
@@ -811,6 +822,8 @@ int reftable_addition_commit(struct reftable_addition *add)
 		goto done;
 
 	if (!add->stack->opts.disable_auto_compact) {
+		struct reftable_write_options *opts = &add->stack->opts;
+
 		/*
 		 * Auto-compact the stack to keep the number of tables in
 		 * control. It is possible that a concurrent writer is already
@@ -820,7 +833,17 @@ int reftable_addition_commit(struct reftable_addition *add)
 		 * concurrent writer, which causes `REFTABLE_OUTDATED_ERROR`.
 		 * Both of these errors are benign, so we simply ignore them.
 		 */
-		err = reftable_stack_auto_compact(add->stack);
+		if (opts->on_compaction_required) {
+			bool required;
+
+			err = reftable_stack_compaction_required(add->stack, true,
+								 &required);
+			if (!err && required)
+				err = opts->on_compaction_required(add->stack,
+								   opts->on_compaction_required_payload);
+		} else {
+			err = reftable_stack_auto_compact(add->stack);
+		}
 		if (err < 0 && err != REFTABLE_LOCK_ERROR &&
 		    err != REFTABLE_OUTDATED_ERROR)
 			goto done;
@@ -1603,7 +1626,8 @@ struct segment suggest_compaction_segment(uint64_t *sizes, size_t n,
 static int stack_segments_for_compaction(struct reftable_stack *st,
 					 struct segment *seg)
 {
-	int version = (st->opts.hash_id == REFTABLE_HASH_SHA1) ? 1 : 2;
+	int version = (st->opts.hash_id == REFTABLE_HASH_SHA1 &&
+		       st->opts.log_compression_level != REFTABLE_LOG_UNCOMPRESSED) ? 1 : 2;
 	int overhead = header_size(version) - 1;
 	uint64_t *sizes;
 
@@ -1678,6 +1702,16 @@ reftable_stack_compaction_stats(struct reftable_stack *st)
 	return &st->stats;
 }
 
+const struct reftable_block_cache_stats *
+reftable_stack_block_cache_stats(struct reftable_stack *st)
+{
+	static const struct reftable_block_cache_stats no_cache;
+
+	if (!st->block_cache)
+		return &no_cache;
+	return block_cache_stats(st->block_cache);
+}
+
 int reftable_stack_read_ref(struct reftable_stack *st, const char *refname,
 			    struct reftable_ref_record *ref)
 {
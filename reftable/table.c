@@ -10,6 +10,7 @@
 
 #include "system.h"
 #include "block.h"
+#include "blockcache.h"
 #include "blocksource.h"
 #include "constants.h"
 #include "iter.h"
@@ -172,13 +173,23 @@ int table_init_block(struct reftable_table *t, struct reftable_block *block,
 	if (next_off >= t->size)
 		return 1;
 
-	err = reftable_block_init(block, &t->source, next_off, header_off,
-				  t->block_size, hash_size(t->hash_id), want_typ);
+	err = block_init_cached(block, &t->source, next_off, header_off,
+				t->block_size, hash_size(t->hash_id), want_typ,
+				t->version < 3, t->block_cache, t->block_cache_id);
 	if (err)
 		reftable_block_release(block);
 	return err;
 }
 
+void table_set_block_cache(struct reftable_table *t,
+			   struct reftable_block_cache *cache)
+{
+	block_cache_incref(cache);
+	block_cache_decref(t->block_cache);
+	t->block_cache = cache;
+	t->block_cache_id = block_cache_table_id(cache);
+}
+
 static void table_iter_close(struct table_iter *ti)
 {
 	table_iter_block_done(ti);
@@ -555,7 +566,7 @@ int reftable_table_new(struct reftable_table **out,
 		goto done;
 	}
 	t->version = header.data[4];
-	if (t->version != 1 && t->version != 2) {
+	if (t->version < 1 || t->version > 3) {
 		err = REFTABLE_FORMAT_ERROR;
 		goto done;
 	}
@@ -607,6 +618,7 @@ void reftable_table_decref(struct reftable_table *t)
 	if (--t->refcount)
 		return;
 	block_source_close(&t->source);
+	block_cache_decref(t->block_cache);
 	REFTABLE_FREE_AND_NULL(t->name);
 	reftable_free(t);
 }
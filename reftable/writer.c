@@ -86,10 +86,15 @@ static void options_set_defaults(struct reftable_write_options *opts)
 	if (opts->block_size == 0) {
 		opts->block_size = DEFAULT_BLOCK_SIZE;
 	}
+	if (opts->log_compression_level == 0) {
+		opts->log_compression_level = Z_BEST_COMPRESSION;
+	}
 }
 
 static int writer_version(struct reftable_writer *w)
 {
+	if (w->opts.log_compression_level == REFTABLE_LOG_UNCOMPRESSED)
+		return 3;
 	return (w->opts.hash_id == 0 || w->opts.hash_id == REFTABLE_HASH_SHA1) ?
 			     1 :
 			     2;
@@ -104,7 +109,7 @@ static int writer_write_header(struct reftable_writer *w, uint8_t *dest)
 	reftable_put_be24(dest + 5, w->opts.block_size);
 	reftable_put_be64(dest + 8, w->min_update_index);
 	reftable_put_be64(dest + 16, w->max_update_index);
-	if (writer_version(w) == 2) {
+	if (writer_version(w) >= 2) {
 		uint32_t hash_id;
 
 		switch (w->opts.hash_id) {
@@ -140,6 +145,9 @@ static int writer_reinit_block_writer(struct reftable_writer *w, uint8_t typ)
 
 	w->block_writer = &w->block_writer_data;
 	w->block_writer->restart_interval = w->opts.restart_interval;
+	w->block_writer->compression_level =
+		w->opts.log_compression_level == REFTABLE_LOG_UNCOMPRESSED ?
+		Z_NO_COMPRESSION : w->opts.log_compression_level;
 
 	return 0;
 }
@@ -152,15 +160,18 @@ int reftable_writer_new(struct reftable_writer **out,
 	struct reftable_write_options opts = {0};
 	struct reftable_writer *wp;
 
-	wp = reftable_calloc(1, sizeof(*wp));
-	if (!wp)
-		return REFTABLE_OUT_OF_MEMORY_ERROR;
-
 	if (_opts)
 		opts = *_opts;
 	options_set_defaults(&opts);
 	if (opts.block_size >= (1 << 24))
 		return REFTABLE_API_ERROR;
+	if (opts.log_compression_level != REFTABLE_LOG_UNCOMPRESSED &&
+	    (opts.log_compression_level < 1 || opts.log_compression_level > 9))
+		return REFTABLE_API_ERROR;
+
+	wp = reftable_calloc(1, sizeof(*wp));
+	if (!wp)
+		return REFTABLE_OUT_OF_MEMORY_ERROR;
 
 	reftable_buf_init(&wp->block_writer_data.last_key);
 	reftable_buf_init(&wp->last_key);
@@ -14,6 +14,7 @@ enum fetch_negotiation_setting {
 	FETCH_NEGOTIATION_CONSECUTIVE,
 	FETCH_NEGOTIATION_SKIPPING,
 	FETCH_NEGOTIATION_NOOP,
+	FETCH_NEGOTIATION_SUMMARY,
 };
 
 enum log_refs_config {
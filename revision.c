@@ -652,6 +652,8 @@ static int forbid_bloom_filters(struct pathspec *spec)
 		PATHSPEC_MAXDEPTH |
 		PATHSPEC_LITERAL |
 		PATHSPEC_GLOB |
+		PATHSPEC_ICASE |
+		PATHSPEC_EXCLUDE |
 		PATHSPEC_ATTR;
 
 	if (spec->magic & ~allowed_magic)
@@ -675,6 +677,13 @@ static int convert_pathspec_to_bloom_keyvec(struct bloom_keyvec **out,
 	int res = -1;
 
 	len = pi->nowildcard_len;
+	/*
+	 * Only the part of a case-insensitive pathspec that came from
+	 * the prefix is matched case-sensitively, and the keys in the
+	 * filter are computed from the exact path.
+	 */
+	if ((pi->magic & PATHSPEC_ICASE) && len > pi->prefix)
+		len = pi->prefix;
 	if (len != pi->len) {
 		/*
 		 * for path like "dir/file*", nowildcard part would be
@@ -722,15 +731,27 @@ static void prepare_to_use_bloom_filter(struct rev_info *revs)
 	if (!revs->pruning.pathspec.nr)
 		return;
 
-	revs->bloom_keyvecs_nr = revs->pruning.pathspec.nr;
-	CALLOC_ARRAY(revs->bloom_keyvecs, revs->bloom_keyvecs_nr);
+	release_revisions_bloom_keyvecs(revs);
+	CALLOC_ARRAY(revs->bloom_keyvecs, revs->pruning.pathspec.nr);
 
+	/*
+	 * A commit that touches none of the paths a pathspec includes
+	 * is TREESAME no matter what it excludes, so excluded paths
+	 * need no keys. If all items are excluded, the pathspec got an
+	 * implicit match-all item, which we cannot look up.
+	 */
 	for (int i = 0; i < revs->pruning.pathspec.nr; i++) {
-		if (convert_pathspec_to_bloom_keyvec(&revs->bloom_keyvecs[i],
-						     &revs->pruning.pathspec.items[i],
-						     revs->bloom_filter_settings))
+		const struct pathspec_item *pi = &revs->pruning.pathspec.items[i];
+
+		if (pi->magic & PATHSPEC_EXCLUDE)
+			continue;
+		if (convert_pathspec_to_bloom_keyvec(&revs->bloom_keyvecs[revs->bloom_keyvecs_nr],
+						     pi, revs->bloom_filter_settings))
 			goto fail;
+		revs->bloom_keyvecs_nr++;
 	}
+	if (!revs->bloom_keyvecs_nr)
+		goto fail;
 
 	if (trace2_is_enabled() && !bloom_filter_atexit_registered) {
 		atexit(trace2_bloom_filter_statistics_atexit);
@@ -3738,8 +3759,18 @@ static void explore_walk_step(struct rev_info *revs)
 	if (c->object.flags & UNINTERESTING)
 		mark_parents_uninteresting(revs, c);
 
-	for (p = c->parents; p; p = p->next)
+	/*
+	 * Only explore the parents that process_parents() would walk:
+	 * side branches that the walk never shows cannot affect the
+	 * flags of the commits that it does show.
+	 */
+	for (p = c->parents; p; p = p->next) {
 		test_flag_and_insert(&info->explore_queue, p->item, TOPO_WALK_EXPLORED);
+
+		if (c->object.flags & UNINTERESTING ?
+		    revs->exclude_first_parent_only : revs->first_parent_only)
+			break;
+	}
 }
 
 static void explore_to_depth(struct rev_info *revs,
@@ -187,9 +187,13 @@ void protocol_v2_advertise_capabilities(struct repository *r)
 {
 	struct strbuf capability = STRBUF_INIT;
 	struct strbuf value = STRBUF_INIT;
+	struct packet_writer writer;
+
+	packet_writer_init(&writer, 1);
+	writer.buffered = 1;
 
 	/* serve by default supports v2 */
-	packet_write_fmt(1, "version 2\n");
+	packet_writer_write(&writer, "version 2\n");
 
 	for (size_t i = 0; i < ARRAY_SIZE(capabilities); i++) {
 		struct protocol_capability *c = &capabilities[i];
@@ -203,14 +207,15 @@ void protocol_v2_advertise_capabilities(struct repository *r)
 			}
 
 			strbuf_addch(&capability, '\n');
-			packet_write(1, capability.buf, capability.len);
+			packet_writer_write(&writer, "%s", capability.buf);
 		}
 
 		strbuf_reset(&capability);
 		strbuf_reset(&value);
 	}
 
-	packet_flush(1);
+	packet_writer_flush(&writer);
+	packet_writer_release(&writer);
 	strbuf_release(&capability);
 	strbuf_release(&value);
 }
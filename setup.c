@@ -713,6 +713,9 @@ static enum extension_result handle_extension(const char *var,
 	} else if (!strcmp(ext, "submodulepathconfig")) {
 		data->submodule_path_cfg = git_config_bool(var, value);
 		return EXTENSION_OK;
+	} else if (!strcmp(ext, "reftableuncompressedlogs")) {
+		data->reftable_uncompressed_logs = git_config_bool(var, value);
+		return EXTENSION_OK;
 	}
 	return EXTENSION_UNKNOWN;
 }
@@ -1788,6 +1791,8 @@ static void check_repository_format(struct repository *repo, struct repository_f
 		fmt->submodule_path_cfg;
 	repo->repository_format_relative_worktrees =
 		fmt->relative_worktrees;
+	repo->repository_format_reftable_uncompressed_logs =
+		fmt->reftable_uncompressed_logs;
 	repo->repository_format_partial_clone =
 		xstrdup_or_null(fmt->partial_clone);
 	clear_repository_format(&repo_fmt);
@@ -2038,6 +2043,8 @@ const char *setup_git_directory_gently(struct repository *repo, int *nongit_ok)
 				repo_fmt.relative_worktrees;
 			repo->repository_format_submodule_path_cfg =
 				repo_fmt.submodule_path_cfg;
+			repo->repository_format_reftable_uncompressed_logs =
+				repo_fmt.reftable_uncompressed_logs;
 			/* take ownership of repo_fmt.partial_clone */
 			repo->repository_format_partial_clone =
 				repo_fmt.partial_clone;
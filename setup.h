@@ -186,6 +186,7 @@ struct repository_format {
 	int worktree_config;
 	int relative_worktrees;
 	int submodule_path_cfg;
+	int reftable_uncompressed_logs;
 	int is_bare;
 	int hash_algo;
 	int compat_hash_algo;
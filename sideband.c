@@ -4,6 +4,7 @@
 #include "git-compat-util.h"
 #include "color.h"
 #include "config.h"
+#include "copy.h"
 #include "editor.h"
 #include "gettext.h"
 #include "sideband.h"
@@ -460,3 +461,31 @@ void send_sideband(int fd, int band, const char *data, ssize_t sz, int packet_ma
 		sz -= n;
 	}
 }
+
+int send_sideband_from_fd(int fd, int band, int in_fd, off_t offset,
+			  size_t sz, int packet_max)
+{
+	while (sz) {
+		unsigned n;
+		char hdr[5];
+		int ret;
+
+		n = sz;
+		if (packet_max - 5 < n)
+			n = packet_max - 5;
+		if (0 <= band) {
+			xsnprintf(hdr, sizeof(hdr), "%04x", n + 5);
+			hdr[4] = band;
+			write_or_die(fd, hdr, 5);
+		} else {
+			xsnprintf(hdr, sizeof(hdr), "%04x", n + 4);
+			write_or_die(fd, hdr, 4);
+		}
+		ret = copy_fd_range(in_fd, offset, fd, n);
+		if (ret < 0)
+			return ret;
+		offset += n;
+		sz -= n;
+	}
+	return 0;
+}
@@ -30,6 +30,14 @@ int demultiplex_sideband(const char *me, int status,
 
 void send_sideband(int fd, int band, const char *data, ssize_t sz, int packet_max);
 
+/*
+ * Like send_sideband(), but send "sz" bytes found at "offset" in the
+ * regular file "in_fd". Only the packet headers are written from
+ * userspace; see copy_fd_range(), whose error codes are returned.
+ */
+int send_sideband_from_fd(int fd, int band, int in_fd, off_t offset,
+			  size_t sz, int packet_max);
+
 /*
  * Apply sideband configuration for the given URL. This should be called
  * when a transport is created to allow URL-specific configuration of
@@ -8,13 +8,87 @@
  * published by the Free Software Foundation.
  */
 
+#define USE_THE_REPOSITORY_VARIABLE
+
 #include "test-tool.h"
 #include "git-compat-util.h"
 #include "delta.h"
+#include "hex.h"
+#include "odb.h"
+#include "setup.h"
 #include "strbuf.h"
 
 static const char usage_str[] =
-	"test-tool delta (-d|-p) <from_file> <data_file> <out_file>";
+	"test-tool delta (-d|-p) <from_file> <data_file> <out_file>\n"
+	"   or: test-tool delta --bench < <pairs>";
+
+static void *read_blob(const struct object_id *oid, unsigned long *size)
+{
+	enum object_type type;
+	void *buf = odb_read_object(the_repository->objects, oid, &type, size);
+
+	if (!buf)
+		die("unable to read %s", oid_to_hex(oid));
+	if (type != OBJ_BLOB)
+		die("%s is not a blob", oid_to_hex(oid));
+	return buf;
+}
+
+/*
+ * Read "<from> <to>" pairs of blob ids from stdin, compute the delta
+ * between each pair and check that it reproduces <to>. Print the number
+ * of pairs, the total size of the <to> blobs, and the total size of the
+ * deltas, so that both the speed and the quality of the delta encoder
+ * can be compared across versions.
+ */
+static int bench_delta(void)
+{
+	struct strbuf line = STRBUF_INIT;
+	uintmax_t pairs = 0, data_total = 0, delta_total = 0;
+
+	setup_git_directory(the_repository);
+
+	while (strbuf_getline(&line, stdin) != EOF) {
+		struct object_id from_oid, data_oid;
+		const char *p;
+		void *from, *data, *delta, *result;
+		unsigned long from_size, data_size, delta_size = 0, result_size;
+
+		if (parse_oid_hex(line.buf, &from_oid, &p) || *p++ != ' ' ||
+		    parse_oid_hex(p, &data_oid, &p) || *p)
+			die("malformed input line: '%s'", line.buf);
+
+		from = read_blob(&from_oid, &from_size);
+		data = read_blob(&data_oid, &data_size);
+
+		delta = diff_delta(from, from_size, data, data_size,
+				   &delta_size, 0);
+		if (delta) {
+			result = patch_delta(from, from_size, delta, delta_size,
+					     &result_size);
+			if (!result || result_size != data_size ||
+			    memcmp(result, data, data_size))
+				die("delta from %s to %s does not apply",
+				    oid_to_hex(&from_oid), oid_to_hex(&data_oid));
+			free(result);
+		}
+
+		pairs++;
+		data_total += data_size;
+		delta_total += delta_size;
+
+		free(delta);
+		free(from);
+		free(data);
+	}
+
+	printf("pairs %"PRIuMAX"\n", pairs);
+	printf("data %"PRIuMAX"\n", data_total);
+	printf("delta %"PRIuMAX"\n", delta_total);
+
+	strbuf_release(&line);
+	return 0;
+}
 
 int cmd__delta(int argc, const char **argv)
 {
@@ -23,6 +97,9 @@ int cmd__delta(int argc, const char **argv)
 	char *out_buf;
 	unsigned long out_size;
 
+	if (argc == 2 && !strcmp(argv[1], "--bench"))
+		return bench_delta();
+
 	if (argc != 5 || (strcmp(argv[1], "-d") && strcmp(argv[1], "-p")))
 		usage(usage_str);
 
@@ -91,6 +91,8 @@ int cmd__path_walk(int argc, const char **argv)
 			 N_("read a pattern list over stdin")),
 		OPT_BOOL(0, "pl-sparse-trees", &pl_sparse_trees,
 			 N_("toggle pruning of trees by sparse patterns")),
+		OPT_INTEGER(0, "threads", &info.threads,
+			    N_("number of threads reading trees")),
 		OPT_PARSE_LIST_OBJECTS_FILTER(&filter_options),
 		OPT_END(),
 	};
@@ -159,6 +159,41 @@ static int send_split_sideband(void)
 	return 0;
 }
 
+static void write_bench(int argc, const char **argv)
+{
+	struct packet_writer writer;
+	int buffered = 0, size = 64;
+	char *line;
+	const char *const write_bench_usage[] = {
+		"test-tool pkt-line write-bench [--buffered] [--size=<n>] <count>",
+		NULL
+	};
+	struct option cmd_options[] = {
+		OPT_BOOL(0, "buffered", &buffered,
+			 "batch the packets before writing them (Default: off)"),
+		OPT_INTEGER(0, "size", &size,
+			    "payload size of each packet (Default: 64)"),
+		OPT_END()
+	};
+
+	argc = parse_options(argc, argv, "", cmd_options, write_bench_usage, 0);
+	if (argc != 1 || size < 1 || size > LARGE_PACKET_DATA_MAX)
+		usage_with_options(write_bench_usage, cmd_options);
+
+	line = xmallocz(size);
+	memset(line, 'x', size - 1);
+	line[size - 1] = '\n';
+
+	packet_writer_init(&writer, 1);
+	writer.buffered = buffered;
+	for (int i = strtol(argv[0], NULL, 10); i > 0; i--)
+		packet_writer_write(&writer, "%s", line);
+	packet_writer_flush(&writer);
+
+	packet_writer_release(&writer);
+	free(line);
+}
+
 static int receive_sideband(void)
 {
 	return recv_sideband("sideband", 0, 1);
@@ -181,6 +216,8 @@ int cmd__pkt_line(int argc, const char **argv)
 		send_split_sideband();
 	else if (!strcmp(argv[1], "receive-sideband"))
 		receive_sideband();
+	else if (!strcmp(argv[1], "write-bench"))
+		write_bench(argc - 1, argv + 1);
 	else
 		die("invalid argument '%s'", argv[1]);
 
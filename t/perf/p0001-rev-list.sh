@@ -18,6 +18,10 @@ test_perf 'rev-list --parents' '
 	git rev-list --parents HEAD >/dev/null
 '
 
+test_perf 'rev-list --first-parent --topo-order' '
+	git rev-list --first-parent --topo-order HEAD >/dev/null
+'
+
 test_expect_success 'create dummy file' '
 	echo unlikely-to-already-be-there >dummy &&
 	git add dummy &&
@@ -0,0 +1,25 @@
+#!/bin/sh
+
+test_description='Tests pkt-line write performance'
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+for size in 64 1000 65000
+do
+	for mode in '' '--buffered '
+	do
+		test_perf "write 100000 packets of $size bytes, $mode" "
+			test-tool pkt-line write-bench $mode--size=$size 100000 | cat >/dev/null
+		"
+	done
+done
+
+test_perf 'serve capability advertisement' '
+	for i in $(test_seq 1000)
+	do
+		GIT_PROTOCOL=version=2 git upload-pack --advertise-refs . || return 1
+	done >/dev/null
+'
+
+test_done
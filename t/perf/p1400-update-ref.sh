@@ -14,7 +14,15 @@ test_expect_success "setup" '
 		printf "start\ncreate refs/heads/%d PRE\ncommit\n" $i &&
 		printf "start\nupdate refs/heads/%d POST PRE\ncommit\n" $i &&
 		printf "start\ndelete refs/heads/%d POST\ncommit\n" $i || return 1
-	done >instructions
+	done >instructions &&
+	for i in $(test_seq 5000)
+	do
+		printf "create refs/heads/batch/%d PRE\n" $i || return 1
+	done >create-batch &&
+	for i in $(test_seq 5000)
+	do
+		printf "delete refs/heads/batch/%d PRE\n" $i || return 1
+	done >delete-batch
 '
 
 test_perf "update-ref" '
@@ -30,4 +38,14 @@ test_perf "update-ref --stdin" '
 	git update-ref --stdin <instructions >/dev/null
 '
 
+for cfg in "core.fsyncMethod=fsync" "core.fsyncMethod=batch" \
+	"core.packedRefsBatchSize=1000"
+do
+	test_perf "update-ref --stdin, single transaction ($cfg)" '
+		GIT_TEST_FSYNC=1 git -c core.fsync=reference -c $cfg \
+			update-ref --stdin <create-batch &&
+		git update-ref --stdin <delete-batch
+	'
+done
+
 test_done
@@ -0,0 +1,36 @@
+#!/bin/sh
+
+test_description="Tests performance of reading reflogs with reftables"
+
+. ./perf-lib.sh
+
+test_perf_fresh_repo
+
+test_expect_success "setup" '
+	git init --ref-format=reftable reflogs &&
+	test_commit -C reflogs PRE &&
+	test_commit -C reflogs POST &&
+	for i in $(test_seq 2000)
+	do
+		printf "start\ncreate refs/heads/%d PRE\ncommit\n" $i &&
+		printf "start\nupdate refs/heads/%d POST PRE\ncommit\n" $i &&
+		echo "refs/heads/$i@{1}" >>revs || return 1
+	done >instructions &&
+	git -C reflogs update-ref --stdin <instructions >/dev/null &&
+	git -C reflogs pack-refs --all
+'
+
+for size in 0 4m
+do
+	test_perf "rev-parse @{1} of many refs (reftable.blockCacheSize=$size)" "
+		git -C reflogs -c reftable.blockCacheSize=$size \
+			rev-parse \$(cat revs) >/dev/null
+	"
+
+	test_perf "reflog expire --all (reftable.blockCacheSize=$size)" "
+		git -C reflogs -c reftable.blockCacheSize=$size \
+			reflog expire --all --dry-run
+	"
+done
+
+test_done
@@ -35,6 +35,11 @@ test_expect_success 'setup' '
 	commit=$(git commit-tree $(git rev-parse HEAD^{tree})) &&
 	git update-ref refs/heads/disjoint-base $commit &&
 
+	git rev-list -n 5000 HEAD >many-commits &&
+	awk "{ print \"create refs/many/\" NR \" \" \$1 }" many-commits |
+		git update-ref --stdin &&
+	git for-each-ref --format="%(refname)" refs/many/ >many-refs &&
+
 	git commit-graph write --reachable
 '
 
@@ -42,6 +47,15 @@ test_perf 'ahead-behind counts: git for-each-ref' '
 	git for-each-ref --format="%(ahead-behind:HEAD)" --stdin <refs
 '
 
+test_perf 'ahead-behind counts: git for-each-ref (many refs, 1 thread)' '
+	GIT_TEST_AHEAD_BEHIND_THREADS=1 \
+		git for-each-ref --format="%(ahead-behind:HEAD)" --stdin <many-refs
+'
+
+test_perf 'ahead-behind counts: git for-each-ref (many refs)' '
+	git for-each-ref --format="%(ahead-behind:HEAD)" --stdin <many-refs
+'
+
 test_perf 'ahead-behind counts: git branch' '
 	xargs git branch -l --format="%(ahead-behind:HEAD)" <branches
 '
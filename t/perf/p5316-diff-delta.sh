@@ -0,0 +1,21 @@
+#!/bin/sh
+
+test_description='Tests speed and size of deltas between blob revisions'
+. ./perf-lib.sh
+
+test_perf_default_repo
+
+test_expect_success 'collect modified blob pairs' '
+	git log --raw --no-abbrev --format= -n 2000 HEAD |
+	awk "\$1 == \":100644\" && \$5 == \"M\" { print \$3, \$4; }" >pairs
+'
+
+test_perf 'delta modified blobs' '
+	test-tool delta --bench <pairs >bench
+'
+
+test_size 'size of deltas' '
+	sed -n "s/^delta //p" bench
+'
+
+test_done
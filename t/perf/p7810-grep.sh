@@ -20,4 +20,12 @@ test_perf 'grep --cached, expensive regex' '
 	git grep --cached "^.* *some_nonexistent_string$" || :
 '
 
+test_expect_success 'find recent revisions' '
+	git rev-list -n 100 HEAD >revs
+'
+
+test_perf 'grep 100 revisions, cheap regex' '
+	git grep some_nonexistent_string $(cat revs) || :
+'
+
 test_done
@@ -0,0 +1,29 @@
+#!/bin/sh
+
+test_description="git-grep performance with literal patterns
+
+Case-sensitive literal patterns are searched for without going through
+the regex engine. Compare them against the same patterns with -i,
+which still use the regex engine, across worktree and --cached
+greps.
+"
+
+. ./perf-lib.sh
+
+test_perf_large_repo
+test_checkout_worktree
+
+for pattern in 'int' 'uncommon' 'some_nonexistent_string'
+do
+	for mode in '' ' --cached'
+	do
+		test_perf "grep$mode -F $pattern" "
+			git grep$mode -F $pattern >/dev/null || :
+		"
+		test_perf "grep$mode -F -i $pattern" "
+			git grep$mode -F -i $pattern >/dev/null || :
+		"
+	done
+done
+
+test_done
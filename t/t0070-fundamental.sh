@@ -106,4 +106,15 @@ test_expect_success 'unpack-sideband: packet_reader_read() consumes sideband, ch
 	test_cmp expect-err err
 '
 
+test_expect_success 'buffered packet writer produces the same packets' '
+	test-tool pkt-line write-bench --size=3000 50 >unbuffered &&
+	test-tool pkt-line write-bench --buffered --size=3000 50 >buffered &&
+	test_cmp unbuffered buffered &&
+	test-tool pkt-line unpack <buffered >out &&
+	test_line_count = 51 out &&
+	tail -n 1 out >flush &&
+	echo 0000 >expect &&
+	test_cmp expect flush
+'
+
 test_done
@@ -519,4 +519,130 @@ test_expect_success 'symref transaction supports false symlink config' '
 	test_cmp expect actual
 '
 
+test_expect_success 'iterating over prefixes of a loose ref directory' '
+	test_when_finished "rm -rf .git/refs/lazy" &&
+	for i in 1 2 3 30 4
+	do
+		git update-ref refs/lazy/$i/head $C || return 1
+	done &&
+	git update-ref refs/lazy/3a $D &&
+	# Only listings that cover it report the broken name.
+	echo "$C" >.git/refs/lazy/bad..name &&
+
+	git for-each-ref --format="%(refname)" refs/lazy/2/ >actual 2>err &&
+	echo refs/lazy/2/head >expect &&
+	test_cmp expect actual &&
+	test_must_be_empty err &&
+
+	git for-each-ref --format="%(refname)" refs/lazy/5/ >actual 2>err &&
+	test_must_be_empty actual &&
+	test_must_be_empty err &&
+
+	# Probed directories are kept when their parent is read in full.
+	git for-each-ref --format="%(refname)" \
+		refs/lazy/1/ refs/lazy/2/ "refs/lazy/3*" >actual 2>err &&
+	cat >expect <<-\EOF &&
+	refs/lazy/1/head
+	refs/lazy/2/head
+	refs/lazy/3a
+	EOF
+	test_cmp expect actual &&
+
+	git for-each-ref --format="%(refname)" refs/lazy/ >actual 2>err &&
+	cat >expect <<-\EOF &&
+	refs/lazy/1/head
+	refs/lazy/2/head
+	refs/lazy/3/head
+	refs/lazy/30/head
+	refs/lazy/3a
+	refs/lazy/4/head
+	EOF
+	test_cmp expect actual &&
+	test_grep "broken name refs/lazy/bad..name" err
+'
+
+check_fsync_events () {
+	local trace="$1" &&
+	shift &&
+
+	cat >expect &&
+	sed -n \
+		-e '/^{"event":"counter",.*"category":"fsync",/ {
+			s/.*"category":"fsync",//;
+			s/}$//;
+			p;
+		}' \
+		<"$trace" >actual &&
+	test_cmp expect actual
+}
+
+test_expect_success 'ref transaction: batch fsync flushes once' '
+	test_when_finished "rm -rf repo trace2.txt" &&
+	git init repo &&
+	test_commit -C repo initial &&
+	cat >input <<-\EOF &&
+	create refs/heads/one HEAD
+	create refs/heads/two HEAD
+	create refs/heads/three HEAD
+	EOF
+
+	GIT_TRACE2_EVENT="$(pwd)/trace2.txt" \
+	GIT_TEST_FSYNC=true \
+		git -C repo -c core.fsync=reference \
+		-c core.fsyncMethod=batch update-ref --stdin <input &&
+	check_fsync_events trace2.txt <<-\EOF &&
+	"name":"writeout-only","count":3
+	"name":"hardware-flush","count":1
+	EOF
+	git -C repo rev-parse initial >expect &&
+	for ref in one two three
+	do
+		git -C repo rev-parse $ref >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'large transactions are written to packed-refs' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	(
+		cd repo &&
+		git config core.logAllRefUpdates true &&
+		test_commit A &&
+		test_commit B &&
+		git tag -a -m tag annotated A &&
+		git update-ref refs/heads/loose A &&
+		git rev-parse A >A &&
+		git rev-parse B >B &&
+		git rev-parse annotated >annotated &&
+
+		cat >input <<-EOF &&
+		create refs/heads/new $(cat A)
+		update refs/heads/loose $(cat B) $(cat A)
+		create refs/tags/new-tag $(cat annotated)
+		EOF
+		git -c core.packedRefsBatchSize=3 update-ref -m batch --stdin <input &&
+
+		test_path_is_missing .git/refs/heads/new &&
+		test_path_is_missing .git/refs/heads/loose &&
+		test_path_is_missing .git/refs/tags/new-tag &&
+		git for-each-ref --format="%(refname) %(objectname)" \
+			refs/heads/new refs/heads/loose refs/tags/new-tag >actual &&
+		cat >expect <<-EOF &&
+		refs/heads/loose $(cat B)
+		refs/heads/new $(cat A)
+		refs/tags/new-tag $(cat annotated)
+		EOF
+		test_cmp expect actual &&
+		grep -x "\\^$(cat A)" .git/packed-refs &&
+		git reflog show --format="%gs" refs/heads/loose -1 >actual &&
+		echo batch >expect &&
+		test_cmp expect actual &&
+
+		# Smaller transactions still write loose refs.
+		git -c core.packedRefsBatchSize=3 update-ref refs/heads/small A &&
+		test_path_is_file .git/refs/heads/small
+	)
+'
+
 test_done
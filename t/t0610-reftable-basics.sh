@@ -355,6 +355,70 @@ test_expect_success 'ref transaction: env var disables compaction' '
 	test_line_count -lt $expected repo/.git/reftable/tables.list
 '
 
+test_expect_success 'ref transaction: config disables auto-compaction' '
+	test_when_finished "rm -rf repo" &&
+
+	git init repo &&
+	test_commit -C repo A &&
+	git -C repo config set reftable.autoCompaction false &&
+
+	start=$(wc -l <repo/.git/reftable/tables.list) &&
+	iterations=5 &&
+	expected=$((start + iterations)) &&
+
+	for i in $(test_seq $iterations)
+	do
+		git -C repo update-ref branch-$i HEAD || return 1
+	done &&
+	test_line_count = $expected repo/.git/reftable/tables.list &&
+
+	git -C repo maintenance run --auto --task=pack-refs &&
+	test_line_count -lt $expected repo/.git/reftable/tables.list
+'
+
+test_expect_success 'ref transaction: auto-compaction can be detached' '
+	test_when_finished "rm -rf repo" &&
+
+	git init repo &&
+	test_commit -C repo --no-tag A &&
+	for i in 1 2
+	do
+		GIT_TEST_REFTABLE_AUTOCOMPACTION=false \
+		git -C repo update-ref refs/heads/branch-$i HEAD || return 1
+	done &&
+	test_line_count = 3 repo/.git/reftable/tables.list &&
+
+	git -C repo config set reftable.autoCompaction detach &&
+
+	# The extra file descriptor gets inherited by the background process,
+	# so reading stdout waits until it has exited.
+	does_not_matter=$(GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -C repo update-ref refs/heads/branch-3 HEAD 9>&1) &&
+	test_subcommand git --git-dir="$(cd repo/.git && pwd)" pack-refs --auto <trace &&
+	test_line_count = 1 repo/.git/reftable/tables.list &&
+	git -C repo for-each-ref --format="%(refname)" >actual &&
+	cat >expect <<-\EOF &&
+	refs/heads/branch-1
+	refs/heads/branch-2
+	refs/heads/branch-3
+	refs/heads/main
+	EOF
+	test_cmp expect actual
+'
+
+test_expect_success 'ref transaction: compaction is traced' '
+	test_when_finished "rm -rf repo" &&
+
+	git init repo &&
+	test_commit -C repo --no-tag A &&
+	GIT_TEST_REFTABLE_AUTOCOMPACTION=false \
+	git -C repo update-ref refs/heads/branch HEAD &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git -C repo update-ref refs/heads/other HEAD &&
+	test_line_count = 1 repo/.git/reftable/tables.list &&
+	grep "\"region_enter\".*\"category\":\"reftable\",\"label\":\"compact\"" trace &&
+	grep "\"key\":\"compact/bytes\"" trace
+'
+
 test_expect_success 'ref transaction: alternating table sizes are compacted' '
 	test_when_finished "rm -rf repo" &&
 
@@ -42,6 +42,62 @@ test_expect_success 'default write options' '
 	)
 '
 
+test_expect_success 'uncompressed log blocks' '
+	test_when_finished "rm -rf repo" &&
+	init_repo &&
+	(
+		cd repo &&
+		test_commit initial &&
+		test_seq -f "update refs/heads/branch-%d HEAD" 200 |
+		git update-ref --stdin &&
+		cp -R .git/reftable reftable.orig &&
+
+		git pack-refs &&
+		compressed=$(cat .git/reftable/*.ref | wc -c) &&
+		git reflog show refs/heads/branch-200 >expect &&
+		rm -rf .git/reftable &&
+		mv reftable.orig .git/reftable &&
+		git config set extensions.reftableUncompressedLogs true &&
+		git -c reftable.logCompression=0 pack-refs &&
+		uncompressed=$(cat .git/reftable/*.ref | wc -c) &&
+		test $uncompressed -gt $((2 * compressed)) &&
+
+		git reflog show refs/heads/branch-200 >actual &&
+		test_cmp expect actual
+	)
+'
+
+test_expect_success 'uncompressed log blocks require an extension' '
+	test_when_finished "rm -rf repo" &&
+	init_repo &&
+	(
+		cd repo &&
+		test_commit initial &&
+		git -c reftable.logCompression=0 rev-parse HEAD 2>err &&
+		test_must_be_empty err &&
+
+		git -c reftable.logCompression=0 pack-refs 2>err &&
+		test_grep "ignoring reftable.logCompression=0" err &&
+		# "REFT" followed by the format version.
+		cat .git/reftable/*.ref | test-tool hexdump >dump &&
+		test_grep "^52 45 46 54 01 " dump &&
+
+		git update-ref refs/heads/other HEAD &&
+		git config set extensions.reftableUncompressedLogs true &&
+		git -c reftable.logCompression=0 pack-refs 2>err &&
+		test_must_be_empty err &&
+		cat .git/reftable/*.ref | test-tool hexdump >dump &&
+		test_grep "^52 45 46 54 03 " dump
+	)
+'
+
+test_expect_success 'invalid log compression level' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	test_must_fail git -C repo -c reftable.logCompression=10 pack-refs 2>err &&
+	test_grep "bad zlib compression level 10" err
+'
+
 test_expect_success 'disabled reflog writes no log blocks' '
 	test_config_global core.logAllRefUpdates false &&
 	test_when_finished "rm -rf repo" &&
@@ -57,4 +57,182 @@ test_expect_success 'list packed refs with unicode characters' '
 	)
 '
 
+test_expect_success REFFILES 'packed-refs index is written and used' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	(
+		cd repo &&
+		test_commit --no-tag A &&
+		for i in $(test_seq 50)
+		do
+			echo "create refs/heads/branch-$i HEAD" &&
+			echo "create refs/tags/tag-$i HEAD" || return 1
+		done >input &&
+		git update-ref --stdin <input &&
+		git -c core.packedRefsIndex=true pack-refs --all &&
+		test_path_is_file .git/packed-refs.idx &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git for-each-ref --format="%(refname)" >actual &&
+		grep "\"key\":\"index/records\",\"value\":\"101\"" trace &&
+		git -c core.packedRefsIndex=false for-each-ref \
+			--format="%(refname)" >expect &&
+		test_cmp expect actual &&
+
+		git for-each-ref --format="%(refname)" refs/tags/ >actual &&
+		grep refs/tags/ expect >expect.tags &&
+		test_cmp expect.tags actual &&
+
+		git rev-parse --verify refs/heads/branch-42 &&
+		git rev-parse --verify refs/tags/tag-7 &&
+		test_must_fail git rev-parse --verify refs/heads/branch-51 &&
+		git show-ref --exists refs/heads/main
+	)
+'
+
+test_expect_success REFFILES 'packed-refs index is kept up to date' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	(
+		cd repo &&
+		test_commit --no-tag A &&
+		git branch one &&
+		git branch two &&
+		git -c core.packedRefsIndex=true pack-refs --all &&
+		git -c core.packedRefsIndex=true branch -D one &&
+		test_path_is_file .git/packed-refs.idx &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git for-each-ref --format="%(refname)" >actual &&
+		grep "\"key\":\"index/records\",\"value\":\"2\"" trace &&
+		cat >expect <<-\EOF &&
+		refs/heads/main
+		refs/heads/two
+		EOF
+		test_cmp expect actual &&
+
+		git branch -D two &&
+		test_path_is_missing .git/packed-refs.idx &&
+		git for-each-ref --format="%(refname)" >actual &&
+		echo refs/heads/main >expect &&
+		test_cmp expect actual
+	)
+'
+
+test_expect_success REFFILES 'stale packed-refs index is ignored' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	(
+		cd repo &&
+		test_commit --no-tag A &&
+		git branch one &&
+		git branch two &&
+		git -c core.packedRefsIndex=true pack-refs --all &&
+		cp .git/packed-refs.idx idx.saved &&
+
+		# Simulate an older Git rewriting packed-refs behind our back.
+		git branch -D one &&
+		cp idx.saved .git/packed-refs.idx &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git for-each-ref --format="%(refname)" >actual &&
+		! grep "index/records" trace &&
+		cat >expect <<-\EOF &&
+		refs/heads/main
+		refs/heads/two
+		EOF
+		test_cmp expect actual &&
+		git rev-parse --verify refs/heads/two
+	)
+'
+
+test_expect_success REFFILES 'packed-refs index with mismatching offsets is dropped' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	(
+		cd repo &&
+		test_commit --no-tag A &&
+		git branch one &&
+		git branch two &&
+		git -c core.packedRefsIndex=true pack-refs --all &&
+		cp -p .git/packed-refs saved &&
+
+		# Rewrite packed-refs in place with records of the same total
+		# size but different boundaries, and restore its timestamps,
+		# as a Git that does not know about the index might do.
+		sed -e "s|refs/heads/main|refs/heads/ma|" \
+		    -e "s|refs/heads/one|refs/heads/onexx|" saved >new &&
+		test_line_count = 4 new &&
+		cat new >.git/packed-refs &&
+		touch -r saved .git/packed-refs &&
+
+		git rev-parse --verify refs/heads/onexx &&
+		git rev-parse --verify refs/heads/two &&
+		test_must_fail git rev-parse --verify refs/heads/one &&
+		git for-each-ref --format="%(refname)" >actual &&
+		cat >expect <<-\EOF &&
+		refs/heads/ma
+		refs/heads/onexx
+		refs/heads/two
+		EOF
+		test_cmp expect actual
+	)
+'
+
+test_expect_success REFFILES 'packed-refs index offsets at peeled lines are rejected' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	(
+		cd repo &&
+		test_commit --no-tag A &&
+		hexsz=$(test_oid hexsz) &&
+		# Sized so that its record starts where the peeled line of
+		# "one" below does.
+		long=refs/heads/p$(printf "%0$((hexsz + 2))d" 0) &&
+		git branch one &&
+		git update-ref $long HEAD &&
+		git -c core.packedRefsIndex=true pack-refs --all &&
+		cp -p .git/packed-refs saved &&
+
+		oid=$(git rev-parse HEAD) &&
+		{
+			head -n 3 saved &&
+			echo "^$oid" &&
+			echo "$oid refs/heads/z"
+		} >new &&
+		test_file_size saved >expect &&
+		test_file_size new >actual &&
+		test_cmp expect actual &&
+		cat new >.git/packed-refs &&
+		touch -r saved .git/packed-refs &&
+
+		git rev-parse --verify refs/heads/z &&
+		test_must_fail git rev-parse --verify $long
+	)
+'
+
+test_expect_success REFFILES 'packed-refs index with a bad checksum is ignored' '
+	test_when_finished "rm -rf repo" &&
+	git init repo &&
+	(
+		cd repo &&
+		test_commit --no-tag A &&
+		git branch one &&
+		git -c core.packedRefsIndex=true pack-refs --all &&
+		# Claim a record in the first fanout bucket, which is empty.
+		chmod u+w .git/packed-refs.idx &&
+		printf "\001" |
+		dd of=.git/packed-refs.idx bs=1 seek=51 conv=notrunc &&
+
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git for-each-ref --format="%(refname)" >actual &&
+		! grep "index/records" trace &&
+		cat >expect <<-\EOF &&
+		refs/heads/main
+		refs/heads/one
+		EOF
+		test_cmp expect actual
+	)
+'
+
 test_done
@@ -228,4 +228,44 @@ test_expect_success 'hook gets all queued symref updates' '
 	test_cmp expect actual
 '
 
+test_expect_success REFFILES 'hook sees updates written to packed-refs once' '
+	test_when_finished "rm actual" &&
+	git update-ref refs/heads/batch-update $PRE_OID &&
+	git update-ref refs/heads/batch-delete $PRE_OID &&
+
+	test_hook reference-transaction <<-\EOF &&
+	echo "$*" >>actual
+	while read -r line
+	do
+		printf "%s\n" "$line"
+	done >>actual
+	EOF
+
+	cat >expect <<-EOF &&
+	preparing
+	$ZERO_OID $POST_OID refs/heads/batch-create
+	$PRE_OID $POST_OID refs/heads/batch-update
+	$PRE_OID $ZERO_OID refs/heads/batch-delete
+	prepared
+	$ZERO_OID $POST_OID refs/heads/batch-create
+	$PRE_OID $POST_OID refs/heads/batch-update
+	$PRE_OID $ZERO_OID refs/heads/batch-delete
+	committed
+	$ZERO_OID $POST_OID refs/heads/batch-create
+	$PRE_OID $POST_OID refs/heads/batch-update
+	$PRE_OID $ZERO_OID refs/heads/batch-delete
+	EOF
+
+	git -c core.packedRefsBatchSize=2 update-ref --stdin <<-EOF &&
+	create refs/heads/batch-create $POST_OID
+	update refs/heads/batch-update $POST_OID $PRE_OID
+	delete refs/heads/batch-delete $PRE_OID
+	EOF
+	test_cmp expect actual &&
+	test_path_is_missing .git/refs/heads/batch-create &&
+	git rev-parse refs/heads/batch-create >actual &&
+	echo $POST_OID >expect &&
+	test_cmp expect actual
+'
+
 test_done
@@ -240,4 +240,36 @@ test_expect_success 'log -S --pickaxe-regex looks into binary files' '
 	test_cmp log full-log
 '
 
+test_expect_success 'log -S counts blobs seen in earlier commits correctly' '
+	git init GS-revisit &&
+	test_commit -C GS-revisit --printf three-c file "n\nn\nn\nc\n" &&
+	test_commit -C GS-revisit --printf three-b file "n\nn\nn\nb\n" &&
+	test_commit -C GS-revisit --printf one file "n\n" &&
+	test_commit -C GS-revisit --printf three-b-again file "n\nn\nn\nb\n" &&
+
+	# "three-b" is counted only up to two when looking at the
+	# newest commit, which must not make it differ from "three-c".
+	cat >expect <<-\EOF &&
+	three-b-again
+	one
+	three-c
+	EOF
+	git -C GS-revisit log --format=%s -Sn >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'diff -S with a combined diffstat' '
+	git init GS-combined &&
+	test_commit -C GS-combined one file "one" &&
+	test_commit -C GS-combined two file "two" &&
+	test_commit -C GS-combined three file "needle" &&
+
+	# The diffstat is made with a copy of the diff options, which
+	# must not free the pickaxe cache of the original.
+	git -C GS-combined diff -c --stat three one two >expect &&
+	git -C GS-combined diff -c --stat -Sneedle three one two >actual &&
+	test_cmp expect actual &&
+	test_line_count = 2 actual
+'
+
 test_done
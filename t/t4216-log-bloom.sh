@@ -184,6 +184,22 @@ test_expect_success 'git log with path contains various magic signatures' '
 	test_bloom_filters_used "-- \:\(attr\:text\)A"
 '
 
+test_expect_success 'git log with excluded paths uses Bloom filters for the others' '
+	test_bloom_filters_used "-- A \:\(exclude\)A/B/C" &&
+	test_bloom_filters_used "-- A/B file4 \:\(exclude\)A/B/file2" &&
+	test_bloom_filters_used "-- \:\(exclude\)A/B A/\*" &&
+	test_bloom_filters_not_used "-- \:\(exclude\)A \:\(exclude\)file4"
+'
+
+test_expect_success 'git log with case-insensitive paths uses Bloom filters for their prefix' '
+	(
+		cd A &&
+		test_bloom_filters_used "-- \:\(icase\)b/C" &&
+		test_bloom_filters_used "-- \:\(icase\)FILE1"
+	) &&
+	test_bloom_filters_not_used "-- \:\(icase\)a/B"
+'
+
 test_expect_success 'setup - add commit-graph to the chain without Bloom filters' '
 	test_commit c14 A/anotherFile2 &&
 	test_commit c15 A/B/anotherFile2 &&
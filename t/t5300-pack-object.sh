@@ -215,6 +215,10 @@ test_expect_success 'unpack with OFS_DELTA (core.fsyncmethod=batch)' '
 	check_unpack test-3-${packname_3} obj-list "$BATCH_CONFIGURATION"
 '
 
+test_expect_success 'unpack with OFS_DELTA (no delta base cache)' '
+	check_unpack test-3-${packname_3} obj-list "-c core.deltaBaseCacheLimit=0"
+'
+
 test_expect_success PERL_TEST_HELPERS 'compare delta flavors' '
 	perl -e '\''
 		defined($_ = -s $_) or die for @ARGV;
@@ -742,4 +746,60 @@ test_expect_success '--path-walk thin pack' '
 	git -C server index-pack --fix-thin --stdin <out.pack
 '
 
+test_expect_success 'objects are checked by multiple threads' '
+	git init many &&
+	(
+		cd many &&
+		base=$(test_seq 100) &&
+		for i in $(test_seq 10000)
+		do
+			echo "$base" >"file$i" &&
+			echo "$i" >>"file$i" || return 1
+		done &&
+		git add . &&
+		git commit -q -m many &&
+		git repack -adf --window=10 &&
+
+		git pack-objects --all --window=0 --threads=1 \
+			--stdout </dev/null >one.pack &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" git pack-objects --all \
+			--window=0 --threads=2 --stdout </dev/null >two.pack &&
+		test_trace2_data pack-objects check-object/threads 2 <trace &&
+		test_cmp_bin one.pack two.pack
+	)
+'
+
+test_expect_success 'threaded object checks read large delta sizes' '
+	(
+		cd many &&
+		GIT_TEST_OE_SIZE=8 git pack-objects --all --window=0 \
+			--threads=1 --stdout </dev/null >one.pack &&
+		GIT_TEST_OE_SIZE=8 git pack-objects --all --window=0 \
+			--threads=2 --stdout </dev/null >two.pack &&
+		test_cmp_bin one.pack two.pack
+	)
+'
+
+test_expect_success 'deltas between blob revisions apply' '
+	git init delta-bench &&
+	(
+		cd delta-bench &&
+		test_seq 1000 >file &&
+		git add file &&
+		git commit -q -m one &&
+		for i in 1 7 8 9 63 64 65 999
+		do
+			sed "s/^$i\$/changed/" file >file.new &&
+			mv file.new file &&
+			git commit -q -a -m "change $i" || return 1
+		done &&
+		git log --raw --no-abbrev --format= |
+		awk "\$5 == \"M\" { print \$3, \$4; }" >pairs &&
+		test-tool delta --bench <pairs >out &&
+		echo "pairs 8" >expect &&
+		grep pairs out >actual &&
+		test_cmp expect actual
+	)
+'
+
 test_done
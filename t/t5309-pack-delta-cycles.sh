@@ -81,6 +81,29 @@ test_expect_success 'failover to a duplicate object in the same pack' '
 	git index-pack --fix-thin --stdin <recoverable.pack
 '
 
+test_expect_success 'unpack-objects resolves a delta against a later base' '
+	test_when_finished "rm -rf unpack" &&
+	git init unpack &&
+	git -C unpack unpack-objects <ab.pack &&
+	git -C unpack cat-file -t $A &&
+	git -C unpack cat-file -t $B
+'
+
+test_expect_success 'unpack-objects detects REF_DELTA cycles' '
+	test_when_finished "rm -rf unpack" &&
+	git init unpack &&
+	test_must_fail git -C unpack unpack-objects <cycle.pack 2>err &&
+	test_grep "unresolved deltas" err
+'
+
+test_expect_success 'unpack-objects resolves a cycle with a full copy' '
+	test_when_finished "rm -rf unpack" &&
+	git init unpack &&
+	git -C unpack unpack-objects <recoverable.pack &&
+	git -C unpack cat-file -t $A &&
+	git -C unpack cat-file -t $B
+'
+
 test_expect_success 'index-pack works with thin pack A->B->C with B on disk' '
 	git init server &&
 	(
@@ -672,4 +672,22 @@ test_expect_success 'test-tool bitmap write determines bitmap selection' '
 	)
 '
 
+test_expect_success 'rev-list --use-bitmap-index notices missing blobs' '
+	test_when_finished "rm -fr missing-blob" &&
+	git init missing-blob &&
+	(
+		cd missing-blob &&
+
+		test_commit base &&
+		git repack -adb &&
+		test_commit new &&
+		blob=$(git rev-parse HEAD:new.t) &&
+		rm .git/objects/$(test_oid_to_path $blob) &&
+
+		test_must_fail git rev-list --objects --use-bitmap-index \
+			HEAD --not base 2>err &&
+		test_grep "missing blob object .$blob." err
+	)
+'
+
 test_done
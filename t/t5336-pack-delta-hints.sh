@@ -0,0 +1,148 @@
+#!/bin/sh
+
+test_description='pack-objects delta hints'
+
+. ./test-lib.sh
+
+packdir=.git/objects/pack
+
+count_deltas () {
+	git verify-pack -v $packdir/pack-*.idx >verify &&
+	awk "NF == 7" verify >deltas &&
+	test_line_count = "$1" deltas
+}
+
+test_expect_success 'setup' '
+	test_seq 1000 >file &&
+	git add file &&
+	git commit -m initial &&
+	for i in $(test_seq 10)
+	do
+		echo $i >>file &&
+		test_seq $i >"small$i" &&
+		git add file "small$i" &&
+		git commit -q -m "change $i" || return 1
+	done &&
+	git config pack.deltaHints true
+'
+
+test_expect_success 'repack writes delta hints' '
+	git repack -adf &&
+	test_path_is_file $packdir/pack-*.hints &&
+	git count-objects -v >out &&
+	grep "^garbage: 0" out
+'
+
+test_expect_success 'repack -f deltifies against hinted bases' '
+	git verify-pack -v $packdir/pack-*.idx >verify &&
+	awk "NF == 7" verify >before &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git repack -adf &&
+	test_trace2_data pack-objects delta-hints/used $(wc -l <before) <trace &&
+	count_deltas $(wc -l <before) &&
+	git fsck
+'
+
+test_expect_success 'new objects are still searched' '
+	echo 11 >>file &&
+	git commit -q -a -m "change 11" &&
+	git verify-pack -v $packdir/pack-*.idx >verify &&
+	awk "NF == 7" verify >before &&
+	GIT_TRACE2_EVENT="$(pwd)/trace" git repack -adf &&
+	test_trace2_data pack-objects delta-hints/used $(wc -l <before) <trace &&
+	git verify-pack -v $packdir/pack-*.idx >verify &&
+	awk "NF == 7" verify >after &&
+	test $(wc -l <after) -gt $(wc -l <before) &&
+	git fsck
+'
+
+test_expect_success 'delta hints respect --depth' '
+	git verify-pack -v $packdir/pack-*.idx >verify &&
+	test_grep "chain length = 2" verify &&
+	git repack -adf --depth=1 &&
+	git verify-pack -v $packdir/pack-*.idx >verify &&
+	test_grep "chain length = 1" verify &&
+	test_grep ! "chain length = 2" verify &&
+	git fsck
+'
+
+test_expect_success 'hinted deltas are found with threads' '
+	git verify-pack -v $packdir/pack-*.idx >verify &&
+	awk "NF == 7" verify >before &&
+	GIT_TRACE2_EVENT="$(pwd)/trace-threads" git repack -adf --threads=4 &&
+	test_trace2_data pack-objects delta-hints/used $(wc -l <before) \
+		<trace-threads &&
+	git fsck
+'
+
+test_expect_success 'delta hints do not use preferred bases' '
+	test_seq 2000 >shrink &&
+	git add shrink &&
+	git commit -q -m "add shrink" &&
+	test_seq 1999 >shrink &&
+	git commit -q -a -m "shrink" &&
+	git repack -adf &&
+	GIT_TRACE2_EVENT="$(pwd)/trace-thin" \
+		git pack-objects --thin --no-reuse-delta --stdout --revs \
+		>thin.pack <<-\EOF &&
+	HEAD
+	^HEAD~1
+	EOF
+	test_trace2_data pack-objects delta-hints/used 0 <trace-thin
+'
+
+test_expect_success 'delta hints respect --window-memory' '
+	git repack -adf &&
+	GIT_TRACE2_EVENT="$(pwd)/trace-memory" \
+		git repack -adf --window-memory=1 &&
+	test_trace2_data pack-objects delta-hints/used 0 <trace-memory
+'
+
+test_expect_success 'delta hints respect delta islands' '
+	git init islands &&
+	(
+		cd islands &&
+		git config pack.deltaHints true &&
+		test-tool genrandom seed 10240 >file &&
+		git add file &&
+		git commit -q -m one &&
+		git checkout -q --orphan two &&
+		echo 2 >>file &&
+		git commit -q -a -m two &&
+		git repack -adf &&
+		count_deltas 1 &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git -c "pack.island=refs/heads/(.*)" repack -adfi &&
+		test_trace2_data pack-objects delta-hints/used 0 <trace &&
+		count_deltas 0
+	)
+'
+
+test_expect_success 'unusable delta hints are ignored' '
+	hints=$(echo $packdir/pack-*.hints) &&
+	chmod u+w "$hints" &&
+	printf "DHNT" >"$hints" &&
+	git repack -adf 2>err &&
+	test_grep "delta hints file .* is too small" err &&
+	git fsck
+'
+
+test_expect_success 'delta hints of another pack are ignored' '
+	git repack -adf &&
+	cp $packdir/pack-*.hints stale.hints &&
+	git repack -adf --window=0 &&
+	hints=$(echo $packdir/pack-*.hints) &&
+	chmod u+w "$hints" &&
+	cp stale.hints "$hints" &&
+	GIT_TRACE2_EVENT="$(pwd)/trace-stale" git repack -adf 2>err &&
+	test_grep "delta hints file .* does not match its pack" err &&
+	test_trace2_data pack-objects delta-hints/used 0 <trace-stale &&
+	git fsck
+'
+
+test_expect_success 'repack without delta hints removes them' '
+	test_path_is_file $packdir/pack-*.hints &&
+	git -c pack.deltaHints=false repack -adf &&
+	test_path_is_missing $packdir/pack-*.hints
+'
+
+test_done
@@ -70,7 +70,7 @@ test_expect_success TEE_DOES_NOT_HANG \
 	git receive-pack remote.git <out >actual 2>err &&
 
 	test_grep "missing necessary objects" actual &&
-	test_grep "fatal: Failed to traverse parents" err &&
+	test_grep "fatal: Failed to traverse parents" actual &&
 	test_must_fail git -C remote.git cat-file -e $(git -C repo rev-parse HEAD)
 '
 
@@ -97,4 +97,66 @@ test_expect_success TEE_DOES_NOT_HANG \
 	test_must_fail git -C remote.git rev-list $(git -C repo rev-parse HEAD)
 '
 
+test_expect_success TEE_DOES_NOT_HANG \
+	'receive-pack reports only the refs that are not connected' '
+	test_when_finished rm -rf repo remote.git setup.git &&
+
+	git init repo &&
+	git -C repo commit --allow-empty -m 1 &&
+	git -C repo branch one &&
+	git -C repo checkout --orphan other &&
+	git -C repo commit --allow-empty -m other &&
+	git -C repo checkout main &&
+	git clone --bare repo setup.git &&
+	git -C repo commit --allow-empty -m 2 &&
+	git -C repo branch two &&
+	git -C repo branch also-other other &&
+	git -C repo branch also-one one &&
+
+	git -C repo send-pack ../setup.git two also-other also-one \
+		--receive-pack="tee ${SQ}$(pwd)/out${SQ} | git-receive-pack" &&
+
+	# Replay on a repository that has "other", but not "one".
+	git init --bare remote.git &&
+	git -C remote.git fetch ../repo other:other &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.event" \
+	git receive-pack remote.git <out >actual 2>err &&
+
+	test_grep "ng refs/heads/two missing necessary objects" actual &&
+	test_grep "ng refs/heads/also-one missing necessary objects" actual &&
+	test_grep "ok refs/heads/also-other" actual &&
+	# The combined check, then its halves, then the halves of the
+	# second half.
+	grep "\"event\":\"child_start\".*\"rev-list\"" trace.event >rev-list &&
+	test_line_count = 5 rev-list &&
+	test_region receive-pack check_connected trace.event &&
+	test_region receive-pack update_refs trace.event
+'
+
+test_expect_success TEE_DOES_NOT_HANG \
+	'receive-pack with receive.useBitmaps checks connectivity' '
+	test_when_finished rm -rf repo remote.git setup.git &&
+
+	git init repo &&
+	test_commit -C repo 1 &&
+	git clone --bare repo setup.git &&
+	test_commit -C repo 2 &&
+
+	git -C repo send-pack ../setup.git --all \
+		--receive-pack="tee ${SQ}$(pwd)/out${SQ} | git-receive-pack" &&
+
+	git init --bare remote.git &&
+	git -C repo checkout --orphan unrelated &&
+	test_commit -C repo unrelated &&
+	git -C repo checkout main &&
+	git -C remote.git fetch ../repo unrelated:unrelated &&
+	git -C remote.git repack -adb &&
+	git -C remote.git config receive.useBitmaps true &&
+	git receive-pack remote.git <out >actual 2>err &&
+	test_grep "missing necessary objects" actual &&
+
+	git -C repo push ../remote.git main &&
+	git -C remote.git rev-parse --verify refs/heads/main
+'
+
 test_done
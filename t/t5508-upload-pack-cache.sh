@@ -0,0 +1,120 @@
+#!/bin/sh
+
+test_description='upload-pack pack cache'
+
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_commit one &&
+	test_commit two &&
+	test_commit three &&
+	git config uploadpack.packCacheSize 1m
+'
+
+clone_with_trace () {
+	trace="$(pwd)/$1" &&
+	shift &&
+	rm -rf dst.git &&
+	GIT_TRACE2_EVENT="$trace" git "$@" clone --bare --no-local . dst.git &&
+	git -C dst.git fsck &&
+	git -C dst.git rev-parse HEAD >actual &&
+	git rev-parse HEAD >expect &&
+	test_cmp expect actual
+}
+
+test_expect_success 'first clone fills the cache' '
+	rm -rf .git/upload-pack-cache &&
+	clone_with_trace trace.miss &&
+	test_trace2_data upload-pack pack-cache/miss 1 <trace.miss &&
+	ls .git/upload-pack-cache >entries &&
+	test_line_count = 1 entries
+'
+
+test_expect_success 'identical clone is served from the cache' '
+	clone_with_trace trace.hit &&
+	test_trace2_data upload-pack pack-cache/hit 1 <trace.hit &&
+	ls .git/upload-pack-cache >entries &&
+	test_line_count = 1 entries
+'
+
+test_expect_success 'cached pack is served over protocol v0 and v2' '
+	clone_with_trace trace.v0 -c protocol.version=0 &&
+	clone_with_trace trace.v2 -c protocol.version=2 &&
+	test_trace2_data upload-pack pack-cache/hit 1 <trace.v2
+'
+
+test_expect_success 'different requests get different entries' '
+	rm -rf .git/upload-pack-cache &&
+	clone_with_trace trace.full &&
+	rm -rf dst.git &&
+	git clone --bare --no-local --depth=1 "file://$(pwd)" dst.git &&
+	git -C dst.git fsck &&
+	test_line_count = 1 dst.git/shallow &&
+	ls .git/upload-pack-cache >entries &&
+	test_line_count = 2 entries
+'
+
+test_expect_success 'identical fetch is served from the cache' '
+	rm -rf .git/upload-pack-cache &&
+	git clone --bare --no-local . fetch1.git &&
+	git clone --bare --no-local . fetch2.git &&
+	test_commit four &&
+	git -C fetch1.git fetch "file://$(pwd)" HEAD:refs/heads/new &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.fetch" \
+		git -C fetch2.git fetch "file://$(pwd)" HEAD:refs/heads/new &&
+	test_trace2_data upload-pack pack-cache/hit 1 <trace.fetch &&
+	git -C fetch2.git fsck &&
+	git rev-parse HEAD >expect &&
+	git -C fetch2.git rev-parse refs/heads/new >actual &&
+	test_cmp expect actual
+'
+
+test_expect_success 'moving a ref invalidates the cache' '
+	clone_with_trace trace.before &&
+	test_commit five &&
+	clone_with_trace trace.after &&
+	test_trace2_data upload-pack pack-cache/miss 1 <trace.after &&
+	grep pack-cache/evicted trace.after &&
+	ls .git/upload-pack-cache >entries &&
+	test_line_count = 1 entries
+'
+
+test_expect_success 'cache is kept below uploadpack.packCacheSize' '
+	rm -rf .git/upload-pack-cache &&
+	test_config uploadpack.packCacheSize 1 &&
+	clone_with_trace trace.tiny &&
+	test_dir_is_empty .git/upload-pack-cache
+'
+
+test_expect_success 'packs larger than the cache are not written' '
+	rm -rf .git/upload-pack-cache &&
+	test_config uploadpack.packCacheSize 1 &&
+	clone_with_trace trace.large &&
+	test_trace2_data upload-pack pack-cache/too-large 1 <trace.large &&
+	! grep pack-cache/evicted trace.large &&
+	test_dir_is_empty .git/upload-pack-cache
+'
+
+test_expect_success POSIXPERM 'cached packs honor core.sharedRepository' '
+	rm -rf .git/upload-pack-cache &&
+	test_config uploadpack.packCacheSize 1m &&
+	test_config core.sharedRepository group &&
+	clone_with_trace trace.shared &&
+	ls .git/upload-pack-cache/*.pack >entries &&
+	test_line_count = 1 entries &&
+	test_modebits $(cat entries) >actual &&
+	echo "-rw-rw----" >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'cache is not used with uploadpack.packObjectsHook' '
+	rm -rf .git/upload-pack-cache &&
+	write_script .git/hook <<-\EOF &&
+	"$@"
+	EOF
+	test_config_global uploadpack.packObjectsHook ./hook &&
+	clone_with_trace trace.hook &&
+	test_path_is_missing .git/upload-pack-cache
+'
+
+test_done
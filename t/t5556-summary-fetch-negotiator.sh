@@ -0,0 +1,91 @@
+#!/bin/sh
+
+test_description='test summary fetch negotiator'
+
+. ./test-lib.sh
+
+have_sent () {
+	while test "$#" -ne 0
+	do
+		grep "fetch> have $(git -C client rev-parse $1)" trace
+		if test $? -ne 0
+		then
+			echo "No have $(git -C client rev-parse $1) ($1)"
+			return 1
+		fi
+		shift
+	done
+}
+
+have_not_sent () {
+	while test "$#" -ne 0
+	do
+		grep "fetch> have $(git -C client rev-parse $1)" trace
+		if test $? -eq 0
+		then
+			return 1
+		fi
+		shift
+	done
+}
+
+# trace_fetch <client_dir> <server_dir> [args]
+#
+# Trace the packet output of fetch, but make sure we disable the variable
+# in the child upload-pack, so we don't combine the results in the same file.
+trace_fetch () {
+	client=$1; shift
+	server=$1; shift
+	GIT_TRACE_PACKET="$(pwd)/trace" \
+	git -C "$client" fetch \
+	  --upload-pack 'unset GIT_TRACE_PACKET; git-upload-pack' \
+	  "$server" "$@"
+}
+
+test_expect_success 'tip and first-parent ancestors at growing distances are sent' '
+	git init server &&
+	test_commit -C server to_fetch &&
+
+	git init client &&
+	for i in $(test_seq 7)
+	do
+		test_commit -C client --no-tag c$i || return 1
+	done &&
+
+	# "c7" is the tip, "c6", "c5" and "c3" are at distance 1, 2 and 4,
+	# and "c1" is the root.
+	test_config -C client fetch.negotiationalgorithm summary &&
+	trace_fetch client "$(pwd)/server" &&
+	have_sent HEAD HEAD~1 HEAD~2 HEAD~4 HEAD~6 &&
+	have_not_sent HEAD~3 HEAD~5 &&
+
+	# all of it in a single request that ends negotiation
+	test_grep "fetch> done" trace &&
+	test_grep ! "fetch< acknowledgments" trace &&
+	git -C client cat-file -e FETCH_HEAD
+'
+
+test_expect_success 'history covered by a newer tip is not summarized again' '
+	rm -rf server client trace &&
+	git init server &&
+	test_commit -C server to_fetch &&
+
+	git init client &&
+	for i in $(test_seq 7)
+	do
+		test_commit -C client --no-tag c$i || return 1
+	done &&
+	main=$(git -C client branch --show-current) &&
+	git -C client checkout -b side HEAD~2 &&
+	test_commit -C client --no-tag s1 &&
+	test_commit -C client --no-tag s2 &&
+
+	# "side" is newer and summarized first: "s2", "s1", "c5", "c3" and
+	# the root "c1". The walk from "main" then stops at "c5".
+	test_config -C client fetch.negotiationalgorithm summary &&
+	trace_fetch client "$(pwd)/server" &&
+	have_sent side side~1 $main~2 $main~4 $main~6 $main $main~1 &&
+	have_not_sent $main~3 $main~5
+'
+
+test_done
@@ -367,6 +367,15 @@ test_expect_success 'rev-list: first-parent range topo-order' '
 	run_all_modes git rev-list --first-parent --topo-order commit-3-8..commit-6-6
 '
 
+test_expect_success 'rev-list: first-parent topo-order only explores first parents' '
+	test_when_finished rm -rf .git/objects/info/commit-graph &&
+	cp commit-graph-full .git/objects/info/commit-graph &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git rev-list --first-parent --topo-order commit-6-6 >actual &&
+	test_line_count = 11 actual &&
+	grep "\"count_explore_walked\":11," trace.txt
+'
+
 test_expect_success 'rev-list: ancestry-path topo-order' '
 	git rev-parse \
 		commit-6-6 commit-5-6 commit-4-6 commit-3-6 \
@@ -529,6 +538,46 @@ test_expect_success 'for-each-ref ahead-behind:none' '
 		--format="%(refname) %(ahead-behind:commit-8-4)" --stdin
 '
 
+test_expect_success 'for-each-ref ahead-behind: threaded counts match' '
+	git for-each-ref --format="%(refname)" refs/heads/ >input &&
+	GIT_TEST_AHEAD_BEHIND_THREADS=1 git for-each-ref --stdin \
+		--format="%(refname) %(ahead-behind:commit-8-4) %(ahead-behind:commit-3-9)" \
+		<input >expect &&
+	test_when_finished "rm -f trace" &&
+	run_all_modes test_env GIT_TRACE2_EVENT="$(pwd)/trace" \
+		GIT_TEST_AHEAD_BEHIND_THREADS=3 git for-each-ref --stdin \
+		--format="%(refname) %(ahead-behind:commit-8-4) %(ahead-behind:commit-3-9)" &&
+	grep "\"key\":\"threads\",\"value\":\"3\"" trace
+'
+
+test_expect_success 'for-each-ref ahead-behind: skewed dates, no commit-graph' '
+	git init skewed &&
+	(
+		cd skewed &&
+		test_commit base &&
+		tree=$(git rev-parse HEAD^{tree}) &&
+		old=$(git rev-parse HEAD) &&
+		for i in $(test_seq 300)
+		do
+			old=$(GIT_COMMITTER_DATE="@$((100000 - $i)) +0000" \
+				git commit-tree -p $old -m "old $i" $tree) || return 1
+		done &&
+		git update-ref refs/heads/old $old &&
+		test_commit new &&
+
+		git rev-list --left-right --count old...new >counts &&
+		echo "refs/heads/old $(tr "\t" " " <counts)" >expect &&
+		echo refs/heads/old >input &&
+		for threads in 1 2
+		do
+			GIT_TEST_AHEAD_BEHIND_THREADS=$threads \
+				git -c core.commitGraph=false for-each-ref --stdin \
+				--format="%(refname) %(ahead-behind:new)" <input >actual &&
+			test_cmp expect actual || return 1
+		done
+	)
+'
+
 test_expect_success 'for-each-ref merged:linear' '
 	cat >input <<-\EOF &&
 	refs/heads/commit-1-1
@@ -967,4 +1016,65 @@ test_expect_success 'merge-base without --all is one of --all results' '
 	grep -F -f single all
 '
 
+test_expect_success 'setup: repository with reachability bitmaps' '
+	git clone --mirror --no-local . bitmap.git &&
+	git -C bitmap.git repack -adb &&
+	(
+		cd bitmap.git &&
+		commit=$(git commit-tree -p commit-9-9 -m unpacked HEAD^{tree}) &&
+		git update-ref refs/heads/unpacked $commit &&
+		git for-each-ref --format="%(objectname) %(refname)" \
+			refs/heads/ >../bitmap-refs
+	)
+'
+
+test_expect_success 'for-each-ref --merged with bitmaps' '
+	for base in commit-1-1 commit-5-5 commit-9-6 unpacked
+	do
+		git -C bitmap.git rev-list $base >reachable &&
+		grep -F -f reachable bitmap-refs | cut -d" " -f2 >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			git -C bitmap.git for-each-ref --format="%(refname)" \
+			--merged=$base refs/heads/ >actual &&
+		test_cmp expect actual &&
+		grep "\"key\":\"merged/bitmap\"" trace &&
+		rm trace &&
+
+		grep -v -F -f reachable bitmap-refs | cut -d" " -f2 >expect &&
+		git -C bitmap.git for-each-ref --format="%(refname)" \
+			--no-merged=$base refs/heads/ >actual &&
+		test_cmp expect actual || return 1
+	done
+'
+
+test_expect_success 'for-each-ref --contains with bitmaps' '
+	for target in commit-1-1 commit-5-5 commit-9-6 unpacked
+	do
+		git -C bitmap.git rev-list --ancestry-path \
+			--branches ^$target >descendants &&
+		git -C bitmap.git rev-parse $target >>descendants &&
+		grep -F -f descendants bitmap-refs | cut -d" " -f2 >expect &&
+		git -C bitmap.git for-each-ref --format="%(refname)" \
+			--contains=$target refs/heads/ >actual &&
+		test_cmp expect actual &&
+
+		grep -v -F -f descendants bitmap-refs | cut -d" " -f2 >expect &&
+		git -C bitmap.git for-each-ref --format="%(refname)" \
+			--no-contains=$target refs/heads/ >actual &&
+		test_cmp expect actual || return 1
+	done &&
+
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -C bitmap.git for-each-ref --contains=commit-5-5 \
+		refs/heads/ >/dev/null &&
+	grep "\"key\":\"contains/bitmap\",\"value\":\"[1-9]" trace &&
+	rm trace &&
+
+	# A target outside of the bitmapped pack is not in any bitmap.
+	GIT_TRACE2_EVENT="$(pwd)/trace" \
+		git -C bitmap.git for-each-ref --contains=unpacked \
+		refs/heads/ >/dev/null &&
+	grep "\"key\":\"contains/bitmap\",\"value\":\"0\"" trace
+'
+
 test_done
@@ -929,4 +929,25 @@ test_expect_success 'sparse:oid with shared tree OID across cone boundary' '
 	test_cmp_sorted expect out
 '
 
+test_expect_success 'trees are read by multiple threads' '
+	git init threads &&
+	(
+		cd threads &&
+		mkdir -p dir/sub &&
+		for i in $(test_seq 70)
+		do
+			echo $i >dir/sub/file &&
+			echo $i >"dir/file$i" &&
+			git add dir &&
+			git commit -q -m "$i" || return 1
+		done &&
+
+		test-tool path-walk -- --all >expect &&
+		GIT_TRACE2_EVENT="$(pwd)/trace" \
+			test-tool path-walk --threads=4 -- --all >out &&
+		test_cmp expect out &&
+		test_trace2_data path-walk threaded-trees 210 <trace
+	)
+'
+
 test_done
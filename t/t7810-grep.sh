@@ -1175,6 +1175,23 @@ test_expect_success 'grep -Fi' '
 	test_cmp expected actual
 '
 
+test_expect_success 'grep -F with partial matches before the real one' '
+	test_when_finished "rm -f literal" &&
+	printf "%s\n" "zzqzzqzzq" "zzqzz" "qzzq" "zz" >literal &&
+	git grep -F -n --no-index "zzqzz" literal >actual &&
+	cat >expect <<-\EOF &&
+	literal:1:zzqzzqzzq
+	literal:2:zzqzz
+	EOF
+	test_cmp expect actual &&
+	git grep -F -o -n --no-index "qzzq" literal >actual &&
+	cat >expect <<-\EOF &&
+	literal:1:qzzq
+	literal:3:qzzq
+	EOF
+	test_cmp expect actual
+'
+
 test_expect_success 'outside of git repository' '
 	rm -fr non &&
 	mkdir -p non/git/sub &&
@@ -1987,4 +2004,27 @@ test_expect_success 'grep of revision in partial clone batches prefetch and hono
 	test_line_count = 0 missing
 '
 
+test_expect_success 'grep over many revisions scans shared blobs once' '
+	test_create_repo grep-revs &&
+	test_commit -C grep-revs one shared.txt "nothing to see" &&
+	test_commit -C grep-revs two changing.txt "needle 1" &&
+	test_commit -C grep-revs three changing.txt "needle 2" &&
+	cat >expect <<-\EOF &&
+	three:changing.txt:needle 2
+	two:changing.txt:needle 1
+	EOF
+	GIT_TRACE2_EVENT="$(pwd)/grep-revs-trace" \
+		git -C grep-revs -c grep.threads=1 grep needle three two one >actual &&
+	test_cmp expect actual &&
+	test_trace2_data grep unmatched-blobs/skipped 2 <grep-revs-trace &&
+
+	cat >expect <<-\EOF &&
+	three:shared.txt
+	two:shared.txt
+	one:shared.txt
+	EOF
+	git -C grep-revs grep -L needle three two one >actual &&
+	test_cmp expect actual
+'
+
 test_done
@@ -0,0 +1,119 @@
+#!/bin/sh
+
+test_description='git grep with the trigram index of the grep-index maintenance task'
+
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_write_lines "int main(void)" "{" "	return alpha();" "}" >main.c &&
+	test_write_lines "int alpha(void)" "{" "	return 42;" "}" >alpha.c &&
+	test_write_lines "beta gamma" "delta" >notes.txt &&
+	git add . &&
+	git commit -m initial &&
+	git maintenance run --task=grep-index &&
+	test_path_is_file .git/objects/info/grep-index
+'
+
+test_grep_index () {
+	desc=$1
+	shift
+	test_expect_success "grep with index: $desc" "
+		test_might_fail git -c grep.useIndex=false grep $* HEAD >expect &&
+		test_might_fail git grep $* HEAD >actual &&
+		test_cmp expect actual
+	"
+}
+
+test_grep_index 'literal' '-F alpha'
+test_grep_index 'literal without -F' 'return'
+test_grep_index 'no match' 'nonexistent'
+test_grep_index 'short pattern' 'de'
+test_grep_index 'word' '-w alpha'
+test_grep_index 'count' '-c alpha'
+test_grep_index 'files with matches' '-l gamma'
+test_grep_index 'files without match' '-L gamma'
+test_grep_index 'inverted' '-v alpha'
+test_grep_index 'ignore case' '-i ALPHA'
+test_grep_index 'regex' '"al.ha"'
+test_grep_index 'multiple patterns' '-e gamma -e main'
+test_grep_index 'and' '-e return --and -e alpha'
+test_grep_index 'not' '--not -e alpha'
+test_grep_index 'all match' '--all-match -e int -e gamma'
+
+test_expect_success 'index skips blobs that cannot match' '
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" git grep main HEAD >actual &&
+	echo "HEAD:main.c:int main(void)" >expect &&
+	test_cmp expect actual &&
+	test_trace2_data grep index/lookups 3 <trace.txt &&
+	test_trace2_data grep index/skipped 2 <trace.txt
+'
+
+test_expect_success 'index is not used for case-insensitive patterns' '
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" git grep -i main HEAD >actual &&
+	! grep index/lookups trace.txt
+'
+
+test_expect_success 'grep.useIndex=false disables the index' '
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git -c grep.useIndex=false grep main HEAD >actual &&
+	! grep index/lookups trace.txt
+'
+
+test_expect_success 'blobs missing from the index are searched' '
+	echo "epsilon main" >new.txt &&
+	git add new.txt &&
+	git commit -m new &&
+	git grep -F epsilon HEAD >actual &&
+	echo "HEAD:new.txt:epsilon main" >expect &&
+	test_cmp expect actual &&
+	git grep -F epsilon HEAD:new.txt >actual &&
+	echo "HEAD:new.txt:epsilon main" >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'refreshing the index only reads new blobs' '
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git maintenance run --task=grep-index &&
+	test_trace2_data grep-index blobs 4 <trace.txt &&
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" git grep epsilon HEAD >actual &&
+	echo "HEAD:new.txt:epsilon main" >expect &&
+	test_cmp expect actual &&
+	test_trace2_data grep index/skipped 3 <trace.txt
+'
+
+test_expect_success 'refreshed index matches a rewritten one' '
+	cp .git/objects/info/grep-index incremental &&
+	rm .git/objects/info/grep-index &&
+	git maintenance run --task=grep-index &&
+	test_cmp_bin incremental .git/objects/info/grep-index
+'
+
+test_expect_success 'blobs only reachable from other refs are indexed' '
+	git checkout -b side &&
+	echo "zeta only here" >side.txt &&
+	git add side.txt &&
+	git commit -m side &&
+	git checkout - &&
+	git maintenance run --task=grep-index &&
+	git grep zeta side >actual &&
+	echo "side:side.txt:zeta only here" >expect &&
+	test_cmp expect actual
+'
+
+test_expect_success 'corrupt index is ignored' '
+	test_when_finished "rm -f .git/objects/info/grep-index" &&
+	rm -f .git/objects/info/grep-index &&
+	echo garbage >.git/objects/info/grep-index &&
+	git grep main HEAD >actual 2>err &&
+	test_grep "grep-index" err &&
+	echo "HEAD:main.c:int main(void)" >expect &&
+	echo "HEAD:new.txt:epsilon main" >>expect &&
+	test_cmp expect actual
+'
+
+test_done
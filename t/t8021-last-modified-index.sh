@@ -0,0 +1,98 @@
+#!/bin/sh
+
+test_description='git last-modified with the index of the last-modified-index maintenance task'
+
+GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME=main
+export GIT_TEST_DEFAULT_INITIAL_BRANCH_NAME
+
+. ./test-lib.sh
+
+test_expect_success 'setup' '
+	test_commit 1 file &&
+	mkdir -p a/b &&
+	test_commit 2 a/file &&
+	test_commit 3 a/b/file &&
+	git checkout -b side &&
+	test_commit 4 a/side &&
+	git checkout main &&
+	test_commit 5 other &&
+	git merge -m merge side &&
+	git maintenance run --task=last-modified-index &&
+	test_path_is_file .git/objects/info/last-modified
+'
+
+test_last_modified_index () {
+	desc=$1
+	shift
+	test_expect_success "last-modified with index: $desc" "
+		git -c lastModified.useIndex=false last-modified $* >tmp &&
+		sort tmp >expect &&
+		git last-modified $* >tmp &&
+		sort tmp >actual &&
+		test_cmp expect actual
+	"
+}
+
+test_last_modified_index 'default' ''
+test_last_modified_index 'recursive' '-r'
+test_last_modified_index 'show trees' '-r -t'
+test_last_modified_index 'max depth' '--max-depth=1'
+test_last_modified_index 'pathspec' '-r a/b'
+test_last_modified_index 'other commit' '-r side'
+test_last_modified_index 'range' '-r HEAD~2..HEAD'
+
+test_expect_success 'paths are answered from the index at its tip' '
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" git last-modified -r -t >actual &&
+	test_trace2_data last-modified index/lookups 7 <trace.txt &&
+	test_trace2_data last-modified index/found 7 <trace.txt
+'
+
+test_expect_success 'only new history is walked' '
+	test_commit 6 a/file &&
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" git last-modified -r >tmp &&
+	sort tmp >actual &&
+	git -c lastModified.useIndex=false last-modified -r >tmp &&
+	sort tmp >expect &&
+	test_cmp expect actual &&
+	test_trace2_data last-modified index/lookups 4 <trace.txt &&
+	test_trace2_data last-modified index/found 4 <trace.txt
+'
+
+test_expect_success 'index is not used for ranges' '
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" git last-modified HEAD~2..HEAD &&
+	! grep index/lookups trace.txt
+'
+
+test_expect_success 'lastModified.useIndex=false disables the index' '
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" \
+		git -c lastModified.useIndex=false last-modified &&
+	! grep index/lookups trace.txt
+'
+
+test_expect_success 'maintenance updates the index' '
+	git maintenance run --task=last-modified-index &&
+	rm -f trace.txt &&
+	GIT_TRACE2_EVENT="$(pwd)/trace.txt" git last-modified -r >tmp &&
+	sort tmp >actual &&
+	test_cmp expect actual &&
+	test_trace2_data last-modified index/lookups 5 <trace.txt
+'
+
+test_expect_success '--write-index rejects pathspecs and ranges' '
+	test_must_fail git last-modified --write-index -- a 2>err &&
+	test_grep "cannot be used with a revision range or pathspec" err &&
+	test_must_fail git last-modified --write-index HEAD~1..HEAD 2>err &&
+	test_grep "cannot be used with a revision range or pathspec" err
+'
+
+test_expect_success 'maintenance does nothing on an unborn branch' '
+	git init unborn &&
+	git -C unborn maintenance run --task=last-modified-index &&
+	test_path_is_missing unborn/.git/objects/info/last-modified
+'
+
+test_done
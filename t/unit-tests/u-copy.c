@@ -0,0 +1,82 @@
+#include "unit-test.h"
+#include "copy.h"
+#include "strbuf.h"
+
+static const char data[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static int open_source(void)
+{
+	int fd = xopen("source", O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+	cl_must_pass(write_in_full(fd, data, strlen(data)));
+	/* copy_fd_range() must not move the file offset of its input */
+	cl_assert_equal_i(lseek(fd, 5, SEEK_SET), 5);
+	return fd;
+}
+
+static void check_copy(int ofd_flags)
+{
+	struct strbuf buf = STRBUF_INIT;
+	int ifd = open_source();
+	int ofd = xopen("dest", O_WRONLY | O_CREAT | O_TRUNC | ofd_flags, 0666);
+
+	cl_assert_equal_i(copy_fd_range(ifd, 10, ofd, 6), 0);
+	cl_assert_equal_i(copy_fd_range(ifd, 0, ofd, 3), 0);
+	cl_assert_equal_i(lseek(ifd, 0, SEEK_CUR), 5);
+	close(ofd);
+
+	cl_must_pass(strbuf_read_file(&buf, "dest", 0));
+	cl_assert_equal_s(buf.buf, "abcdef012");
+
+	close(ifd);
+	strbuf_release(&buf);
+}
+
+static void check_short_read(int ofd_flags)
+{
+	int ifd = open_source();
+	int ofd = xopen("dest", O_WRONLY | O_CREAT | O_TRUNC | ofd_flags, 0666);
+
+	cl_assert_equal_i(copy_fd_range(ifd, 30, ofd, 10), COPY_SHORT_READ);
+	cl_assert_equal_i(copy_fd_range(ifd, 100, ofd, 1), COPY_SHORT_READ);
+
+	close(ofd);
+	close(ifd);
+}
+
+/* Where sendfile() is available, it copies between regular files. */
+void test_copy__range(void)
+{
+	check_copy(0);
+}
+
+void test_copy__range_short_read(void)
+{
+	check_short_read(0);
+}
+
+/*
+ * sendfile() refuses to write to a file opened with O_APPEND, which
+ * makes copy_fd_range() fall back to reading and writing.
+ */
+void test_copy__range_fallback(void)
+{
+	check_copy(O_APPEND);
+}
+
+void test_copy__range_fallback_short_read(void)
+{
+	check_short_read(O_APPEND);
+}
+
+void test_copy__range_read_error(void)
+{
+	int ofd = xopen("dest", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+	int ifd = xopen("dest", O_WRONLY);
+
+	cl_assert_equal_i(copy_fd_range(ifd, 0, ofd, 1), COPY_READ_ERROR);
+	cl_assert_equal_i(errno, EBADF);
+
+	close(ifd);
+	close(ofd);
+}
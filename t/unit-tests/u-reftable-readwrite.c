@@ -289,6 +289,79 @@ void test_reftable_readwrite__log_write_read(void)
 	reftable_table_decref(table);
 }
 
+static void write_logs(struct reftable_buf *buf,
+		       struct reftable_write_options *opts, int n)
+{
+	struct reftable_writer *w = cl_reftable_strbuf_writer(buf, opts);
+
+	reftable_writer_set_limits(w, 1, 1);
+
+	for (int i = 0; i < n; i++) {
+		char refname[32];
+		struct reftable_log_record log = {
+			.refname = refname,
+			.update_index = 1,
+			.value_type = REFTABLE_LOG_UPDATE,
+			.value.update = {
+				.name = (char *) "My Name",
+				.email = (char *) "myname@invalid",
+				.message = (char *) "commit: some message\n",
+			},
+		};
+
+		snprintf(refname, sizeof(refname), "refs/heads/branch-%04d", i);
+		cl_assert_equal_i(reftable_writer_add_log(w, &log), 0);
+	}
+
+	cl_assert_equal_i(reftable_writer_close(w), 0);
+	reftable_writer_free(w);
+}
+
+void test_reftable_readwrite__log_uncompressed(void)
+{
+	struct reftable_write_options opts = {
+		.block_size = 4096,
+		.unpadded = 1,
+	};
+	struct reftable_buf compressed = REFTABLE_BUF_INIT;
+	struct reftable_buf uncompressed = REFTABLE_BUF_INIT;
+	struct reftable_log_record log = { 0 };
+	struct reftable_block_source source = { 0 };
+	struct reftable_iterator it = { 0 };
+	struct reftable_table *table;
+	int i, n = 100;
+
+	write_logs(&compressed, &opts, n);
+	opts.log_compression_level = REFTABLE_LOG_UNCOMPRESSED;
+	write_logs(&uncompressed, &opts, n);
+
+	cl_assert(uncompressed.len > 2 * compressed.len);
+
+	block_source_from_buf(&source, &uncompressed);
+	cl_assert_equal_i(reftable_table_new(&table, &source, "file.log"), 0);
+	cl_assert_equal_i(table->version, 3);
+	cl_assert_equal_i(reftable_table_init_log_iterator(table, &it), 0);
+	cl_assert_equal_i(reftable_iterator_seek_log(&it, ""), 0);
+
+	for (i = 0; ; i++) {
+		char refname[32];
+		int err = reftable_iterator_next_log(&it, &log);
+		if (err > 0)
+			break;
+		cl_assert_equal_i(err, 0);
+		snprintf(refname, sizeof(refname), "refs/heads/branch-%04d", i);
+		cl_assert_equal_s(log.refname, refname);
+		cl_assert_equal_s(log.value.update.message, "commit: some message\n");
+	}
+	cl_assert_equal_i(i, n);
+
+	reftable_log_record_release(&log);
+	reftable_iterator_destroy(&it);
+	reftable_table_decref(table);
+	reftable_buf_release(&compressed);
+	reftable_buf_release(&uncompressed);
+}
+
 void test_reftable_readwrite__log_zlib_corruption(void)
 {
 	struct reftable_write_options opts = {
@@ -910,6 +910,111 @@ void test_reftable_stack__reflog_expire(void)
 	reftable_log_record_release(&log);
 }
 
+static void write_logs_for_cache(struct reftable_stack *st,
+				 struct reftable_log_record *logs, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		char buf[256];
+		struct write_log_arg arg = {
+			.log = &logs[i],
+		};
+
+		snprintf(buf, sizeof(buf), "refs/heads/branch%04"PRIuMAX,
+			 (uintmax_t)i);
+		logs[i].refname = xstrdup(buf);
+		logs[i].update_index = i + 1;
+		logs[i].value_type = REFTABLE_LOG_UPDATE;
+		logs[i].value.update.time = i;
+		logs[i].value.update.email = xstrdup("identity@invalid");
+		logs[i].value.update.message = xstrdup("a message of some length");
+		cl_reftable_set_hash(logs[i].value.update.new_hash, i,
+				     REFTABLE_HASH_SHA1);
+
+		arg.update_index = reftable_stack_next_update_index(st);
+		cl_assert_equal_i(reftable_stack_add(st, write_test_log,
+						     &arg, 0), 0);
+	}
+	cl_assert_equal_i(reftable_stack_compact_all(st, NULL), 0);
+}
+
+void test_reftable_stack__block_cache(void)
+{
+	char *dir = get_tmp_dir(__LINE__);
+	struct reftable_write_options opts = {
+		.block_size = 256,
+		.exact_log_message = 1,
+		.block_cache_size = 1024 * 1024,
+	};
+	struct reftable_stack *st = NULL;
+	struct reftable_log_record logs[50] = { 0 };
+	struct reftable_log_record log = { 0 };
+	const struct reftable_block_cache_stats *stats;
+	uint64_t misses, hits;
+
+	cl_assert_equal_i(reftable_new_stack(&st, dir, &opts), 0);
+	write_logs_for_cache(st, logs, ARRAY_SIZE(logs));
+
+	stats = reftable_stack_block_cache_stats(st);
+	misses = stats->misses;
+	for (size_t i = 0; i < ARRAY_SIZE(logs); i++)
+		cl_assert_equal_i(reftable_stack_read_log(st, logs[i].refname,
+							  &log), 0);
+	/* There are several blocks, and each holds several logs. */
+	cl_assert(stats->misses - misses > 1);
+	cl_assert(stats->misses - misses < ARRAY_SIZE(logs));
+	misses = stats->misses;
+	hits = stats->hits;
+
+	/* Reading the logs again inflates no block. */
+	for (size_t i = 0; i < ARRAY_SIZE(logs); i++) {
+		cl_assert_equal_i(reftable_stack_read_log(st, logs[i].refname,
+							  &log), 0);
+		cl_assert(reftable_log_record_equal(&log, &logs[i],
+						    REFTABLE_HASH_SIZE_SHA1));
+	}
+	cl_assert_equal_i(stats->misses, misses);
+	cl_assert(stats->hits - hits >= ARRAY_SIZE(logs));
+	cl_assert_equal_i(stats->evictions, 0);
+
+	reftable_stack_destroy(st);
+	for (size_t i = 0; i < ARRAY_SIZE(logs); i++)
+		reftable_log_record_release(&logs[i]);
+	reftable_log_record_release(&log);
+	clear_dir(dir);
+}
+
+void test_reftable_stack__block_cache_evicts(void)
+{
+	char *dir = get_tmp_dir(__LINE__);
+	struct reftable_write_options opts = {
+		.block_size = 256,
+		.exact_log_message = 1,
+		.block_cache_size = 300,
+	};
+	struct reftable_stack *st = NULL;
+	struct reftable_log_record logs[50] = { 0 };
+	struct reftable_log_record log = { 0 };
+	const struct reftable_block_cache_stats *stats;
+
+	cl_assert_equal_i(reftable_new_stack(&st, dir, &opts), 0);
+	write_logs_for_cache(st, logs, ARRAY_SIZE(logs));
+
+	for (size_t i = 0; i < ARRAY_SIZE(logs); i++) {
+		cl_assert_equal_i(reftable_stack_read_log(st, logs[i].refname,
+							  &log), 0);
+		cl_assert(reftable_log_record_equal(&log, &logs[i],
+						    REFTABLE_HASH_SIZE_SHA1));
+	}
+	stats = reftable_stack_block_cache_stats(st);
+	cl_assert(stats->evictions > 0);
+
+	reftable_stack_destroy(st);
+	for (size_t i = 0; i < ARRAY_SIZE(logs); i++)
+		reftable_log_record_release(&logs[i]);
+	reftable_log_record_release(&log);
+	clear_dir(dir);
+}
+
 static int write_nothing(struct reftable_writer *wr, void *arg UNUSED)
 {
 	cl_assert_equal_i(reftable_writer_set_limits(wr, 1, 1), 0);
@@ -1105,6 +1210,52 @@ void test_reftable_stack__add_performs_auto_compaction(void)
 	clear_dir(dir);
 }
 
+static int count_compaction_required(struct reftable_stack *st UNUSED,
+				     void *payload)
+{
+	int *count = payload;
+	(*count)++;
+	return 0;
+}
+
+void test_reftable_stack__add_defers_compaction_to_callback(void)
+{
+	struct reftable_write_options opts = { 0 };
+	struct reftable_stack *st = NULL;
+	char *dir = get_tmp_dir(__LINE__);
+	int count = 0;
+	size_t i, n = 5;
+
+	opts.on_compaction_required = count_compaction_required;
+	opts.on_compaction_required_payload = &count;
+	cl_assert_equal_i(reftable_new_stack(&st, dir, &opts), 0);
+
+	for (i = 0; i < n; i++) {
+		struct reftable_ref_record ref = {
+			.update_index = reftable_stack_next_update_index(st),
+			.value_type = REFTABLE_REF_SYMREF,
+			.value.symref = (char *) "master",
+		};
+		char buf[128];
+
+		snprintf(buf, sizeof(buf), "branch-%04"PRIuMAX, (uintmax_t)i);
+		ref.refname = buf;
+
+		cl_assert_equal_i(reftable_stack_add(st, write_test_ref,
+						     &ref, 0), 0);
+	}
+
+	/*
+	 * The callback is invoked for every addition but the first one, and
+	 * the stack is left alone.
+	 */
+	cl_assert_equal_i(count, n - 1);
+	cl_assert_equal_i(st->merged->tables_len, n);
+
+	reftable_stack_destroy(st);
+	clear_dir(dir);
+}
+
 void test_reftable_stack__compaction_with_locked_tables(void)
 {
 	struct reftable_write_options opts = {
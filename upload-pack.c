@@ -3,6 +3,7 @@
 
 #include "git-compat-util.h"
 #include "config.h"
+#include "copy.h"
 #include "environment.h"
 #include "gettext.h"
 #include "hex.h"
@@ -34,6 +35,9 @@
 #include "json-writer.h"
 #include "strmap.h"
 #include "promisor-remote.h"
+#include "tempfile.h"
+#include "dir.h"
+#include "path.h"
 
 /* Remember to update object flag allocation in object.h */
 #define THEY_HAVE	(1u << 11)
@@ -100,6 +104,7 @@ struct upload_pack_data {
 	struct packet_writer writer;
 
 	char *pack_objects_hook;
+	unsigned long pack_cache_size;
 
 	unsigned stateless_rpc : 1;				/* v0 only */
 	unsigned no_done : 1;					/* v0 only */
@@ -160,6 +165,7 @@ static void upload_pack_data_init(struct upload_pack_data *data)
 static void upload_pack_data_clear(struct upload_pack_data *data)
 {
 	string_list_clear(&data->symref, 1);
+	packet_writer_release(&data->writer);
 	strmap_clear(&data->wanted_refs, 1);
 	strvec_clear(&data->hidden_refs);
 	object_array_clear(&data->want_obj);
@@ -216,8 +222,37 @@ struct output_state {
 	int used;
 	unsigned packfile_uris_started : 1;
 	unsigned packfile_started : 1;
+
+	/* a copy of the pack data goes here, if it is to be cached */
+	struct tempfile *cache;
+	/* bytes written to 'cache' so far, and how many it may hold */
+	size_t cache_used;
+	unsigned long cache_limit;
 };
 
+static void send_pack_data(struct output_state *os, const char *data,
+			   ssize_t sz, int use_sideband)
+{
+	send_client_data(1, data, sz, use_sideband);
+	if (!os->cache)
+		return;
+
+	/*
+	 * A pack that does not fit into the cache would be pruned right
+	 * after it is stored, so stop copying it as soon as we know.
+	 */
+	os->cache_used += sz;
+	if (os->cache_used > os->cache_limit) {
+		trace2_data_intmax("upload-pack", the_repository,
+				   "pack-cache/too-large", 1);
+		delete_tempfile(&os->cache);
+	} else if (write_in_full(get_tempfile_fd(os->cache), data, sz) < 0) {
+		/* the client still gets its pack, we just do not keep it */
+		warning_errno(_("unable to write to pack cache"));
+		delete_tempfile(&os->cache);
+	}
+}
+
 static int relay_pack_data(int pack_objects_out, struct output_state *os,
 			   int use_sideband, int write_packfile_line,
 			   bool *did_send_data)
@@ -284,11 +319,11 @@ static int relay_pack_data(int pack_objects_out, struct output_state *os,
 		return readsz;
 
 	if (os->used > 1) {
-		send_client_data(1, os->buffer, os->used - 1, use_sideband);
+		send_pack_data(os, os->buffer, os->used - 1, use_sideband);
 		os->buffer[0] = os->buffer[os->used - 1];
 		os->used = 1;
 	} else {
-		send_client_data(1, os->buffer, os->used, use_sideband);
+		send_pack_data(os, os->buffer, os->used, use_sideband);
 		os->used = 0;
 	}
 
@@ -296,6 +331,236 @@ static int relay_pack_data(int pack_objects_out, struct output_state *os,
 	return readsz;
 }
 
+/*
+ * The pack cache keeps the packs sent to clients in
+ * "$GIT_DIR/upload-pack-cache", named "<refs>-<request>.pack". <refs>
+ * hashes the current state of all references, so that moving any of
+ * them invalidates the whole cache. <request> hashes everything else
+ * the pack depends on: the wants and haves, the shallow boundary, the
+ * filter and the capabilities that affect the pack.
+ */
+static int add_ref_to_cache_key(const struct reference *ref, void *cb_data)
+{
+	struct strbuf *key = cb_data;
+	strbuf_addf(key, "%s %s\n", oid_to_hex(ref->oid), ref->name);
+	return 0;
+}
+
+static int add_shallow_to_cache_key(const struct commit_graft *graft,
+				    void *cb_data)
+{
+	struct strbuf *key = cb_data;
+	if (graft->nr_parent == -1)
+		strbuf_addf(key, "shallow %s\n", oid_to_hex(&graft->oid));
+	return 0;
+}
+
+static void add_objects_to_cache_key(struct strbuf *key, const char *prefix,
+				     struct object_array *objects)
+{
+	struct oid_array oids = OID_ARRAY_INIT;
+
+	for (size_t i = 0; i < objects->nr; i++)
+		oid_array_append(&oids, &objects->objects[i].item->oid);
+	oid_array_sort(&oids);
+	for (size_t i = 0; i < oids.nr; i++)
+		strbuf_addf(key, "%s %s\n", prefix, oid_to_hex(&oids.oid[i]));
+	oid_array_clear(&oids);
+}
+
+static void add_cache_key_hash(struct strbuf *out, struct strbuf *key)
+{
+	struct git_hash_ctx ctx;
+	struct object_id oid;
+
+	the_hash_algo->init_fn(&ctx);
+	git_hash_update(&ctx, key->buf, key->len);
+	git_hash_final_oid(&oid, &ctx);
+	strbuf_addstr(out, oid_to_hex(&oid));
+}
+
+static void pack_cache_path(struct upload_pack_data *data, struct strbuf *path)
+{
+	struct ref_store *refs = get_main_ref_store(the_repository);
+	struct strbuf key = STRBUF_INIT;
+
+	repo_git_path_replace(the_repository, path, "upload-pack-cache/");
+
+	refs_head_ref(refs, add_ref_to_cache_key, &key);
+	refs_for_each_ref(refs, add_ref_to_cache_key, &key);
+	add_cache_key_hash(path, &key);
+	strbuf_addch(path, '-');
+
+	strbuf_reset(&key);
+	strbuf_addf(&key, "thin %d\nofs-delta %d\ninclude-tag %d\npromisor %d\n",
+		    data->use_thin_pack, data->use_ofs_delta,
+		    data->use_include_tag,
+		    repo_has_accepted_promisor_remote(the_repository));
+	if (data->filter_options.choice)
+		strbuf_addf(&key, "filter %s\n",
+			    expand_list_objects_filter_spec(&data->filter_options));
+	if (data->shallow_nr)
+		for_each_commit_graft(add_shallow_to_cache_key, &key);
+	add_objects_to_cache_key(&key, "want", &data->want_obj);
+	add_objects_to_cache_key(&key, "have", &data->have_obj);
+	add_objects_to_cache_key(&key, "edge", &data->extra_edge_obj);
+	add_cache_key_hash(path, &key);
+	strbuf_addstr(path, ".pack");
+
+	strbuf_release(&key);
+}
+
+/*
+ * Send the cached pack at "path" to the client. Returns -1 without
+ * sending anything if there is none.
+ */
+static int send_cached_pack(struct upload_pack_data *data, const char *path)
+{
+	struct stat st;
+	int ret;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0)
+		return -1;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+
+	/* keep recently used packs from being pruned */
+	utime(path, NULL);
+
+	/*
+	 * The pack is sent straight from the file; only the sideband
+	 * headers go through our buffers.
+	 */
+	if (data->use_sideband)
+		ret = send_sideband_from_fd(1, 1, fd, 0, st.st_size,
+					    data->use_sideband);
+	else
+		ret = copy_fd_range(fd, 0, 1, st.st_size);
+	if (ret == COPY_READ_ERROR || ret == COPY_SHORT_READ) {
+		static const char msg[] = "aborting due to unreadable pack cache";
+		if (ret == COPY_SHORT_READ)
+			error(_("unexpected end of '%s'"), path);
+		else
+			error_errno(_("unable to read '%s'"), path);
+		send_client_data(3, msg, strlen(msg), data->use_sideband);
+		die("git upload-pack: %s", msg);
+	}
+	if (ret < 0) {
+		check_pipe(errno);
+		die_errno("write error");
+	}
+	close(fd);
+
+	if (data->use_sideband)
+		packet_flush(1);
+	return 0;
+}
+
+static struct tempfile *start_pack_cache_entry(const char *path)
+{
+	struct strbuf template = STRBUF_INIT;
+	struct tempfile *tmp = NULL;
+	const char *slash = strrchr(path, '/');
+
+	strbuf_add(&template, path, slash - path);
+	if (!safe_create_dir_in_gitdir(the_repository, template.buf) ||
+	    errno == EEXIST) {
+		strbuf_addstr(&template, "/tmp_pack_XXXXXX");
+		tmp = mks_tempfile(template.buf);
+	}
+	strbuf_release(&template);
+
+	/* not being able to cache must not keep us from serving */
+	return tmp;
+}
+
+struct pack_cache_entry {
+	char *name;
+	off_t size;
+	timestamp_t mtime;
+};
+
+static int pack_cache_entry_cmp(const void *va, const void *vb)
+{
+	const struct pack_cache_entry *a = va, *b = vb;
+
+	/* most recently used first */
+	if (a->mtime != b->mtime)
+		return a->mtime < b->mtime ? 1 : -1;
+	return strcmp(a->name, b->name);
+}
+
+/*
+ * Drop the entries for other states of the references, then the least
+ * recently used ones until the cache fits into uploadpack.packCacheSize.
+ */
+static void prune_pack_cache(struct upload_pack_data *data, const char *new_path)
+{
+	struct strbuf path = STRBUF_INIT;
+	const char *new_name = strrchr(new_path, '/') + 1;
+	size_t refs_len = strchrnul(new_name, '-') - new_name + 1;
+	struct pack_cache_entry *entries = NULL;
+	size_t nr = 0, alloc = 0, dirlen;
+	off_t total = 0;
+	intmax_t evicted = 0;
+	struct dirent *de;
+	DIR *dir;
+
+	strbuf_add(&path, new_path, new_name - new_path);
+	dirlen = path.len;
+	dir = opendir(path.buf);
+	if (!dir) {
+		strbuf_release(&path);
+		return;
+	}
+
+	while ((de = readdir_skip_dot_and_dotdot(dir))) {
+		struct stat st;
+
+		if (!ends_with(de->d_name, ".pack"))
+			continue;
+		strbuf_setlen(&path, dirlen);
+		strbuf_addstr(&path, de->d_name);
+
+		if (strncmp(de->d_name, new_name, refs_len)) {
+			if (!unlink(path.buf))
+				evicted++;
+			continue;
+		}
+		if (stat(path.buf, &st))
+			continue;
+
+		ALLOC_GROW(entries, nr + 1, alloc);
+		entries[nr].name = xstrdup(de->d_name);
+		entries[nr].size = st.st_size;
+		entries[nr].mtime = st.st_mtime;
+		nr++;
+	}
+	closedir(dir);
+
+	QSORT(entries, nr, pack_cache_entry_cmp);
+	for (size_t i = 0; i < nr; i++) {
+		total += entries[i].size;
+		if (total > data->pack_cache_size) {
+			strbuf_setlen(&path, dirlen);
+			strbuf_addstr(&path, entries[i].name);
+			if (!unlink(path.buf))
+				evicted++;
+		}
+		free(entries[i].name);
+	}
+
+	if (evicted)
+		trace2_data_intmax("upload-pack", the_repository,
+				   "pack-cache/evicted", evicted);
+
+	free(entries);
+	strbuf_release(&path);
+}
+
 static void create_pack_file(struct upload_pack_data *pack_data,
 			     const struct string_list *uri_protocols)
 {
@@ -308,6 +573,23 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 	ssize_t sz;
 	int i;
 	FILE *pipe_fd;
+	struct strbuf cache_path = STRBUF_INIT;
+
+	if (!uri_protocols && !pack_data->pack_objects_hook &&
+	    pack_data->pack_cache_size) {
+		pack_cache_path(pack_data, &cache_path);
+		if (!send_cached_pack(pack_data, cache_path.buf)) {
+			trace2_data_intmax("upload-pack", the_repository,
+					   "pack-cache/hit", 1);
+			strbuf_release(&cache_path);
+			free(output_state);
+			return;
+		}
+		trace2_data_intmax("upload-pack", the_repository,
+				   "pack-cache/miss", 1);
+		output_state->cache = start_pack_cache_entry(cache_path.buf);
+		output_state->cache_limit = pack_data->pack_cache_size;
+	}
 
 	if (!pack_data->pack_objects_hook)
 		pack_objects.git_cmd = 1;
@@ -485,8 +767,9 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 		 */
 		if (!ret && pack_data->use_sideband) {
 			if (output_state->packfile_started && output_state->used > 1) {
-				send_client_data(1, output_state->buffer, output_state->used - 1,
-						 pack_data->use_sideband);
+				send_pack_data(output_state, output_state->buffer,
+					       output_state->used - 1,
+					       pack_data->use_sideband);
 				output_state->buffer[0] = output_state->buffer[output_state->used - 1];
 				output_state->used = 1;
 			} else {
@@ -505,14 +788,28 @@ static void create_pack_file(struct upload_pack_data *pack_data,
 
 	/* flush the data */
 	if (output_state->used > 0)
-		send_client_data(1, output_state->buffer, output_state->used,
-				 pack_data->use_sideband);
+		send_pack_data(output_state, output_state->buffer,
+			       output_state->used, pack_data->use_sideband);
+	if (output_state->cache) {
+		if (adjust_shared_perm(the_repository,
+				       get_tempfile_path(output_state->cache))) {
+			warning(_("unable to make cached pack %s shared"),
+				get_tempfile_path(output_state->cache));
+			delete_tempfile(&output_state->cache);
+		} else if (rename_tempfile(&output_state->cache, cache_path.buf)) {
+			warning_errno(_("unable to store pack in cache"));
+		} else {
+			prune_pack_cache(pack_data, cache_path.buf);
+		}
+	}
 	free(output_state);
+	strbuf_release(&cache_path);
 	if (pack_data->use_sideband)
 		packet_flush(1);
 	return;
 
  fail:
+	delete_tempfile(&output_state->cache);
 	free(output_state);
 	send_client_data(3, abort_msg, strlen(abort_msg),
 			 pack_data->use_sideband);
@@ -1360,6 +1657,8 @@ static int upload_pack_config(const char *var, const char *value,
 		data->allow_filter = git_config_bool(var, value);
 	} else if (!strcmp("uploadpack.allowrefinwant", var)) {
 		data->allow_ref_in_want = git_config_bool(var, value);
+	} else if (!strcmp("uploadpack.packcachesize", var)) {
+		data->pack_cache_size = git_config_ulong(var, value, ctx->kvi);
 	} else if (!strcmp("uploadpack.allowsidebandall", var)) {
 		data->allow_sideband_all = git_config_bool(var, value);
 	} else if (!strcmp("uploadpack.blobpackfileuri", var)) {
@@ -1756,7 +2055,7 @@ static void send_shallow_info(struct upload_pack_data *data)
 	    is_repository_shallow(the_repository))
 		deepen(data, INFINITE_DEPTH);
 
-	packet_delim(1);
+	packet_writer_delim(&data->writer);
 }
 
 enum upload_state {
@@ -1775,6 +2074,7 @@ int upload_pack_v2(struct repository *r, struct packet_reader *request)
 
 	upload_pack_data_init(&data);
 	data.use_sideband = LARGE_PACKET_MAX;
+	data.writer.buffered = 1;
 	get_upload_pack_config(r, &data);
 
 	while (state != UPLOAD_DONE) {
@@ -1815,9 +2115,11 @@ int upload_pack_v2(struct repository *r, struct packet_reader *request)
 			send_shallow_info(&data);
 
 			if (data.uri_protocols.nr) {
+				packet_writer_drain(&data.writer);
 				create_pack_file(&data, &data.uri_protocols);
 			} else {
 				packet_writer_write(&data.writer, "packfile\n");
+				packet_writer_drain(&data.writer);
 				create_pack_file(&data, NULL);
 			}
 			state = UPLOAD_DONE;